@@ -25,6 +25,8 @@
 #include "rtc.h"
 #include "rf_transmitter.h"
 #include "mqtt_manager.h"
+#include "mqtt_commands.h"
+#include "log_stream.h"
 #include "network_settings.h"
 #include "nvs_manager.h"
 #include "deep_sleep_manager.c"
@@ -34,6 +36,9 @@
 #include "led_manager.h"
 
 void boot_sequence() {
+	// Capture log output for remote upload
+	init_log_stream();
+
 	//Start Wifi led task
 	xTaskCreatePinnedToCore(wifi_led, "led_task", 2500, NULL, LED_TASK_PRIORITY, &led_task_handle, 0);
 
@@ -89,8 +94,9 @@ void boot_sequence() {
 	// Create core 0 tasks
 	xTaskCreatePinnedToCore(rf_transmitter, "rf_transmitter_task", 2500, NULL, RF_TRANSMITTER_TASK_PRIORITY, &rf_transmitter_task_handle, 0);
 	xTaskCreatePinnedToCore(manage_timers_alarms, "timer_alarm_task", 2500, NULL, TIMER_ALARM_TASK_PRIORITY, &timer_alarm_task_handle, 0);
-	xTaskCreatePinnedToCore(publish_sensor_data, "publish_task", 2500, NULL, MQTT_PUBLISH_TASK_PRIORITY, &publish_task_handle, 0);
+	xTaskCreatePinnedToCore(publish_sensor_data, "publish_task", 3072, NULL, MQTT_PUBLISH_TASK_PRIORITY, &publish_task_handle, 0);
 	xTaskCreatePinnedToCore(sensor_control, "sensor_control_task", 3000, NULL, SENSOR_CONTROL_TASK_PRIORITY, &sensor_control_task_handle, 0);
+	xTaskCreatePinnedToCore(mqtt_command_task, "mqtt_command_task", 4096, NULL, MQTT_COMMAND_TASK_PRIORITY, &mqtt_command_task_handle, 0);
 
 	// Create core 1 tasks
 	xTaskCreatePinnedToCore(measure_water_temperature, "temperature_task", 2500, NULL, WATER_TEMPERATURE_TASK_PRIORITY, sensor_get_task_handle(get_water_temp_sensor()), 1);
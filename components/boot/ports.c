@@ -1,5 +1,46 @@
 #include <esp_log.h>
+#include <driver/gpio.h>
 #include "ports.h"
+#include "ezo_sensor.h"
+
+// Tasks woken by INTA, indexed by expansion port gpio
+static TaskHandle_t volatile interrupt_tasks[PORTS_PIN_COUNT];
+
+static void IRAM_ATTR expander_isr_handler(void* arg) {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	// Interrupt flags are behind I2C too, so every registered task checks its own device and releases INTA
+	for(uint8_t i = 0; i < PORTS_PIN_COUNT; ++i) {
+		if(interrupt_tasks[i] != NULL) vTaskNotifyGiveFromISR(interrupt_tasks[i], &xHigherPriorityTaskWoken);
+	}
+
+	if(xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
+}
+
+static void init_expander_interrupt() {
+	// EZO INT outputs toggle on each new reading
+	mcp23x17_set_mode(&ports_dev, EC_INT_GPIO, MCP23X17_GPIO_INPUT);
+	mcp23x17_set_mode(&ports_dev, PH_INT_GPIO, MCP23X17_GPIO_INPUT);
+	mcp23x17_port_set_interrupt(&ports_dev, (1 << EC_INT_GPIO) | (1 << PH_INT_GPIO), MCP23X17_INT_ANY_EDGE);
+	mcp23x17_set_int_out_mode(&ports_dev, MCP23X17_ACTIVE_LOW);
+	mcp23x17_set_int_mirror(&ports_dev, true);
+
+	// Create Falling Edge Interrupt on INTA GPIO
+	gpio_config_t gpio_conf = {
+		.intr_type = GPIO_INTR_NEGEDGE,
+		.pin_bit_mask = 1ULL << INTA_GPIO,
+		.mode = GPIO_MODE_INPUT,
+		.pull_up_en = 1
+	};
+	gpio_config(&gpio_conf);
+	gpio_isr_handler_add(INTA_GPIO, expander_isr_handler, NULL);
+
+	// EZO readings release INTA each time they are woken, or the next reading of either circuit raises no edge
+	ezo_set_interrupt_release(clear_gpio_interrupt);
+
+	// Release interrupt left pending from before the handler was added
+	clear_gpio_interrupt();
+}
 
 void init_ports() {
 	// Initialize MCP23017 GPIO Expansion
@@ -17,6 +58,8 @@ void init_ports() {
 	mcp23x17_set_mode(&ports_dev, EC_NUTRIENT_6_PUMP_GPIO, MCP23X17_GPIO_OUTPUT);
 	set_gpio_off(PH_UP_PUMP_GPIO);
 	set_gpio_off(PH_DOWN_PUMP_GPIO);
+
+	init_expander_interrupt();
 }
 
 esp_err_t set_gpio_on(int gpio) {
@@ -26,5 +69,14 @@ esp_err_t set_gpio_off(int gpio) {
 	return mcp23x17_set_level(&ports_dev, gpio, 0);	
 }
 
+void set_gpio_interrupt_task(int gpio, TaskHandle_t task) {
+	interrupt_tasks[gpio] = task;
+}
+
+void clear_gpio_interrupt() {
+	uint16_t levels;
+	if(mcp23x17_port_read(&ports_dev, &levels) != ESP_OK) ESP_LOGE(PORTS_TAG, "Unable to release INTA");
+}
+
 
 
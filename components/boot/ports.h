@@ -1,6 +1,10 @@
 #include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "mcp23x17.h"
 
+#define PORTS_TAG "PORTS"
+
 // GPIO Ports
 #define POWER_BUTTON_GPIO			35
 #define HARD_RESET_GPIO             33
@@ -25,6 +29,11 @@
 #define EC_NUTRIENT_6_PUMP_GPIO 	0
 #define PH_UP_PUMP_GPIO 			6
 #define PH_DOWN_PUMP_GPIO 			7
+#define EC_INT_GPIO 				8 // EZO INT output, toggles on each new reading
+#define PH_INT_GPIO 				9
+
+// MCP23017 pin count, interrupts of all pins are signalled on INTA
+#define PORTS_PIN_COUNT 			16
 
 mcp23x17_t ports_dev;
 
@@ -34,3 +43,9 @@ void init_ports();
 // Set gpio on and off
 esp_err_t set_gpio_on(int gpio);
 esp_err_t set_gpio_off(int gpio);
+
+// Notify task on interrupt of expansion port gpio, NULL to stop
+void set_gpio_interrupt_task(int gpio, TaskHandle_t task);
+
+// Read expansion port to release INTA, call from the task after it is notified as the ISR can't use I2C
+void clear_gpio_interrupt();
@@ -3,6 +3,7 @@
 #define MQTT_PUBLISH_TASK_PRIORITY 1
 #define HARD_RESET_TASK_PRIORITY 1
 #define SENSOR_CONTROL_TASK_PRIORITY 2
+#define MQTT_COMMAND_TASK_PRIORITY 2 // Below RF Transmitter, commands wait on RF sends
 #define RF_TRANSMITTER_TASK_PRIORITY 3 // RF Transmitter should be higher than other priorities
 #define LED_TASK_PRIORITY 4
 
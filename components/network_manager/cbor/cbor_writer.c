@@ -0,0 +1,94 @@
+#include "cbor_writer.h"
+
+#include <string.h>
+
+// Major types
+#define CBOR_UINT 0
+#define CBOR_NEGATIVE_INT 1
+#define CBOR_TEXT_STRING 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_SIMPLE 7
+
+// Simple values
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_FLOAT32 26
+
+static void write_bytes(struct cbor_writer *writer, const uint8_t *data, size_t len) {
+	if(writer->overflow || writer->len + len > writer->size) {
+		writer->overflow = true;
+		return;
+	}
+	memcpy(writer->buf + writer->len, data, len);
+	writer->len += len;
+}
+
+// Write type byte followed by the shortest big endian argument
+static void write_head(struct cbor_writer *writer, uint8_t major_type, uint32_t value) {
+	uint8_t head[5];
+	size_t len;
+
+	if(value < 24) {
+		head[0] = (major_type << 5) | value;
+		len = 1;
+	} else if(value <= UINT8_MAX) {
+		head[0] = (major_type << 5) | 24;
+		head[1] = value;
+		len = 2;
+	} else if(value <= UINT16_MAX) {
+		head[0] = (major_type << 5) | 25;
+		head[1] = value >> 8;
+		head[2] = value;
+		len = 3;
+	} else {
+		head[0] = (major_type << 5) | 26;
+		head[1] = value >> 24;
+		head[2] = value >> 16;
+		head[3] = value >> 8;
+		head[4] = value;
+		len = 5;
+	}
+	write_bytes(writer, head, len);
+}
+
+void cbor_writer_init(struct cbor_writer *writer, uint8_t *buf, size_t size) {
+	writer->buf = buf;
+	writer->size = size;
+	writer->len = 0;
+	writer->overflow = false;
+}
+
+void cbor_writer_begin_map(struct cbor_writer *writer, uint32_t num_pairs) { write_head(writer, CBOR_MAP, num_pairs); }
+void cbor_writer_begin_array(struct cbor_writer *writer, uint32_t num_items) { write_head(writer, CBOR_ARRAY, num_items); }
+
+void cbor_writer_add_uint(struct cbor_writer *writer, uint32_t value) { write_head(writer, CBOR_UINT, value); }
+
+void cbor_writer_add_int(struct cbor_writer *writer, int32_t value) {
+	// Negative integers are encoded as -1 - n
+	if(value < 0) write_head(writer, CBOR_NEGATIVE_INT, (uint32_t)(-(value + 1)));
+	else write_head(writer, CBOR_UINT, value);
+}
+
+void cbor_writer_add_bool(struct cbor_writer *writer, bool value) {
+	uint8_t head = (CBOR_SIMPLE << 5) | (value ? CBOR_TRUE : CBOR_FALSE);
+	write_bytes(writer, &head, 1);
+}
+
+void cbor_writer_add_string(struct cbor_writer *writer, const char *value) {
+	size_t len = strlen(value);
+	write_head(writer, CBOR_TEXT_STRING, len);
+	write_bytes(writer, (const uint8_t*)value, len);
+}
+
+void cbor_writer_add_float(struct cbor_writer *writer, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint8_t data[5] = { (CBOR_SIMPLE << 5) | CBOR_FLOAT32, bits >> 24, bits >> 16, bits >> 8, bits };
+	write_bytes(writer, data, sizeof(data));
+}
+
+const uint8_t* cbor_writer_finish(struct cbor_writer *writer) { return writer->overflow ? NULL : writer->buf; }
+
+size_t cbor_writer_length(const struct cbor_writer *writer) { return writer->len; }
@@ -0,0 +1,38 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming CBOR (RFC 7049) encoder writing into a caller owned buffer (no heap allocation)
+struct cbor_writer {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
+// Start writing into buf
+void cbor_writer_init(struct cbor_writer *writer, uint8_t *buf, size_t size);
+
+// Definite length containers, followed by num_pairs key/value pairs or num_items values
+void cbor_writer_begin_map(struct cbor_writer *writer, uint32_t num_pairs);
+void cbor_writer_begin_array(struct cbor_writer *writer, uint32_t num_items);
+
+// Values
+void cbor_writer_add_uint(struct cbor_writer *writer, uint32_t value);
+void cbor_writer_add_int(struct cbor_writer *writer, int32_t value);
+void cbor_writer_add_bool(struct cbor_writer *writer, bool value);
+void cbor_writer_add_string(struct cbor_writer *writer, const char *value);
+
+// Float written as a raw single precision value
+void cbor_writer_add_float(struct cbor_writer *writer, float value);
+
+// Returns NULL if the document did not fit
+const uint8_t* cbor_writer_finish(struct cbor_writer *writer);
+
+// Get length of written document
+size_t cbor_writer_length(const struct cbor_writer *writer);
+
+#endif
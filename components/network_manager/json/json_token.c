@@ -0,0 +1,300 @@
+#include "json_token.h"
+
+#include <string.h>
+
+#define NO_PARENT -1
+
+static struct json_token* add_token(struct json_token *tokens, int *num_tokens, uint16_t max_tokens, int parent) {
+	if(*num_tokens >= max_tokens) return NULL;
+
+	struct json_token *token = &tokens[(*num_tokens)++];
+	token->type = JSON_UNDEFINED;
+	token->start = 0;
+	token->end = 0;
+	token->size = 0;
+	token->parent = parent;
+	if(parent != NO_PARENT) tokens[parent].size++;
+	return token;
+}
+
+static bool is_hex(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+static uint8_t hex_value(char c) {
+	if(c <= '9') return c - '0';
+	if(c <= 'F') return c - 'A' + 10;
+	return c - 'a' + 10;
+}
+
+// Returns position of closing quote, or negative error
+static int parse_string(const char *json, size_t len, size_t pos) {
+	for(++pos; pos < len; ++pos) {
+		char c = json[pos];
+		if(c == '\"') return pos;
+		if((uint8_t)c < 0x20) return JSON_ERROR_INVALID;
+		if(c != '\\') continue;
+
+		if(++pos == len) return JSON_ERROR_PARTIAL;
+		switch(json[pos]) {
+			case '\"': case '/': case '\\': case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				for(uint8_t i = 0; i < 4; ++i) {
+					if(++pos == len) return JSON_ERROR_PARTIAL;
+					if(!is_hex(json[pos])) return JSON_ERROR_INVALID;
+				}
+				break;
+			default:
+				return JSON_ERROR_INVALID;
+		}
+	}
+	return JSON_ERROR_PARTIAL;
+}
+
+// Returns position after primitive, or negative error
+static int parse_primitive(const char *json, size_t len, size_t pos) {
+	for(; pos < len; ++pos) {
+		char c = json[pos];
+		if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ']' || c == '}' || c == ':') break;
+		if((uint8_t)c < 0x20 || (uint8_t)c >= 0x7F) return JSON_ERROR_INVALID;
+	}
+	return pos;
+}
+
+int json_tokenize(const char *json, size_t len, struct json_token *tokens, uint16_t max_tokens) {
+	int num_tokens = 0;
+	int super = NO_PARENT; // Token receiving the next value
+	struct json_token *token;
+
+	// Offsets are stored as 16 bit
+	if(len > UINT16_MAX) return JSON_ERROR_INVALID;
+
+	for(size_t pos = 0; pos < len; ++pos) {
+		char c = json[pos];
+		switch(c) {
+			case '{': case '[':
+				// Keys must be strings
+				if(super != NO_PARENT && tokens[super].type == JSON_OBJECT) return JSON_ERROR_INVALID;
+				token = add_token(tokens, &num_tokens, max_tokens, super);
+				if(token == NULL) return JSON_ERROR_NO_TOKENS;
+				token->type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+				token->start = pos;
+				super = num_tokens - 1;
+				break;
+			case '}': case ']': {
+				uint8_t type = c == '}' ? JSON_OBJECT : JSON_ARRAY;
+				if(super == NO_PARENT) return JSON_ERROR_INVALID;
+
+				// Walk up from a key to the innermost open container
+				token = &tokens[super];
+				while(token->end != 0 || (token->type != JSON_OBJECT && token->type != JSON_ARRAY)) {
+					if(token->parent == NO_PARENT) return JSON_ERROR_INVALID;
+					token = &tokens[token->parent];
+				}
+				if(token->type != type) return JSON_ERROR_INVALID;
+				token->end = pos + 1;
+				super = token->parent;
+				break;
+			}
+			case '\"': {
+				int end = parse_string(json, len, pos);
+				if(end < 0) return end;
+				token = add_token(tokens, &num_tokens, max_tokens, super);
+				if(token == NULL) return JSON_ERROR_NO_TOKENS;
+				token->type = JSON_STRING;
+				token->start = pos + 1;
+				token->end = end;
+				pos = end;
+				break;
+			}
+			case ' ': case '\t': case '\r': case '\n':
+				break;
+			case ':':
+				// Last token is the key owning the next value, a string directly in an object without a value yet
+				if(super == NO_PARENT || tokens[super].type != JSON_OBJECT) return JSON_ERROR_INVALID;
+				token = &tokens[num_tokens - 1];
+				if(token->type != JSON_STRING || token->parent != super || token->size != 0) return JSON_ERROR_INVALID;
+				super = num_tokens - 1;
+				break;
+			case ',':
+				// Value of a key finished, next token belongs to the enclosing object
+				if(super != NO_PARENT && tokens[super].type != JSON_OBJECT && tokens[super].type != JSON_ARRAY) {
+					super = tokens[super].parent;
+				}
+				break;
+			case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+			case 't': case 'f': case 'n': {
+				if(super != NO_PARENT && tokens[super].type == JSON_OBJECT) return JSON_ERROR_INVALID;
+				int end = parse_primitive(json, len, pos);
+				if(end < 0) return end;
+				token = add_token(tokens, &num_tokens, max_tokens, super);
+				if(token == NULL) return JSON_ERROR_NO_TOKENS;
+				token->type = JSON_PRIMITIVE;
+				token->start = pos;
+				token->end = end;
+				pos = end - 1;
+				break;
+			}
+			default:
+				return JSON_ERROR_INVALID;
+		}
+	}
+
+	// Every object and array must be closed and every key needs a value
+	for(int i = 0; i < num_tokens; ++i) {
+		if((tokens[i].type == JSON_OBJECT || tokens[i].type == JSON_ARRAY) && tokens[i].end == 0) return JSON_ERROR_PARTIAL;
+		if(tokens[i].parent != NO_PARENT && tokens[tokens[i].parent].type == JSON_OBJECT && tokens[i].size != 1) return JSON_ERROR_INVALID;
+	}
+	return num_tokens;
+}
+
+int json_skip(const struct json_token *tokens, int num_tokens, int index) {
+	// Children always start inside their parent
+	uint16_t end = tokens[index].end;
+	int next = index + 1;
+	while(next < num_tokens && tokens[next].start < end) next++;
+	return next;
+}
+
+int json_object_next(const struct json_token *tokens, int num_tokens, int key) {
+	if(key + 1 >= num_tokens) return num_tokens;
+	return json_skip(tokens, num_tokens, key + 1);
+}
+
+int json_object_get(const char *json, const struct json_token *tokens, int num_tokens, int object, const char *key) {
+	if(object < 0 || object >= num_tokens || tokens[object].type != JSON_OBJECT) return -1;
+
+	int index = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size && index + 1 < num_tokens; ++i) {
+		if(json_token_equals(json, &tokens[index], key)) return index + 1;
+		index = json_object_next(tokens, num_tokens, index);
+	}
+	return -1;
+}
+
+bool json_token_equals(const char *json, const struct json_token *token, const char *str) {
+	size_t len = strlen(str);
+	return token->type == JSON_STRING && json_token_length(token) == len && memcmp(json + token->start, str, len) == 0;
+}
+
+uint16_t json_token_length(const struct json_token *token) { return token->end - token->start; }
+
+// Parse number without relying on a terminator after the token
+static bool parse_number(const char *json, const struct json_token *token, double *value) {
+	const char *c = json + token->start;
+	const char *end = json + token->end;
+	bool is_negative = false;
+	double result = 0;
+
+	if(token->type != JSON_PRIMITIVE) return false;
+
+	if(c < end && *c == '-') {
+		is_negative = true;
+		c++;
+	}
+	if(c == end || *c < '0' || *c > '9') return false;
+	while(c < end && *c >= '0' && *c <= '9') result = result * 10 + (*c++ - '0');
+
+	if(c < end && *c == '.') {
+		double scale = 0.1;
+		if(++c == end || *c < '0' || *c > '9') return false;
+		while(c < end && *c >= '0' && *c <= '9') {
+			result += (*c++ - '0') * scale;
+			scale *= 0.1;
+		}
+	}
+
+	if(c < end && (*c == 'e' || *c == 'E')) {
+		bool is_negative_exponent = false;
+		int exponent = 0;
+		if(++c < end && (*c == '+' || *c == '-')) is_negative_exponent = *c++ == '-';
+		if(c == end || *c < '0' || *c > '9') return false;
+		while(c < end && *c >= '0' && *c <= '9') {
+			if(exponent < 100) exponent = exponent * 10 + (*c - '0');
+			c++;
+		}
+		while(exponent-- > 0) result = is_negative_exponent ? result / 10 : result * 10;
+	}
+
+	if(c != end) return false;
+	*value = is_negative ? -result : result;
+	return true;
+}
+
+static bool parse_literal(const char *json, const struct json_token *token, bool *value) {
+	if(token->type != JSON_PRIMITIVE) return false;
+	if(json_token_length(token) == 4 && memcmp(json + token->start, "true", 4) == 0) {
+		*value = true;
+		return true;
+	}
+	if(json_token_length(token) == 5 && memcmp(json + token->start, "false", 5) == 0) {
+		*value = false;
+		return true;
+	}
+	return false;
+}
+
+bool json_token_to_float(const char *json, const struct json_token *token, float *value) {
+	double result;
+	if(!parse_number(json, token, &result)) return false;
+	*value = result;
+	return true;
+}
+
+bool json_token_to_int(const char *json, const struct json_token *token, int32_t *value) {
+	double result;
+	bool literal;
+
+	// Booleans are accepted as 0 and 1
+	if(parse_literal(json, token, &literal)) {
+		*value = literal;
+		return true;
+	}
+	if(!parse_number(json, token, &result)) return false;
+
+	// Truncate and saturate like cJSON valueint
+	if(result >= INT32_MAX) *value = INT32_MAX;
+	else if(result <= INT32_MIN) *value = INT32_MIN;
+	else *value = (int32_t)result;
+	return true;
+}
+
+bool json_token_to_bool(const char *json, const struct json_token *token, bool *value) {
+	double result;
+
+	// Numbers are accepted, non zero is true
+	if(parse_literal(json, token, value)) return true;
+	if(!parse_number(json, token, &result)) return false;
+	*value = result != 0;
+	return true;
+}
+
+bool json_token_copy_string(const char *json, const struct json_token *token, char *out, size_t size) {
+	size_t len = 0;
+	if(token->type != JSON_STRING || size == 0) return false;
+
+	for(uint16_t pos = token->start; pos < token->end; ++pos) {
+		char c = json[pos];
+		if(c == '\\') {
+			// Escapes were validated by the tokenizer
+			switch(json[++pos]) {
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'u': {
+					uint16_t code = 0;
+					for(uint8_t i = 0; i < 4; ++i) code = (code << 4) | hex_value(json[++pos]);
+					// Only ASCII is kept, anything else is replaced
+					c = code < 0x80 ? (char)code : '?';
+					break;
+				}
+				default: c = json[pos]; break;
+			}
+		}
+		if(len + 1 >= size) return false;
+		out[len++] = c;
+	}
+	out[len] = '\0';
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef JSON_TOKEN_H
+#define JSON_TOKEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Errors returned by json_tokenize
+#define JSON_ERROR_NO_TOKENS -1 // Document needs more than max_tokens
+#define JSON_ERROR_INVALID -2 // Invalid character or structure
+#define JSON_ERROR_PARTIAL -3 // Document ended before all objects and arrays were closed
+
+enum json_token_type {
+	JSON_UNDEFINED = 0,
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_PRIMITIVE // Number, true, false or null
+};
+
+// Token referencing a span of the parsed document, nothing is copied
+struct json_token {
+	uint8_t type;
+	uint16_t start; // Offset of first char, strings exclude the quotes
+	uint16_t end; // Offset past last char
+	uint16_t size; // Members of an object, items of an array, 1 for an object key
+	int16_t parent;
+};
+
+// Tokenize len bytes of json in place (no null terminator needed, no heap allocation)
+// Tokens are stored in document order, returns number of tokens or a JSON_ERROR_* code
+int json_tokenize(const char *json, size_t len, struct json_token *tokens, uint16_t max_tokens);
+
+// Get index of the token following the value at index and all its children
+int json_skip(const struct json_token *tokens, int num_tokens, int index);
+
+// Get index of the value for key in object, -1 if not found
+int json_object_get(const char *json, const struct json_token *tokens, int num_tokens, int object, const char *key);
+
+// Iterate object members: first key is object + 1, then json_object_next until size keys were visited
+int json_object_next(const struct json_token *tokens, int num_tokens, int key);
+
+// Compare string token with str
+bool json_token_equals(const char *json, const struct json_token *token, const char *str);
+
+// Get length of token text
+uint16_t json_token_length(const struct json_token *token);
+
+// Value conversions, return false if token is not of the expected type
+bool json_token_to_float(const char *json, const struct json_token *token, float *value);
+bool json_token_to_int(const char *json, const struct json_token *token, int32_t *value);
+bool json_token_to_bool(const char *json, const struct json_token *token, bool *value);
+
+// Copy unescaped string into out (null terminated), returns false if not a string or it does not fit
+bool json_token_copy_string(const char *json, const struct json_token *token, char *out, size_t size);
+
+#endif
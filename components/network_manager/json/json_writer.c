@@ -0,0 +1,241 @@
+#include "json_writer.h"
+
+#include <math.h>
+#include <string.h>
+
+// Largest decimals supported by the fixed point formatter
+#define JSON_MAX_DECIMALS 6
+
+// Largest magnitude formatted as a number, anything above is clamped
+#define JSON_MAX_FLOAT_MAGNITUDE 1e12
+
+static const uint32_t powers_of_ten[JSON_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+// --------------------------------------------------- Helper functions ----------------------------------------------
+
+static void put_char(struct json_writer *writer, char c) {
+	// Always keep one byte free for the terminator
+	if(writer->len + 1 >= writer->size) {
+		writer->overflow = true;
+		return;
+	}
+	writer->buf[writer->len++] = c;
+}
+
+static void put_raw(struct json_writer *writer, const char *str, size_t len) {
+	if(writer->len + len >= writer->size) {
+		writer->overflow = true;
+		return;
+	}
+	memcpy(writer->buf + writer->len, str, len);
+	writer->len += len;
+}
+
+static void put_escaped(struct json_writer *writer, const char *str) {
+	static const char hex[] = "0123456789abcdef";
+
+	put_char(writer, '"');
+	for(const char *c = str; *c != '\0'; ++c) {
+		unsigned char ch = (unsigned char)(*c);
+		if(ch == '"' || ch == '\\') {
+			put_char(writer, '\\');
+			put_char(writer, ch);
+		} else if(ch < 0x20) {
+			char escape[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0x0F] };
+			put_raw(writer, escape, sizeof(escape));
+		} else {
+			put_char(writer, ch);
+		}
+	}
+	put_char(writer, '"');
+}
+
+// Writes the separator and key that precede every element
+static void put_prefix(struct json_writer *writer, const char *key) {
+	uint16_t level_bit = 1 << writer->depth;
+	if(writer->has_items & level_bit) put_char(writer, ',');
+	writer->has_items |= level_bit;
+
+	if(key != NULL) {
+		put_escaped(writer, key);
+		put_char(writer, ':');
+	}
+}
+
+static void open_level(struct json_writer *writer, const char *key, char bracket) {
+	put_prefix(writer, key);
+	put_char(writer, bracket);
+
+	if(writer->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+		writer->overflow = true;
+		return;
+	}
+	writer->depth++;
+	writer->has_items &= ~(1 << writer->depth);
+}
+
+static void close_level(struct json_writer *writer, char bracket) {
+	if(writer->depth > 0) writer->depth--;
+	put_char(writer, bracket);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+
+// --------------------------------------------------- Public interface ----------------------------------------------
+
+size_t json_format_uint(char *out, uint32_t value, uint8_t min_digits) {
+	char digits[10];
+	size_t count = 0;
+
+	do {
+		digits[count++] = '0' + (value % 10);
+		value /= 10;
+	} while(value != 0);
+
+	size_t len = 0;
+	for(size_t i = count; i < min_digits; ++i) out[len++] = '0';
+	while(count > 0) out[len++] = digits[--count];
+
+	return len;
+}
+
+size_t json_format_float(char *out, float value, uint8_t decimals) {
+	size_t len = 0;
+	if(decimals > JSON_MAX_DECIMALS) decimals = JSON_MAX_DECIMALS;
+
+	double number = value;
+	if(isnan(number) || isinf(number)) number = 0;
+	if(number > JSON_MAX_FLOAT_MAGNITUDE) number = JSON_MAX_FLOAT_MAGNITUDE;
+	if(number < -JSON_MAX_FLOAT_MAGNITUDE) number = -JSON_MAX_FLOAT_MAGNITUDE;
+
+	// Round half away from zero at the requested precision, same as printf
+	uint64_t scaled = (uint64_t)(fabs(number) * powers_of_ten[decimals] + 0.5);
+	if(number < 0 && scaled != 0) out[len++] = '-';
+
+	uint64_t integer = scaled / powers_of_ten[decimals];
+	uint32_t fraction = scaled % powers_of_ten[decimals];
+
+	// Integer part can exceed 32 bits before clamping, split it in two
+	if(integer >= 1000000000) {
+		len += json_format_uint(out + len, (uint32_t)(integer / 1000000000), 1);
+		len += json_format_uint(out + len, (uint32_t)(integer % 1000000000), 9);
+	} else {
+		len += json_format_uint(out + len, (uint32_t)integer, 1);
+	}
+
+	if(decimals > 0) {
+		out[len++] = '.';
+		len += json_format_uint(out + len, fraction, decimals);
+	}
+
+	return len;
+}
+
+size_t json_format_time(char *out, const struct tm *time) {
+	size_t len = 0;
+
+	len += json_format_uint(out + len, time->tm_year + 1900, 4);
+	out[len++] = '-';
+	len += json_format_uint(out + len, time->tm_mon + 1, 2); // convert from (0 to 11) to (1 to 12)
+	out[len++] = '-';
+	len += json_format_uint(out + len, time->tm_mday, 2);
+	out[len++] = 'T';
+	len += json_format_uint(out + len, time->tm_hour, 2);
+	out[len++] = ':';
+	len += json_format_uint(out + len, time->tm_min, 2);
+	out[len++] = ':';
+	len += json_format_uint(out + len, time->tm_sec, 2);
+	out[len++] = 'Z';
+
+	return len;
+}
+
+void json_writer_init(struct json_writer *writer, char *buf, size_t size) {
+	writer->buf = buf;
+	writer->size = size;
+	writer->len = 0;
+	writer->overflow = (buf == NULL || size == 0);
+	writer->depth = 0;
+	writer->has_items = 0;
+}
+
+void json_writer_begin_object(struct json_writer *writer, const char *key) { open_level(writer, key, '{'); }
+void json_writer_end_object(struct json_writer *writer) { close_level(writer, '}'); }
+void json_writer_begin_array(struct json_writer *writer, const char *key) { open_level(writer, key, '['); }
+void json_writer_end_array(struct json_writer *writer) { close_level(writer, ']'); }
+
+void json_writer_add_string(struct json_writer *writer, const char *key, const char *value) {
+	put_prefix(writer, key);
+	put_escaped(writer, value);
+}
+
+void json_writer_add_int(struct json_writer *writer, const char *key, int32_t value) {
+	char number[12];
+	size_t len = 0;
+	uint32_t magnitude = (uint32_t)value;
+
+	if(value < 0) {
+		number[len++] = '-';
+		magnitude = 0u - magnitude;
+	}
+	len += json_format_uint(number + len, magnitude, 1);
+
+	put_prefix(writer, key);
+	put_raw(writer, number, len);
+}
+
+void json_writer_add_uint(struct json_writer *writer, const char *key, uint32_t value) {
+	char number[10];
+	size_t len = json_format_uint(number, value, 1);
+
+	put_prefix(writer, key);
+	put_raw(writer, number, len);
+}
+
+void json_writer_add_bool(struct json_writer *writer, const char *key, bool value) {
+	put_prefix(writer, key);
+	if(value) put_raw(writer, "true", 4);
+	else put_raw(writer, "false", 5);
+}
+
+void json_writer_add_float(struct json_writer *writer, const char *key, float value, uint8_t decimals) {
+	char number[24];
+	size_t len = json_format_float(number, value, decimals);
+
+	put_prefix(writer, key);
+	put_raw(writer, number, len);
+}
+
+void json_writer_add_float_string(struct json_writer *writer, const char *key, float value, uint8_t decimals) {
+	char number[24];
+	size_t len = json_format_float(number, value, decimals);
+
+	put_prefix(writer, key);
+	put_char(writer, '"');
+	put_raw(writer, number, len);
+	put_char(writer, '"');
+}
+
+void json_writer_add_time(struct json_writer *writer, const char *key, const struct tm *time) {
+	char time_str[JSON_ISO_TIME_LENGTH];
+	size_t len = json_format_time(time_str, time);
+
+	put_prefix(writer, key);
+	put_char(writer, '"');
+	put_raw(writer, time_str, len);
+	put_char(writer, '"');
+}
+
+const char* json_writer_finish(struct json_writer *writer) {
+	if(writer->overflow) {
+		if(writer->size > 0) writer->buf[0] = '\0';
+		return NULL;
+	}
+	writer->buf[writer->len] = '\0';
+	return writer->buf;
+}
+
+size_t json_writer_length(const struct json_writer *writer) { return writer->len; }
+
+// --------------------------------------------------------------------------------------------------------------------
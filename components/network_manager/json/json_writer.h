@@ -0,0 +1,58 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Max nesting of objects/arrays tracked for comma placement
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Length of an ISO 8601 UTC timestamp, excluding terminator (YYYY-MM-DDTHH:MM:SSZ)
+#define JSON_ISO_TIME_LENGTH 20
+
+// Streaming JSON serializer writing into a caller owned buffer (no heap allocation)
+struct json_writer {
+	char *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+	uint8_t depth;
+	uint16_t has_items; // Bit per depth level, set once the level holds an element
+};
+
+// Start writing into buf, size includes room for the terminator
+void json_writer_init(struct json_writer *writer, char *buf, size_t size);
+
+// Objects and arrays, key is NULL for the root or for array elements
+void json_writer_begin_object(struct json_writer *writer, const char *key);
+void json_writer_end_object(struct json_writer *writer);
+void json_writer_begin_array(struct json_writer *writer, const char *key);
+void json_writer_end_array(struct json_writer *writer);
+
+// Values, key is NULL for array elements
+void json_writer_add_string(struct json_writer *writer, const char *key, const char *value);
+void json_writer_add_int(struct json_writer *writer, const char *key, int32_t value);
+void json_writer_add_uint(struct json_writer *writer, const char *key, uint32_t value);
+void json_writer_add_bool(struct json_writer *writer, const char *key, bool value);
+void json_writer_add_float(struct json_writer *writer, const char *key, float value, uint8_t decimals);
+
+// Float written as a quoted fixed point string, e.g. "6.02" (legacy live_data format)
+void json_writer_add_float_string(struct json_writer *writer, const char *key, float value, uint8_t decimals);
+
+// Time written as a quoted ISO 8601 UTC timestamp
+void json_writer_add_time(struct json_writer *writer, const char *key, const struct tm *time);
+
+// Terminates the buffer, returns NULL if the document did not fit
+const char* json_writer_finish(struct json_writer *writer);
+
+// Get length of written document
+size_t json_writer_length(const struct json_writer *writer);
+
+// Formatting helpers, return number of chars written to out (not terminated)
+size_t json_format_uint(char *out, uint32_t value, uint8_t min_digits);
+size_t json_format_float(char *out, float value, uint8_t decimals);
+size_t json_format_time(char *out, const struct tm *time);
+
+#endif
@@ -0,0 +1,84 @@
+#include "lzss_encoder.h"
+
+static void write_bits(struct lzss_encoder *encoder, uint16_t value, uint8_t count) {
+	// Later bits are dropped, num_bits would otherwise grow past 8
+	if(encoder->overflow) return;
+	while(count > 0) {
+		encoder->bits = (encoder->bits << 1) | ((value >> --count) & 1);
+		if(++encoder->num_bits < 8) continue;
+
+		if(encoder->len >= encoder->size) {
+			encoder->overflow = true;
+			return;
+		}
+		encoder->buf[encoder->len++] = encoder->bits;
+		encoder->bits = 0;
+		encoder->num_bits = 0;
+	}
+}
+
+// Pad last byte with zeros, decoders stop at the end of input
+static void flush_bits(struct lzss_encoder *encoder) {
+	if(encoder->overflow) return;
+	if(encoder->num_bits > 0) write_bits(encoder, 0, 8 - encoder->num_bits);
+}
+
+// Find longest earlier match for in[pos], matches may overlap pos like the decoder output
+static uint16_t find_match(const uint8_t *in, size_t in_len, size_t pos, uint16_t max_distance, uint16_t max_length, uint16_t *distance) {
+	uint16_t best_length = 0;
+	size_t limit = in_len - pos < max_length ? in_len - pos : max_length;
+
+	for(uint16_t d = 1; d <= max_distance && d <= pos; ++d) {
+		const uint8_t *candidate = in + pos - d;
+
+		// Only a longer match can win, check its last byte first
+		if(candidate[best_length] != in[pos + best_length] || candidate[0] != in[pos]) continue;
+
+		uint16_t length = 1;
+		while(length < limit && candidate[length] == in[pos + length]) ++length;
+		if(length > best_length) {
+			best_length = length;
+			*distance = d;
+			if(length == limit) break;
+		}
+	}
+	return best_length;
+}
+
+size_t lzss_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_size, uint8_t window_bits, uint8_t lookahead_bits) {
+	struct lzss_encoder encoder = { .buf = out, .size = out_size < in_len ? out_size : in_len };
+	const uint16_t max_distance = 1 << window_bits;
+	const uint16_t max_length = 1 << lookahead_bits;
+
+	// A back reference must be shorter than the literals it replaces
+	const uint8_t min_length = (1 + window_bits + lookahead_bits) / 9 + 1;
+
+	if(in_len > UINT16_MAX || encoder.size < LZSS_HEADER_SIZE) return 0;
+	out[0] = LZSS_MAGIC_0;
+	out[1] = LZSS_MAGIC_1;
+	out[2] = (window_bits << 4) | lookahead_bits;
+	out[3] = in_len >> 8;
+	out[4] = in_len & 0xFF;
+	encoder.len = LZSS_HEADER_SIZE;
+
+	size_t pos = 0;
+	while(pos < in_len && !encoder.overflow) {
+		uint16_t distance = 0;
+		uint16_t length = find_match(in, in_len, pos, max_distance, max_length, &distance);
+
+		if(length >= min_length) {
+			write_bits(&encoder, 0, 1);
+			write_bits(&encoder, distance - 1, window_bits);
+			write_bits(&encoder, length - 1, lookahead_bits);
+			pos += length;
+		} else {
+			write_bits(&encoder, 0x100 | in[pos], 9);
+			++pos;
+		}
+	}
+	flush_bits(&encoder);
+
+	// Output is capped at the input size, overflow means compression did not pay off
+	if(encoder.overflow || encoder.len >= in_len) return 0;
+	return encoder.len;
+}
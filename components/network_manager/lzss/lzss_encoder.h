@@ -0,0 +1,32 @@
+#ifndef LZSS_ENCODER_H
+#define LZSS_ENCODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed payloads start with this magic, never the first byte of a JSON or CBOR payload
+#define LZSS_MAGIC_0 'H'
+#define LZSS_MAGIC_1 'S'
+
+// Magic, window/lookahead bits and big endian uncompressed length
+#define LZSS_HEADER_SIZE 5
+
+// Bit stream writer over a caller owned buffer
+struct lzss_encoder {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	uint8_t bits; // Pending bits, MSB first
+	uint8_t num_bits;
+	bool overflow;
+};
+
+// Compress in_len bytes of in into out as a heatshrink compatible stream with a header:
+//   'H' 'S' (window_bits << 4 | lookahead_bits) len_msb len_lsb
+// Literals are a 1 bit and 8 bits, back references a 0 bit, window_bits of distance - 1 and
+// lookahead_bits of length - 1. The whole input is the dictionary, no window buffer is allocated.
+// Returns compressed length, 0 if the result does not fit out or would not be smaller than in
+size_t lzss_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_size, uint8_t window_bits, uint8_t lookahead_bits);
+
+#endif
@@ -0,0 +1,152 @@
+#include "burst_stream.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <string.h>
+#include <sdkconfig.h>
+
+#include "mqtt_manager.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "sensor.h"
+#include "sync_sensors.h"
+
+static struct burst_stream burst_stream;
+
+// Only used from the publish task
+static char burst_payload[BURST_PAYLOAD_SIZE];
+
+static int8_t get_sensor_id(const struct sensor *sensor) {
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		if(telemetry_get_sensor(i) == sensor) return i;
+	}
+	return -1;
+}
+
+// Must hold lock
+static bool is_streaming(int8_t sensor_id) {
+	if(sensor_id < 0 || !(burst_stream.sensor_mask & (1 << sensor_id))) return false;
+
+	// Fall back to the regular period once the burst is over
+	if(esp_timer_get_time() >= burst_stream.end_time) {
+		ESP_LOGI(BURST_STREAM_TAG, "Burst ended, %d readings published", burst_stream.published);
+		burst_stream.sensor_mask = 0;
+		return false;
+	}
+	return true;
+}
+
+void init_burst_stream() {
+	memset(&burst_stream, 0, sizeof(burst_stream));
+	burst_stream.lock = xSemaphoreCreateMutex();
+}
+
+esp_err_t burst_stream_start(uint8_t sensor_id, uint16_t period, uint16_t duration) {
+	if(sensor_id >= TELEMETRY_NUM_SENSORS || period < BURST_MIN_PERIOD || duration > BURST_MAX_DURATION) return ESP_ERR_INVALID_ARG;
+
+	xSemaphoreTake(burst_stream.lock, portMAX_DELAY);
+	if(duration == 0) {
+		burst_stream.sensor_mask &= ~(1 << sensor_id);
+	} else {
+		int64_t now = esp_timer_get_time();
+		if(burst_stream.sensor_mask == 0) {
+			burst_stream.start_time = now;
+			burst_stream.published = 0;
+		}
+
+		// All streamed sensors share the latest period and end time
+		burst_stream.sensor_mask |= 1 << sensor_id;
+		burst_stream.period = period;
+		burst_stream.end_time = now + (int64_t)duration * 1000000;
+	}
+	xSemaphoreGive(burst_stream.lock);
+
+	ESP_LOGI(BURST_STREAM_TAG, "Streaming %s every %d ms for %d s", telemetry_get_sensor(sensor_id)->name, period, duration);
+	return ESP_OK;
+}
+
+bool burst_stream_find_sensor(const char *name, uint32_t name_len, uint8_t *sensor_id) {
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		const char *sensor_name = telemetry_get_sensor(i)->name;
+		if(strlen(sensor_name) == name_len && strncmp(sensor_name, name, name_len) == 0) {
+			*sensor_id = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+TickType_t burst_stream_get_sync_timeout(const struct sensor *sensor) {
+	TickType_t timeout = pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD);
+
+	// Stop waiting for the round early, the sync bit stays set until the round completes
+	xSemaphoreTake(burst_stream.lock, portMAX_DELAY);
+	if(is_streaming(get_sensor_id(sensor))) timeout = pdMS_TO_TICKS(burst_stream.period);
+	xSemaphoreGive(burst_stream.lock);
+
+	return timeout;
+}
+
+void burst_stream_add_reading(const struct sensor *sensor) {
+	int8_t sensor_id = get_sensor_id(sensor);
+	bool is_added = false;
+
+	xSemaphoreTake(burst_stream.lock, portMAX_DELAY);
+	if(is_streaming(sensor_id)) {
+		burst_stream.values[sensor_id] = sensor_get_value(sensor);
+		burst_stream.times[sensor_id] = (esp_timer_get_time() - burst_stream.start_time) / 1000;
+		burst_stream.pending |= 1 << sensor_id;
+		is_added = true;
+	}
+	xSemaphoreGive(burst_stream.lock);
+
+	if(is_added && publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+#ifdef CONFIG_LIVE_DATA_ENCODING_CBOR
+// Reading as CBOR [sensor id, ms since burst start, value]
+static size_t create_burst_payload(uint8_t sensor_id, uint32_t time, float value) {
+	struct cbor_writer writer;
+	cbor_writer_init(&writer, (uint8_t*)burst_payload, sizeof(burst_payload));
+	cbor_writer_begin_array(&writer, 3);
+	cbor_writer_add_uint(&writer, sensor_id);
+	cbor_writer_add_uint(&writer, time);
+	cbor_writer_add_float(&writer, value);
+	if(cbor_writer_finish(&writer) == NULL) return 0;
+	return cbor_writer_length(&writer);
+}
+#else
+// Reading as {"id": sensor id, "ms": ms since burst start, "v": value}
+static size_t create_burst_payload(uint8_t sensor_id, uint32_t time, float value) {
+	struct json_writer writer;
+	json_writer_init(&writer, burst_payload, sizeof(burst_payload));
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_uint(&writer, "id", sensor_id);
+	json_writer_add_uint(&writer, "ms", time);
+	json_writer_add_float(&writer, "v", value, 3);
+	json_writer_end_object(&writer);
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+#endif
+
+void publish_burst_stream() {
+	float values[TELEMETRY_NUM_SENSORS];
+	uint32_t times[TELEMETRY_NUM_SENSORS];
+
+	xSemaphoreTake(burst_stream.lock, portMAX_DELAY);
+	uint8_t pending = burst_stream.pending;
+	burst_stream.pending = 0;
+	memcpy(values, burst_stream.values, sizeof(values));
+	memcpy(times, burst_stream.times, sizeof(times));
+	xSemaphoreGive(burst_stream.lock);
+
+	// Readings are only useful live, drop them while offline
+	if(pending == 0 || !is_mqtt_connected) return;
+
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		if(!(pending & (1 << i))) continue;
+		size_t data_len = create_burst_payload(i, times[i], values[i]);
+		if(data_len > 0 && publish_topic(BURST_DATA_TOPIC, burst_payload, data_len) >= 0) burst_stream.published++;
+	}
+}
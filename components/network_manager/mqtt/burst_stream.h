@@ -0,0 +1,61 @@
+#ifndef BURST_STREAM_H
+#define BURST_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "telemetry_batch.h"
+
+#define BURST_STREAM_TAG "BURST_STREAM"
+
+// Command keys
+#define BURST_SENSOR_KEY "sensor"
+#define BURST_PERIOD_KEY "period"
+#define BURST_DURATION_KEY "duration"
+
+// Sample period bounds and default in ms, sensors cannot be read much faster than the slowest I2C conversion
+#define BURST_MIN_PERIOD 500
+#define BURST_DEFAULT_PERIOD 1000
+
+// Burst length in s, streaming falls back to the regular period afterwards
+#define BURST_DEFAULT_DURATION 120
+#define BURST_MAX_DURATION 600
+
+// Size of a single reading payload
+#define BURST_PAYLOAD_SIZE 48
+
+// Temporary high rate streaming of selected sensors, readings are sent at QoS 0 and never spooled
+struct burst_stream {
+	uint8_t sensor_mask; // Bit per telemetry sensor id being streamed
+	uint8_t pending; // Readings not yet published
+	float values[TELEMETRY_NUM_SENSORS];
+	uint32_t times[TELEMETRY_NUM_SENSORS]; // Time of reading in ms since the burst started
+	int64_t start_time;
+	int64_t end_time;
+	uint16_t period;
+	uint32_t published;
+	SemaphoreHandle_t lock;
+};
+
+// Create lock
+void init_burst_stream();
+
+// Stream sensor every period ms for duration s, a duration of 0 stops streaming it
+esp_err_t burst_stream_start(uint8_t sensor_id, uint16_t period, uint16_t duration);
+
+// Find telemetry sensor id by name, returns false if unknown
+bool burst_stream_find_sensor(const char *name, uint32_t name_len, uint8_t *sensor_id);
+
+// Time sensor tasks wait for the sync round, shortened to the burst period while the sensor is streamed
+TickType_t burst_stream_get_sync_timeout(const struct sensor *sensor);
+
+// Queue current reading of sensor if it is streamed and wake the publish task
+void burst_stream_add_reading(const struct sensor *sensor);
+
+// Publish queued readings, called from the publish task
+void publish_burst_stream();
+
+#endif
@@ -0,0 +1,147 @@
+#include "device_metrics.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <string.h>
+#include <math.h>
+
+#include "mqtt_manager.h"
+#include "mqtt_commands.h"
+#include "mqtt_outbox.h"
+#include "json_writer.h"
+#include "rf_transmitter.h"
+#include "i2cdev.h"
+#include "sensor.h"
+#include "telemetry_batch.h"
+
+// Only used from the publish task
+static struct device_metrics device_metrics;
+static char device_metrics_payload[DEVICE_METRICS_PAYLOAD_SIZE];
+
+#ifdef DEVICE_METRICS_TASK_STATS
+static TaskStatus_t tasks[DEVICE_METRICS_MAX_TASKS];
+
+// Runtime of task in the previous snapshot, 0 for tasks created since
+static uint32_t get_prev_runtime(UBaseType_t task_number) {
+	for(UBaseType_t i = 0; i < device_metrics.num_prev_tasks; ++i) {
+		if(device_metrics.prev_task_numbers[i] == task_number) return device_metrics.prev_runtimes[i];
+	}
+	return 0;
+}
+
+// Tasks as [name, stack high-water mark in bytes, CPU share since last snapshot in permille]
+static void add_task_metrics(struct json_writer *writer) {
+	uint32_t deltas[DEVICE_METRICS_MAX_TASKS];
+	uint64_t total_delta = 0;
+
+	UBaseType_t num_tasks = uxTaskGetSystemState(tasks, DEVICE_METRICS_MAX_TASKS, NULL);
+
+	// Sum of task deltas covers both cores, so shares add up to 1000
+	for(UBaseType_t i = 0; i < num_tasks; ++i) {
+		deltas[i] = tasks[i].ulRunTimeCounter - get_prev_runtime(tasks[i].xTaskNumber);
+		total_delta += deltas[i];
+	}
+
+	json_writer_begin_array(writer, "tasks");
+	for(UBaseType_t i = 0; i < num_tasks; ++i) {
+		json_writer_begin_array(writer, NULL);
+		json_writer_add_string(writer, NULL, tasks[i].pcTaskName);
+		json_writer_add_uint(writer, NULL, tasks[i].usStackHighWaterMark * sizeof(StackType_t));
+		json_writer_add_uint(writer, NULL, total_delta == 0 ? 0 : (uint32_t)((uint64_t)deltas[i] * 1000 / total_delta));
+		json_writer_end_array(writer);
+
+		device_metrics.prev_task_numbers[i] = tasks[i].xTaskNumber;
+		device_metrics.prev_runtimes[i] = tasks[i].ulRunTimeCounter;
+	}
+	json_writer_end_array(writer);
+	device_metrics.num_prev_tasks = num_tasks;
+}
+#endif
+
+bool device_metrics_due() {
+	if(DEVICE_METRICS_PERIOD == 0) return false;
+	if(!device_metrics.has_published) return true;
+	return xTaskGetTickCount() - device_metrics.last_publish_tick >= pdMS_TO_TICKS(DEVICE_METRICS_PERIOD * 1000);
+}
+
+// Compact JSON, e.g. {"up":3600,"us":412,"heap":[free,min_free,largest_block],"tasks":[["mqtt_task",1872,12],...],"queues":{"rf":0,"cmd":0},"outbox":[bytes,peak_bytes,refused,expired],"i2c":[transactions,errors,timeouts,bus_ms],"sensors":{"ec":[samples,min,max,mean,stddev],...}}
+static size_t create_device_metrics_payload() {
+	struct json_writer writer;
+	i2cdev_stats_t i2c_stats;
+	struct mqtt_outbox_stats outbox_stats;
+	int64_t start_time = esp_timer_get_time();
+
+	json_writer_init(&writer, device_metrics_payload, sizeof(device_metrics_payload));
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_uint(&writer, "up", start_time / 1000000);
+
+	json_writer_begin_array(&writer, "heap");
+	json_writer_add_uint(&writer, NULL, esp_get_free_heap_size());
+	json_writer_add_uint(&writer, NULL, esp_get_minimum_free_heap_size());
+	json_writer_add_uint(&writer, NULL, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+	json_writer_end_array(&writer);
+
+#ifdef DEVICE_METRICS_TASK_STATS
+	add_task_metrics(&writer);
+#endif
+
+	json_writer_begin_object(&writer, "queues");
+	json_writer_add_uint(&writer, "rf", rf_transmitter_queue == NULL ? 0 : uxQueueMessagesWaiting(rf_transmitter_queue));
+	json_writer_add_uint(&writer, "cmd", mqtt_command_get_queue_depth());
+	json_writer_end_object(&writer);
+
+	mqtt_outbox_get_stats(&outbox_stats);
+	json_writer_begin_array(&writer, "outbox");
+	json_writer_add_uint(&writer, NULL, outbox_stats.size);
+	json_writer_add_uint(&writer, NULL, outbox_stats.peak_size);
+	json_writer_add_uint(&writer, NULL, outbox_stats.refused);
+	json_writer_add_uint(&writer, NULL, outbox_stats.expired);
+	json_writer_end_array(&writer);
+
+	i2cdev_get_stats(&i2c_stats);
+	json_writer_begin_array(&writer, "i2c");
+	json_writer_add_uint(&writer, NULL, i2c_stats.transactions);
+	json_writer_add_uint(&writer, NULL, i2c_stats.errors);
+	json_writer_add_uint(&writer, NULL, i2c_stats.timeouts);
+	json_writer_add_uint(&writer, NULL, (uint32_t)(i2c_stats.bus_time_us / 1000));
+	json_writer_end_array(&writer);
+
+	json_writer_begin_object(&writer, "sensors");
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		struct sensor *sensor = telemetry_get_sensor(i);
+		struct sensor_stats stats;
+		sensor_get_stats(sensor, &stats);
+		json_writer_begin_array(&writer, sensor->name);
+		json_writer_add_uint(&writer, NULL, stats.count);
+		json_writer_add_float(&writer, NULL, stats.min, 2);
+		json_writer_add_float(&writer, NULL, stats.max, 2);
+		json_writer_add_float(&writer, NULL, stats.mean, 2);
+		json_writer_add_float(&writer, NULL, sqrtf(stats.variance), 3);
+		json_writer_end_array(&writer);
+	}
+	json_writer_end_object(&writer);
+
+	// Cost of sampling, serialization of the remaining key is negligible
+	json_writer_add_uint(&writer, "us", esp_timer_get_time() - start_time);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+void publish_device_metrics() {
+	device_metrics.last_publish_tick = xTaskGetTickCount();
+	device_metrics.has_published = true;
+	if(!is_mqtt_connected) return;
+
+	size_t data_len = create_device_metrics_payload();
+	if(data_len == 0) {
+		ESP_LOGE(DEVICE_METRICS_TAG, "Metrics do not fit payload buffer");
+		return;
+	}
+
+	publish_topic(METRICS_TOPIC, device_metrics_payload, data_len);
+	ESP_LOGD(DEVICE_METRICS_TAG, "Published metrics: %d bytes", data_len);
+}
@@ -0,0 +1,43 @@
+#ifndef DEVICE_METRICS_H
+#define DEVICE_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define DEVICE_METRICS_TAG "DEVICE_METRICS"
+
+// Publish period in s, see Kconfig, 0 disables metrics
+#define DEVICE_METRICS_PERIOD CONFIG_DEVICE_METRICS_PERIOD
+
+// Max tasks reported, extra tasks are left out of the snapshot
+#define DEVICE_METRICS_MAX_TASKS 32
+
+// Size of the metrics payload buffer, a task entry takes at most ~30 bytes
+#define DEVICE_METRICS_PAYLOAD_SIZE 1280
+
+// CPU time needs the FreeRTOS run time counters
+#if defined(CONFIG_FREERTOS_USE_TRACE_FACILITY) && defined(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#define DEVICE_METRICS_TASK_STATS 1
+#endif
+
+// Runtime counters of the previous snapshot, used to report CPU share per interval
+struct device_metrics {
+	TickType_t last_publish_tick;
+	bool has_published;
+#ifdef DEVICE_METRICS_TASK_STATS
+	UBaseType_t num_prev_tasks;
+	UBaseType_t prev_task_numbers[DEVICE_METRICS_MAX_TASKS];
+	uint32_t prev_runtimes[DEVICE_METRICS_MAX_TASKS];
+#endif
+};
+
+// Check if metrics period has elapsed
+bool device_metrics_due();
+
+// Sample heap, tasks, queues, I2C counters and sensor statistics and publish on the metrics topic, only called from the publish task
+void publish_device_metrics();
+
+#endif
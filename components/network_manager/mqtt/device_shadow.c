@@ -0,0 +1,416 @@
+#include "device_shadow.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+#include "mqtt_manager.h"
+#include "equipment_status.h"
+#include "json_writer.h"
+#include "nvs_manager.h"
+#include "nvs_namespace_keys.h"
+#include "control_settings_keys.h"
+#include "sensor_control.h"
+#include "ec_control.h"
+#include "ph_control.h"
+#include "water_temp_control.h"
+
+// Every control settings field
+#define CONTROL_SETTINGS_ALL ((1 << 10) - 1)
+
+static struct device_shadow device_shadow;
+
+// Only used from the publish task
+static struct shadow_state current_state;
+static struct device_settings reported_delta;
+static char shadow_payload[SHADOW_PAYLOAD_SIZE];
+
+// Only used from the command task
+static struct device_settings desired_settings;
+static struct device_settings desired_delta;
+static struct shadow_state desired_current_state;
+
+static void read_control(const struct sensor_control *control, struct control_settings *settings) {
+	memset(settings, 0, sizeof(struct control_settings));
+	settings->fields = CONTROL_SETTINGS_ALL;
+	settings->monitoring_only = !control->is_control_enabled;
+	settings->dose_time = control->dose_time;
+	settings->dose_interval = control->wait_time;
+	settings->is_day_night_active = control->is_day_night_active;
+	settings->target_value = control->target_value;
+	settings->night_target_value = control->night_target_value;
+	settings->is_up_control = control->is_up_control;
+	settings->is_down_control = control->is_down_control;
+	settings->publish_deadband = control->publish_deadband;
+	settings->publish_max_silence = control->publish_max_silence;
+}
+
+static void set_clock_time(struct tm *time, uint8_t hour, uint8_t min) {
+	memset(time, 0, sizeof(struct tm));
+	time->tm_year = 70;
+	time->tm_mday = 1;
+	time->tm_hour = hour;
+	time->tm_min = min;
+}
+
+// Light timings are only kept in NVS and the alarms
+static void read_grow_lights(struct grow_light_settings *settings) {
+	uint8_t hour, min;
+
+	memset(settings, 0, sizeof(struct grow_light_settings));
+	if(nvs_get_uint8(GROW_LIGHT_NVS_NAMESPACE, LIGHTS_ON_HR_KEY, &hour) && nvs_get_uint8(GROW_LIGHT_NVS_NAMESPACE, LIGHTS_ON_MIN_KEY, &min)) {
+		set_clock_time(&settings->lights_on, hour, min);
+		settings->fields |= GROW_LIGHT_SETTINGS_ON;
+	}
+	if(nvs_get_uint8(GROW_LIGHT_NVS_NAMESPACE, LIGHTS_OFF_HR_KEY, &hour) && nvs_get_uint8(GROW_LIGHT_NVS_NAMESPACE, LIGHTS_OFF_MIN_KEY, &min)) {
+		set_clock_time(&settings->lights_off, hour, min);
+		settings->fields |= GROW_LIGHT_SETTINGS_OFF;
+	}
+}
+
+static void read_state(struct shadow_state *state) {
+	struct device_settings *settings = &state->settings;
+
+	memset(settings, 0, sizeof(struct device_settings));
+	settings->sections = SETTINGS_SECTION_PH | SETTINGS_SECTION_EC | SETTINGS_SECTION_WATER_TEMP | SETTINGS_SECTION_IRRIGATION
+			| SETTINGS_SECTION_GROW_LIGHTS | SETTINGS_SECTION_RESERVOIR | SETTINGS_SECTION_TELEMETRY;
+
+	read_control(get_ph_control(), &settings->ph);
+	read_control(get_ec_control(), &settings->ec);
+	read_control(get_water_temp_control(), &settings->water_temp);
+
+	// Only ec doses with several pumps
+	settings->ec.pumps = (1 << EC_NUM_PUMPS) - 1;
+	memcpy(settings->ec.pump_proportions, ec_nutrient_proportions, EC_NUM_PUMPS * sizeof(float));
+
+	settings->irrigation.fields = IRRIGATION_SETTINGS_ON | IRRIGATION_SETTINGS_OFF;
+	settings->irrigation.on_interval = irrigation_on_time / 60;
+	settings->irrigation.off_interval = irrigation_off_time / 60;
+
+	read_grow_lights(&settings->grow_lights);
+
+	settings->reservoir.fields = RESERVOIR_SETTINGS_INTERVAL | RESERVOIR_SETTINGS_ENABLED | RESERVOIR_SETTINGS_DATE;
+	settings->reservoir.replacement_interval = reservoir_replacement_interval;
+	settings->reservoir.is_control_active = reservoir_control_active;
+	settings->reservoir.next_replacement_date = next_replacement_date;
+
+	telemetry_get_settings(&settings->telemetry);
+
+	equipment_status_get_rf(state->rf);
+}
+
+// Field is set in a and missing from or different in b
+static bool is_changed(uint16_t a_fields, uint16_t b_fields, uint16_t field, bool is_equal) {
+	return (a_fields & field) && (!(b_fields & field) || !is_equal);
+}
+
+static bool is_same_clock_time(const struct tm *a, const struct tm *b) {
+	return a->tm_hour == b->tm_hour && a->tm_min == b->tm_min;
+}
+
+static bool is_same_date(const struct tm *a, const struct tm *b) {
+	return a->tm_year == b->tm_year && a->tm_mon == b->tm_mon && a->tm_mday == b->tm_mday && is_same_clock_time(a, b);
+}
+
+static bool diff_control(const struct control_settings *a, const struct control_settings *b, struct control_settings *delta) {
+	*delta = *a;
+	delta->fields = 0;
+	delta->pumps = 0;
+
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_MONITORING_ONLY, a->monitoring_only == b->monitoring_only)) delta->fields |= CONTROL_SETTINGS_MONITORING_ONLY;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_DOSE_TIME, a->dose_time == b->dose_time)) delta->fields |= CONTROL_SETTINGS_DOSE_TIME;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_DOSE_INTERVAL, a->dose_interval == b->dose_interval)) delta->fields |= CONTROL_SETTINGS_DOSE_INTERVAL;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_DAY_NIGHT, a->is_day_night_active == b->is_day_night_active)) delta->fields |= CONTROL_SETTINGS_DAY_NIGHT;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_TARGET, a->target_value == b->target_value)) delta->fields |= CONTROL_SETTINGS_TARGET;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_NIGHT_TARGET, a->night_target_value == b->night_target_value)) delta->fields |= CONTROL_SETTINGS_NIGHT_TARGET;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_UP_CONTROL, a->is_up_control == b->is_up_control)) delta->fields |= CONTROL_SETTINGS_UP_CONTROL;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_DOWN_CONTROL, a->is_down_control == b->is_down_control)) delta->fields |= CONTROL_SETTINGS_DOWN_CONTROL;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_PUBLISH_DEADBAND, a->publish_deadband == b->publish_deadband)) delta->fields |= CONTROL_SETTINGS_PUBLISH_DEADBAND;
+	if(is_changed(a->fields, b->fields, CONTROL_SETTINGS_PUBLISH_MAX_SILENCE, a->publish_max_silence == b->publish_max_silence)) delta->fields |= CONTROL_SETTINGS_PUBLISH_MAX_SILENCE;
+
+	for(uint8_t i = 0; i < CONTROL_SETTINGS_MAX_PUMPS; ++i) {
+		if(is_changed(a->pumps, b->pumps, 1 << i, a->pump_proportions[i] == b->pump_proportions[i])) delta->pumps |= 1 << i;
+	}
+	return delta->fields != 0 || delta->pumps != 0;
+}
+
+// Flag sections and fields of a that are missing from or different in b, returns true if anything differs
+static bool diff_settings(const struct device_settings *a, const struct device_settings *b, struct device_settings *delta) {
+	*delta = *a;
+	delta->sections = 0;
+
+	if((a->sections & SETTINGS_SECTION_PH) && diff_control(&a->ph, &b->ph, &delta->ph)) delta->sections |= SETTINGS_SECTION_PH;
+	if((a->sections & SETTINGS_SECTION_EC) && diff_control(&a->ec, &b->ec, &delta->ec)) delta->sections |= SETTINGS_SECTION_EC;
+	if((a->sections & SETTINGS_SECTION_WATER_TEMP) && diff_control(&a->water_temp, &b->water_temp, &delta->water_temp)) delta->sections |= SETTINGS_SECTION_WATER_TEMP;
+
+	if(a->sections & SETTINGS_SECTION_IRRIGATION) {
+		const struct irrigation_settings *x = &a->irrigation, *y = &b->irrigation;
+		delta->irrigation.fields = 0;
+		if(is_changed(x->fields, y->fields, IRRIGATION_SETTINGS_ON, x->on_interval == y->on_interval)) delta->irrigation.fields |= IRRIGATION_SETTINGS_ON;
+		if(is_changed(x->fields, y->fields, IRRIGATION_SETTINGS_OFF, x->off_interval == y->off_interval)) delta->irrigation.fields |= IRRIGATION_SETTINGS_OFF;
+		if(delta->irrigation.fields != 0) delta->sections |= SETTINGS_SECTION_IRRIGATION;
+	}
+
+	// Light alarms are always set from both timings, so a change carries both
+	if(a->sections & SETTINGS_SECTION_GROW_LIGHTS) {
+		const struct grow_light_settings *x = &a->grow_lights, *y = &b->grow_lights;
+		if(is_changed(x->fields, y->fields, GROW_LIGHT_SETTINGS_ON, is_same_clock_time(&x->lights_on, &y->lights_on))
+				|| is_changed(x->fields, y->fields, GROW_LIGHT_SETTINGS_OFF, is_same_clock_time(&x->lights_off, &y->lights_off))) {
+			if(!(x->fields & GROW_LIGHT_SETTINGS_ON)) delta->grow_lights.lights_on = y->lights_on;
+			if(!(x->fields & GROW_LIGHT_SETTINGS_OFF)) delta->grow_lights.lights_off = y->lights_off;
+			delta->grow_lights.fields = (x->fields | y->fields) & (GROW_LIGHT_SETTINGS_ON | GROW_LIGHT_SETTINGS_OFF);
+			delta->sections |= SETTINGS_SECTION_GROW_LIGHTS;
+		}
+	}
+
+	if(a->sections & SETTINGS_SECTION_RESERVOIR) {
+		const struct reservoir_settings *x = &a->reservoir, *y = &b->reservoir;
+		delta->reservoir.fields = 0;
+		if(is_changed(x->fields, y->fields, RESERVOIR_SETTINGS_INTERVAL, x->replacement_interval == y->replacement_interval)) delta->reservoir.fields |= RESERVOIR_SETTINGS_INTERVAL;
+		if(is_changed(x->fields, y->fields, RESERVOIR_SETTINGS_ENABLED, x->is_control_active == y->is_control_active)) delta->reservoir.fields |= RESERVOIR_SETTINGS_ENABLED;
+		if(is_changed(x->fields, y->fields, RESERVOIR_SETTINGS_DATE, is_same_date(&x->next_replacement_date, &y->next_replacement_date))) delta->reservoir.fields |= RESERVOIR_SETTINGS_DATE;
+		if(delta->reservoir.fields != 0) delta->sections |= SETTINGS_SECTION_RESERVOIR;
+	}
+
+	if(a->sections & SETTINGS_SECTION_TELEMETRY) {
+		const struct telemetry_settings *x = &a->telemetry, *y = &b->telemetry;
+		delta->telemetry.fields = 0;
+		if(is_changed(x->fields, y->fields, TELEMETRY_SETTINGS_BATCH_SIZE, x->batch_size == y->batch_size)) delta->telemetry.fields |= TELEMETRY_SETTINGS_BATCH_SIZE;
+		if(is_changed(x->fields, y->fields, TELEMETRY_SETTINGS_BATCH_INTERVAL, x->batch_interval == y->batch_interval)) delta->telemetry.fields |= TELEMETRY_SETTINGS_BATCH_INTERVAL;
+		if(delta->telemetry.fields != 0) delta->sections |= SETTINGS_SECTION_TELEMETRY;
+	}
+
+	return delta->sections != 0;
+}
+
+static uint32_t diff_rf(const uint8_t *a, const uint8_t *b) {
+	uint32_t mask = 0;
+	for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+		if(a[i] != b[i]) mask |= 1 << i;
+	}
+	return mask;
+}
+
+// Same layout as device_settings messages so desired and reported documents can be compared key by key
+static void add_control(struct json_writer *writer, const char *key, const struct control_settings *settings) {
+	const uint16_t control_fields = CONTROL_SETTINGS_ALL & ~(CONTROL_SETTINGS_MONITORING_ONLY | CONTROL_SETTINGS_PUBLISH_DEADBAND | CONTROL_SETTINGS_PUBLISH_MAX_SILENCE);
+	char pump_key[] = PUMP_NUM "1";
+
+	json_writer_begin_object(writer, key);
+	if(settings->fields & CONTROL_SETTINGS_MONITORING_ONLY) json_writer_add_bool(writer, MONITORING_ONLY, settings->monitoring_only);
+	if(settings->fields & CONTROL_SETTINGS_PUBLISH_DEADBAND) json_writer_add_float(writer, PUBLISH_DEADBAND, settings->publish_deadband, 3);
+	if(settings->fields & CONTROL_SETTINGS_PUBLISH_MAX_SILENCE) json_writer_add_uint(writer, PUBLISH_MAX_SILENCE, settings->publish_max_silence);
+
+	if((settings->fields & control_fields) || settings->pumps) {
+		json_writer_begin_object(writer, CONTROL);
+		if(settings->fields & CONTROL_SETTINGS_DOSE_TIME) json_writer_add_float(writer, DOSING_TIME, settings->dose_time, 2);
+		if(settings->fields & CONTROL_SETTINGS_DOSE_INTERVAL) json_writer_add_float(writer, DOSING_INTERVAL, settings->dose_interval, 2);
+		if(settings->fields & CONTROL_SETTINGS_DAY_NIGHT) json_writer_add_bool(writer, DAY_AND_NIGHT, settings->is_day_night_active);
+		if(settings->fields & CONTROL_SETTINGS_TARGET) json_writer_add_float(writer, TARGET_VALUE, settings->target_value, 2);
+		if(settings->fields & CONTROL_SETTINGS_NIGHT_TARGET) json_writer_add_float(writer, NIGHT_TARGET_VALUE, settings->night_target_value, 2);
+		if(settings->fields & CONTROL_SETTINGS_UP_CONTROL) json_writer_add_bool(writer, UP_CONTROL, settings->is_up_control);
+		if(settings->fields & CONTROL_SETTINGS_DOWN_CONTROL) json_writer_add_bool(writer, DOWN_CONTROL, settings->is_down_control);
+		if(settings->pumps) {
+			json_writer_begin_object(writer, PUMPS);
+			for(uint8_t i = 0; i < CONTROL_SETTINGS_MAX_PUMPS; ++i) {
+				if(!(settings->pumps & (1 << i))) continue;
+				pump_key[PUMP_NUM_INDEX] = i + '1';
+				json_writer_add_float(writer, pump_key, settings->pump_proportions[i], 2);
+			}
+			json_writer_end_object(writer);
+		}
+		json_writer_end_object(writer);
+	}
+	json_writer_end_object(writer);
+}
+
+// Serialize flagged fields of settings and outlets in rf_mask, returns payload length or 0 if it does not fit
+static size_t create_shadow_payload(const struct device_settings *settings, const uint8_t *rf, uint32_t rf_mask, bool is_full) {
+	struct json_writer writer;
+	char key[4];
+
+	json_writer_init(&writer, shadow_payload, sizeof(shadow_payload));
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_uint(&writer, SETTINGS_VERSION_KEY, device_shadow.version);
+	if(is_full) json_writer_add_bool(&writer, SHADOW_FULL_KEY, true);
+
+	if(settings->sections & SETTINGS_SECTION_PH) add_control(&writer, "ph", &settings->ph);
+	if(settings->sections & SETTINGS_SECTION_EC) add_control(&writer, "ec", &settings->ec);
+	if(settings->sections & SETTINGS_SECTION_WATER_TEMP) add_control(&writer, "water_temp", &settings->water_temp);
+
+	if(settings->sections & SETTINGS_SECTION_IRRIGATION) {
+		json_writer_begin_object(&writer, "irrigation");
+		if(settings->irrigation.fields & IRRIGATION_SETTINGS_ON) json_writer_add_uint(&writer, IRRIGATION_ON_KEY, settings->irrigation.on_interval);
+		if(settings->irrigation.fields & IRRIGATION_SETTINGS_OFF) json_writer_add_uint(&writer, IRRIGATION_OFF_KEY, settings->irrigation.off_interval);
+		json_writer_end_object(&writer);
+	}
+	if(settings->sections & SETTINGS_SECTION_GROW_LIGHTS) {
+		json_writer_begin_object(&writer, "grow_lights");
+		if(settings->grow_lights.fields & GROW_LIGHT_SETTINGS_ON) json_writer_add_time(&writer, LIGHTS_ON_KEY, &settings->grow_lights.lights_on);
+		if(settings->grow_lights.fields & GROW_LIGHT_SETTINGS_OFF) json_writer_add_time(&writer, LIGHTS_OFF_KEY, &settings->grow_lights.lights_off);
+		json_writer_end_object(&writer);
+	}
+	if(settings->sections & SETTINGS_SECTION_RESERVOIR) {
+		json_writer_begin_object(&writer, "reservoir");
+		if(settings->reservoir.fields & RESERVOIR_SETTINGS_INTERVAL) json_writer_add_uint(&writer, RESERVOIR_REPLACEMENT_INTERVAL_KEY, settings->reservoir.replacement_interval);
+		if(settings->reservoir.fields & RESERVOIR_SETTINGS_ENABLED) json_writer_add_bool(&writer, RESERVOIR_ENABLED_KEY, settings->reservoir.is_control_active);
+		if(settings->reservoir.fields & RESERVOIR_SETTINGS_DATE) json_writer_add_time(&writer, RESERVOIR_NEXT_REPLACEMENT_DATE_KEY, &settings->reservoir.next_replacement_date);
+		json_writer_end_object(&writer);
+	}
+	if(settings->sections & SETTINGS_SECTION_TELEMETRY) {
+		json_writer_begin_object(&writer, "telemetry");
+		if(settings->telemetry.fields & TELEMETRY_SETTINGS_BATCH_SIZE) json_writer_add_uint(&writer, TELEMETRY_BATCH_SIZE_KEY, settings->telemetry.batch_size);
+		if(settings->telemetry.fields & TELEMETRY_SETTINGS_BATCH_INTERVAL) json_writer_add_uint(&writer, TELEMETRY_BATCH_INTERVAL_KEY, settings->telemetry.batch_interval);
+		json_writer_end_object(&writer);
+	}
+
+	// Full documents list every outlet, deltas are keyed by outlet
+	if(is_full) {
+		json_writer_begin_array(&writer, SHADOW_RF_KEY);
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) json_writer_add_uint(&writer, NULL, rf[i]);
+		json_writer_end_array(&writer);
+	} else if(rf_mask != 0) {
+		json_writer_begin_object(&writer, SHADOW_RF_KEY);
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+			if(!(rf_mask & (1 << i))) continue;
+			key[json_format_uint(key, i, 1)] = '\0';
+			json_writer_add_uint(&writer, key, rf[i]);
+		}
+		json_writer_end_object(&writer);
+	}
+
+	json_writer_end_object(&writer);
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+// Hand the flush to the publish task, NVS reads and publishing would block the timer task
+static void request_flush() {
+	device_shadow.is_flush_due = true;
+	if(publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+// Runs on the timer task once the coalescing window or snapshot delay has passed
+static void flush_timer_expired(TimerHandle_t timer) { request_flush(); }
+
+void device_shadow_flush() {
+	if(!device_shadow.is_flush_due) return;
+	device_shadow.is_flush_due = false;
+
+	// NVS reads stay outside the lock
+	read_state(&current_state);
+
+	xSemaphoreTake(device_shadow.lock, portMAX_DELAY);
+	device_shadow.is_flush_pending = false;
+
+	// Changes made while offline are reported against the last published state once connected
+	if(!is_mqtt_connected) {
+		xSemaphoreGive(device_shadow.lock);
+		return;
+	}
+
+	bool is_snapshot = !device_shadow.has_reported || device_shadow.is_snapshot_due;
+	bool is_changed = false;
+	uint32_t rf_mask = 0;
+	if(!is_snapshot) {
+		is_changed = diff_settings(&current_state.settings, &device_shadow.reported.settings, &reported_delta);
+		rf_mask = diff_rf(current_state.rf, device_shadow.reported.rf);
+		is_changed |= rf_mask != 0 || device_shadow.version != device_shadow.reported.settings.version;
+		is_snapshot = !is_changed && device_shadow.is_snapshot_stale;
+	}
+
+	size_t data_len = 0;
+	if(is_snapshot) data_len = create_shadow_payload(&current_state.settings, current_state.rf, 0, true);
+	else if(is_changed) data_len = create_shadow_payload(&reported_delta, current_state.rf, rf_mask, false);
+	uint32_t version = device_shadow.version;
+	xSemaphoreGive(device_shadow.lock);
+
+	if(data_len == 0) {
+		if(is_snapshot || is_changed) ESP_LOGE(DEVICE_SHADOW_TAG, "Reported state does not fit in %d byte payload buffer", SHADOW_PAYLOAD_SIZE);
+		return;
+	}
+
+	// Published without the lock, the MQTT task takes it when reconnecting
+	// Only snapshots are retained so late subscribers never see a partial state
+	if(publish_topic_retain(SHADOW_REPORTED_TOPIC, shadow_payload, data_len, is_snapshot) < 0) {
+		ESP_LOGE(DEVICE_SHADOW_TAG, "Failed to publish reported %s", is_snapshot ? "snapshot" : "delta");
+		return;
+	}
+	ESP_LOGI(DEVICE_SHADOW_TAG, "Reported %s version %d: %d bytes", is_snapshot ? "snapshot" : "delta", version, data_len);
+
+	xSemaphoreTake(device_shadow.lock, portMAX_DELAY);
+	device_shadow.reported = current_state;
+	device_shadow.reported.settings.version = version;
+	device_shadow.has_reported = true;
+	device_shadow.is_snapshot_due = false;
+	device_shadow.is_snapshot_stale = !is_snapshot;
+	xSemaphoreGive(device_shadow.lock);
+
+	// Refresh retained snapshot once changes settle, straight away if the timer queue is full
+	if(!is_snapshot && xTimerChangePeriod(device_shadow.flush_timer, pdMS_TO_TICKS(SHADOW_SNAPSHOT_DELAY), 0) != pdPASS) request_flush();
+}
+
+void init_device_shadow() {
+	memset(&device_shadow, 0, sizeof(device_shadow));
+	nvs_get_uint32(SHADOW_NVS_NAMESPACE, SHADOW_VERSION_KEY, &device_shadow.version);
+	device_shadow.lock = xSemaphoreCreateMutex();
+	device_shadow.flush_timer = xTimerCreate("device_shadow", pdMS_TO_TICKS(SHADOW_COALESCE_PERIOD), pdFALSE, NULL, flush_timer_expired);
+	ESP_LOGI(DEVICE_SHADOW_TAG, "Desired version %d", device_shadow.version);
+}
+
+// Must hold lock
+static void schedule_flush() {
+	if(device_shadow.is_flush_pending) return;
+
+	// Timer queue full, flush without coalescing rather than lose the change
+	if(xTimerChangePeriod(device_shadow.flush_timer, pdMS_TO_TICKS(SHADOW_COALESCE_PERIOD), 0) == pdPASS) device_shadow.is_flush_pending = true;
+	else request_flush();
+}
+
+void device_shadow_request_update() {
+	if(device_shadow.lock == NULL) return;
+
+	xSemaphoreTake(device_shadow.lock, portMAX_DELAY);
+	schedule_flush();
+	xSemaphoreGive(device_shadow.lock);
+}
+
+void device_shadow_resync() {
+	if(device_shadow.lock == NULL) return;
+
+	xSemaphoreTake(device_shadow.lock, portMAX_DELAY);
+	if(!device_shadow.has_reported) device_shadow.is_snapshot_due = true;
+	schedule_flush();
+	xSemaphoreGive(device_shadow.lock);
+}
+
+void device_shadow_apply_desired(const char *data, uint32_t data_len) {
+	if(parse_device_settings(data, data_len, &desired_settings) != ESP_OK) {
+		ESP_LOGE(DEVICE_SHADOW_TAG, "Desired state not applied");
+		return;
+	}
+	if(!(desired_settings.sections & SETTINGS_HAS_VERSION)) {
+		ESP_LOGE(DEVICE_SHADOW_TAG, "Desired state without version");
+		return;
+	}
+
+	// Retained desired state is delivered again on every subscribe
+	if(desired_settings.version <= device_shadow.version) {
+		ESP_LOGI(DEVICE_SHADOW_TAG, "Desired version %d already applied", desired_settings.version);
+		return;
+	}
+
+	// Settings writes NVS and restarts timers, so only touch what differs
+	read_state(&desired_current_state);
+	if(diff_settings(&desired_settings, &desired_current_state.settings, &desired_delta)) apply_device_settings(&desired_delta);
+
+	xSemaphoreTake(device_shadow.lock, portMAX_DELAY);
+	device_shadow.version = desired_settings.version;
+	xSemaphoreGive(device_shadow.lock);
+
+	nvs_handle_t *handle = nvs_get_handle(SHADOW_NVS_NAMESPACE);
+	nvs_add_uint32(handle, SHADOW_VERSION_KEY, desired_settings.version);
+	nvs_commit_data(handle);
+
+	ESP_LOGI(DEVICE_SHADOW_TAG, "Applied desired version %d, sections 0x%02x", desired_settings.version, desired_delta.sections);
+	device_shadow_request_update();
+}
@@ -0,0 +1,67 @@
+#ifndef DEVICE_SHADOW_H
+#define DEVICE_SHADOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
+#include "settings_parser.h"
+#include "rf_transmitter.h"
+
+#define DEVICE_SHADOW_TAG "DEVICE_SHADOW"
+
+// NVS key of the last applied desired version
+#define SHADOW_VERSION_KEY "version"
+
+// Keys only found in reported documents
+#define SHADOW_FULL_KEY "full"
+#define SHADOW_RF_KEY "rf"
+
+// Changes within this many ms are reported as one delta
+#define SHADOW_COALESCE_PERIOD 1000
+
+// Retained snapshot is refreshed once the state has been stable for this many ms
+#define SHADOW_SNAPSHOT_DELAY 60000
+
+// Size of the reported document buffer, a full document is about 700 bytes
+#define SHADOW_PAYLOAD_SIZE 1024
+
+// Settings and outlet states as reported, every field of settings is flagged
+struct shadow_state {
+	struct device_settings settings;
+	uint8_t rf[NUM_OUTLETS];
+};
+
+// Desired/reported reconciliation, desired documents use the device_settings layout plus a version
+// Reported snapshots are retained and flagged "full", deltas are not retained and only hold changed fields
+struct device_shadow {
+	uint32_t version; // Last applied desired version
+	struct shadow_state reported; // State last published
+	bool has_reported; // Reported state is lost on reboot, the first connect sends a snapshot
+	bool is_flush_pending; // Coalescing window running
+	volatile bool is_flush_due; // Set by the flush timer, handled by the publish task
+	bool is_snapshot_due;
+	bool is_snapshot_stale; // Retained snapshot is older than the last delta
+	SemaphoreHandle_t lock;
+	TimerHandle_t flush_timer;
+};
+
+// Load version from NVS and create flush timer
+void init_device_shadow();
+
+// Apply the fields of a desired document that differ from the current state, called from the command task
+// Documents with a version at or below the last applied one are ignored
+void device_shadow_apply_desired(const char *data, uint32_t data_len);
+
+// Report state changes at the next flush
+void device_shadow_request_update();
+
+// Publish reported state once the flush timer has expired, called from the publish task
+void device_shadow_flush();
+
+// Report what changed while disconnected, or a snapshot on the first connect
+void device_shadow_resync();
+
+#endif
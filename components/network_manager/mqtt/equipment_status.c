@@ -0,0 +1,203 @@
+#include "equipment_status.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+#include "mqtt_manager.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "device_shadow.h"
+
+static struct equipment_status equipment_status;
+
+// Only used from the publish task
+static char equipment_status_payload[EQUIPMENT_STATUS_PAYLOAD_SIZE];
+
+#ifndef CONFIG_EQUIPMENT_STATUS_ENCODING_CBOR
+static const char *control_keys[EQUIPMENT_STATUS_NUM_CONTROLS] = { "water_temp_control", "ec_control", "ph_control" };
+#endif
+
+static uint8_t count_bits(uint32_t mask) { return __builtin_popcount(mask); }
+
+#ifdef CONFIG_EQUIPMENT_STATUS_ENCODING_CBOR
+// Serialize statuses flagged in masks as CBOR, snapshots and deltas have the same layout
+static size_t create_equipment_status_payload(uint32_t rf_mask, uint8_t control_mask) {
+	struct cbor_writer writer;
+	cbor_writer_init(&writer, (uint8_t*)equipment_status_payload, sizeof(equipment_status_payload));
+	cbor_writer_begin_map(&writer, (rf_mask != 0) + (control_mask != 0));
+
+	// RF statuses keyed by outlet
+	if(rf_mask != 0) {
+		cbor_writer_add_string(&writer, "rf");
+		cbor_writer_begin_map(&writer, count_bits(rf_mask));
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+			if(!(rf_mask & (1 << i))) continue;
+			cbor_writer_add_uint(&writer, i);
+			cbor_writer_add_int(&writer, equipment_status.rf[i]);
+		}
+	}
+
+	// Control statuses keyed by sensor id
+	if(control_mask != 0) {
+		cbor_writer_add_string(&writer, "control");
+		cbor_writer_begin_map(&writer, count_bits(control_mask));
+		for(uint8_t i = 0; i < EQUIPMENT_STATUS_NUM_CONTROLS; ++i) {
+			if(!(control_mask & (1 << i))) continue;
+			cbor_writer_add_uint(&writer, i);
+			cbor_writer_add_int(&writer, equipment_status.control[i]);
+		}
+	}
+
+	if(cbor_writer_finish(&writer) == NULL) return 0;
+	return cbor_writer_length(&writer);
+}
+#else
+// Serialize statuses flagged in masks as compact JSON
+static size_t create_equipment_status_payload(uint32_t rf_mask, uint8_t control_mask) {
+	struct json_writer writer;
+	char key[4];
+
+	json_writer_init(&writer, equipment_status_payload, sizeof(equipment_status_payload));
+	json_writer_begin_object(&writer, NULL);
+
+	if(rf_mask != 0) {
+		json_writer_begin_object(&writer, "rf");
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+			if(!(rf_mask & (1 << i))) continue;
+			key[json_format_uint(key, i, 1)] = '\0';
+			json_writer_add_int(&writer, key, equipment_status.rf[i]);
+		}
+		json_writer_end_object(&writer);
+	}
+
+	if(control_mask != 0) {
+		json_writer_begin_object(&writer, "control");
+		for(uint8_t i = 0; i < EQUIPMENT_STATUS_NUM_CONTROLS; ++i) {
+			if(control_mask & (1 << i)) json_writer_add_int(&writer, control_keys[i], equipment_status.control[i]);
+		}
+		json_writer_end_object(&writer);
+	}
+
+	json_writer_end_object(&writer);
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+#endif
+
+// Hand the flush to the publish task, publishing would block the timer task
+static void request_flush() {
+	equipment_status.is_flush_due = true;
+	if(publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+// Runs on the timer task once the coalescing window or snapshot delay has passed
+static void flush_timer_expired(TimerHandle_t timer) { request_flush(); }
+
+void equipment_status_flush() {
+	const uint32_t all_rf = (1 << (NUM_OUTLETS)) - 1;
+	const uint8_t all_control = (1 << EQUIPMENT_STATUS_NUM_CONTROLS) - 1;
+	size_t data_len = 0;
+	bool is_snapshot = false;
+	bool is_refresh_due = false;
+
+	if(!equipment_status.is_flush_due) return;
+	equipment_status.is_flush_due = false;
+
+	xSemaphoreTake(equipment_status.lock, portMAX_DELAY);
+	equipment_status.is_flush_pending = false;
+
+	if(!is_mqtt_connected) {
+		// Snapshot is sent again once connected
+		equipment_status.rf_dirty = 0;
+		equipment_status.control_dirty = 0;
+	} else if(equipment_status.is_snapshot_due || (equipment_status.is_snapshot_stale && equipment_status.rf_dirty == 0 && equipment_status.control_dirty == 0)) {
+		data_len = create_equipment_status_payload(all_rf, all_control);
+		is_snapshot = true;
+		equipment_status.is_snapshot_due = false;
+		equipment_status.is_snapshot_stale = false;
+		equipment_status.rf_dirty = 0;
+		equipment_status.control_dirty = 0;
+	} else if(equipment_status.rf_dirty != 0 || equipment_status.control_dirty != 0) {
+		data_len = create_equipment_status_payload(equipment_status.rf_dirty, equipment_status.control_dirty);
+		equipment_status.rf_dirty = 0;
+		equipment_status.control_dirty = 0;
+		equipment_status.is_snapshot_stale = true;
+		is_refresh_due = true;
+	}
+	xSemaphoreGive(equipment_status.lock);
+
+	if(data_len == 0) return;
+
+	// Only the snapshot is retained so late subscribers never see a partial state
+	if(publish_topic_retain(EQUIPMENT_STATUS_TOPIC, equipment_status_payload, data_len, is_snapshot) < 0) {
+		ESP_LOGE(EQUIPMENT_STATUS_TAG, "Failed to publish %s", is_snapshot ? "snapshot" : "delta");
+	} else {
+		ESP_LOGI(EQUIPMENT_STATUS_TAG, "Published %s: %d bytes", is_snapshot ? "snapshot" : "delta", data_len);
+	}
+
+	// Refresh retained snapshot once changes settle, straight away if the timer queue is full
+	if(is_refresh_due && xTimerChangePeriod(equipment_status.flush_timer, pdMS_TO_TICKS(EQUIPMENT_STATUS_SNAPSHOT_DELAY), 0) != pdPASS) request_flush();
+}
+
+void init_equipment_status() {
+	memset(&equipment_status, 0, sizeof(equipment_status));
+	equipment_status.lock = xSemaphoreCreateMutex();
+	equipment_status.flush_timer = xTimerCreate("equipment_status", pdMS_TO_TICKS(EQUIPMENT_STATUS_COALESCE_PERIOD), pdFALSE, NULL, flush_timer_expired);
+}
+
+// Must hold lock
+static void schedule_flush() {
+	if(equipment_status.is_flush_pending) return;
+
+	// Timer queue full, flush without coalescing rather than lose the change
+	if(xTimerChangePeriod(equipment_status.flush_timer, pdMS_TO_TICKS(EQUIPMENT_STATUS_COALESCE_PERIOD), 0) == pdPASS) equipment_status.is_flush_pending = true;
+	else request_flush();
+}
+
+void equipment_status_set_rf(uint8_t outlet, uint8_t state) {
+	if(outlet >= NUM_OUTLETS || equipment_status.lock == NULL) return;
+
+	xSemaphoreTake(equipment_status.lock, portMAX_DELAY);
+	bool is_changed = equipment_status.rf[outlet] != state;
+	if(is_changed) {
+		equipment_status.rf[outlet] = state;
+		equipment_status.rf_dirty |= 1 << outlet;
+		schedule_flush();
+	}
+	xSemaphoreGive(equipment_status.lock);
+
+	// Outlet states are part of the reported shadow
+	if(is_changed) device_shadow_request_update();
+}
+
+void equipment_status_set_control(uint8_t id, uint8_t status) {
+	if(id >= EQUIPMENT_STATUS_NUM_CONTROLS || equipment_status.lock == NULL) return;
+
+	xSemaphoreTake(equipment_status.lock, portMAX_DELAY);
+	if(equipment_status.control[id] != status) {
+		equipment_status.control[id] = status;
+		equipment_status.control_dirty |= 1 << id;
+		schedule_flush();
+	}
+	xSemaphoreGive(equipment_status.lock);
+}
+
+void equipment_status_get_rf(uint8_t *states) {
+	if(equipment_status.lock == NULL) {
+		memset(states, 0, NUM_OUTLETS);
+		return;
+	}
+
+	xSemaphoreTake(equipment_status.lock, portMAX_DELAY);
+	memcpy(states, equipment_status.rf, NUM_OUTLETS);
+	xSemaphoreGive(equipment_status.lock);
+}
+
+void equipment_status_request_snapshot() {
+	if(equipment_status.lock == NULL) return;
+
+	xSemaphoreTake(equipment_status.lock, portMAX_DELAY);
+	equipment_status.is_snapshot_due = true;
+	schedule_flush();
+	xSemaphoreGive(equipment_status.lock);
+}
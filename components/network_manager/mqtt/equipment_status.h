@@ -0,0 +1,58 @@
+#ifndef EQUIPMENT_STATUS_H
+#define EQUIPMENT_STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
+#include "rf_transmitter.h"
+
+#define EQUIPMENT_STATUS_TAG "EQUIPMENT_STATUS"
+
+// Control status ids, same as the sensor ids of CBOR live_data
+#define EQUIPMENT_STATUS_WATER_TEMP 0
+#define EQUIPMENT_STATUS_EC 1
+#define EQUIPMENT_STATUS_PH 2
+#define EQUIPMENT_STATUS_NUM_CONTROLS 3
+
+// Changes within this many ms are published as one delta
+#define EQUIPMENT_STATUS_COALESCE_PERIOD 100
+
+// Retained snapshot is refreshed once statuses have been stable for this many ms
+#define EQUIPMENT_STATUS_SNAPSHOT_DELAY 5000
+
+// Size of the equipment status payload buffer
+#define EQUIPMENT_STATUS_PAYLOAD_SIZE 256
+
+struct equipment_status {
+	uint8_t rf[NUM_OUTLETS];
+	uint8_t control[EQUIPMENT_STATUS_NUM_CONTROLS];
+	uint32_t rf_dirty; // Bit per outlet changed since last flush
+	uint8_t control_dirty;
+	bool is_flush_pending; // Coalescing window running
+	volatile bool is_flush_due; // Set by the flush timer, handled by the publish task
+	bool is_snapshot_due; // Full snapshot requested, e.g. after connecting
+	bool is_snapshot_stale; // Retained snapshot is older than the last delta
+	SemaphoreHandle_t lock;
+	TimerHandle_t flush_timer;
+};
+
+// Create lock and flush timer, statuses start at 0
+void init_equipment_status();
+
+// Update statuses, publishing is deferred to the flush timer and the publish task
+void equipment_status_set_rf(uint8_t outlet, uint8_t state);
+void equipment_status_set_control(uint8_t id, uint8_t status);
+
+// Copy RF outlet states, states holds NUM_OUTLETS entries
+void equipment_status_get_rf(uint8_t *states);
+
+// Publish a full retained snapshot at the next flush
+void equipment_status_request_snapshot();
+
+// Publish changed statuses once the flush timer has expired, called from the publish task
+void equipment_status_flush();
+
+#endif
@@ -0,0 +1,53 @@
+#include "live_data_filter.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <math.h>
+
+#include "sensor.h"
+#include "sensor_control.h"
+
+// Only used from the publish task, apart from the reset flag
+static struct live_data_filter filter;
+
+static bool is_publish_due(uint8_t index, float value, int64_t now) {
+	struct sensor_control *control = telemetry_get_control(index);
+	float deadband = control_get_publish_deadband(control);
+	uint32_t max_silence = control_get_publish_max_silence(control);
+
+	if(!(filter.sent & (1 << index)) || deadband <= 0) return true;
+	if(fabsf(value - filter.last_values[index]) > deadband) return true;
+	return max_silence != 0 && now - filter.last_times[index] >= (int64_t)max_silence * 1000000;
+}
+
+uint8_t live_data_filter_select(float *values) {
+	int64_t now = esp_timer_get_time();
+	uint8_t sensor_mask = 0;
+
+	if(filter.is_reset_pending) {
+		filter.is_reset_pending = false;
+		filter.sent = 0;
+	}
+
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		values[i] = sensor_get_value(telemetry_get_sensor(i));
+		if(is_publish_due(i, values[i], now)) sensor_mask |= 1 << i;
+		else filter.suppressed++;
+	}
+	return sensor_mask;
+}
+
+void live_data_filter_commit(uint8_t sensor_mask, const float *values) {
+	int64_t now = esp_timer_get_time();
+
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		if(!(sensor_mask & (1 << i))) continue;
+		filter.last_values[i] = values[i];
+		filter.last_times[i] = now;
+		filter.sent |= 1 << i;
+		filter.published++;
+	}
+	ESP_LOGD(LIVE_DATA_FILTER_TAG, "%d readings published, %d suppressed", filter.published, filter.suppressed);
+}
+
+void live_data_filter_reset() { filter.is_reset_pending = true; }
@@ -0,0 +1,31 @@
+#ifndef LIVE_DATA_FILTER_H
+#define LIVE_DATA_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telemetry_batch.h"
+
+#define LIVE_DATA_FILTER_TAG "LIVE_DATA_FILTER"
+
+// Report by exception, a sensor is only published once its reading leaves the deadband around the last published value
+struct live_data_filter {
+	float last_values[TELEMETRY_NUM_SENSORS]; // Last published readings
+	int64_t last_times[TELEMETRY_NUM_SENSORS]; // Time of last publish in us
+	uint8_t sent; // Bit i set once sensor i has been published
+	volatile bool is_reset_pending; // Publish every sensor in the next round
+	uint32_t published; // Readings published since boot
+	uint32_t suppressed; // Readings skipped since boot
+};
+
+// Read current values and select sensors that moved past their deadband or have been silent too long
+// Returns bit mask of selected sensors, values holds the readings to publish
+uint8_t live_data_filter_select(float *values);
+
+// Remember values of selected sensors once they have been published
+void live_data_filter_commit(uint8_t sensor_mask, const float *values);
+
+// Publish every sensor in the next round, e.g. after reconnecting
+void live_data_filter_reset();
+
+#endif
@@ -0,0 +1,198 @@
+#include "log_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mqtt_manager.h"
+
+static struct log_stream log_stream = { .lock = portMUX_INITIALIZER_UNLOCKED };
+
+// Only used from the publish task
+static char log_stream_payload[LOG_STREAM_PAYLOAD_SIZE];
+
+static const char *level_names[LOG_STREAM_NUM_LEVELS] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+// Must hold lock
+static void drop_oldest_line() {
+	while(log_stream.tail != log_stream.head) {
+		if(log_stream.buffer[log_stream.tail++ % LOG_STREAM_BUFFER_SIZE] == '\n') break;
+	}
+	log_stream.dropped++;
+}
+
+// Must hold lock
+static void ring_write(const char *data, uint32_t len) {
+	while(LOG_STREAM_BUFFER_SIZE - (log_stream.head - log_stream.tail) < len) drop_oldest_line();
+
+	uint32_t index = log_stream.head % LOG_STREAM_BUFFER_SIZE;
+	uint32_t first = LOG_STREAM_BUFFER_SIZE - index;
+	if(first > len) first = len;
+	memcpy(log_stream.buffer + index, data, first);
+	memcpy(log_stream.buffer, data + first, len - first);
+	log_stream.head += len;
+}
+
+// Must hold lock
+static void copy_from_ring(char *out, uint32_t offset, uint32_t len) {
+	uint32_t index = offset % LOG_STREAM_BUFFER_SIZE;
+	uint32_t first = LOG_STREAM_BUFFER_SIZE - index;
+	if(first > len) first = len;
+	memcpy(out, log_stream.buffer + index, first);
+	memcpy(out + first, log_stream.buffer, len - first);
+}
+
+// Must hold lock
+static void start_flush() {
+	log_stream.flush_end = log_stream.head;
+	log_stream.is_flush_requested = true;
+}
+
+// Strip color codes, they take ring space and mean nothing to the backend
+static const char* strip_colors(char *line, uint32_t *len) {
+	static const char reset[] = LOG_RESET_COLOR "\n";
+	const uint32_t reset_len = sizeof(reset) - 1;
+
+	if(*len > reset_len && memcmp(line + *len - reset_len, reset, reset_len) == 0) {
+		*len -= reset_len;
+		line[(*len)++] = '\n';
+	}
+	if(line[0] == '\033') {
+		const char *start = memchr(line, 'm', *len);
+		if(start != NULL) {
+			*len -= start + 1 - line;
+			return start + 1;
+		}
+	}
+	return line;
+}
+
+// Log output hook, esp_log_write only calls it for enabled levels so disabled logs are never formatted
+static int log_stream_vprintf(const char *format, va_list args) {
+	char line[LOG_STREAM_LINE_SIZE];
+	int ret = 0;
+	bool is_notify = false;
+
+#ifdef CONFIG_LOG_STREAM_UART_ECHO
+	va_list uart_args;
+	va_copy(uart_args, args);
+	ret = log_stream.uart_vprintf(format, uart_args);
+	va_end(uart_args);
+#endif
+
+	int len = vsnprintf(line, sizeof(line), format, args);
+	if(len <= 0) return ret;
+
+	// Truncated lines still end the line
+	if(len >= (int)sizeof(line)) {
+		len = sizeof(line) - 1;
+		line[len - 1] = '\n';
+	}
+	uint32_t line_len = len;
+	const char *start = strip_colors(line, &line_len);
+
+	portENTER_CRITICAL(&log_stream.lock);
+	ring_write(start, line_len);
+
+	// Upload what led up to an error
+	if(start[0] == 'E' && !log_stream.is_flush_requested
+			&& xTaskGetTickCount() - log_stream.last_error_flush_tick >= pdMS_TO_TICKS(LOG_STREAM_ERROR_FLUSH_INTERVAL)) {
+		log_stream.last_error_flush_tick = xTaskGetTickCount();
+		start_flush();
+		is_notify = true;
+	}
+	portEXIT_CRITICAL(&log_stream.lock);
+
+	if(is_notify && publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+
+#ifdef CONFIG_LOG_STREAM_UART_ECHO
+	return ret;
+#else
+	return len;
+#endif
+}
+
+void init_log_stream() {
+	// Errors right after boot are flushed too
+	log_stream.last_error_flush_tick = xTaskGetTickCount() - pdMS_TO_TICKS(LOG_STREAM_ERROR_FLUSH_INTERVAL);
+	log_stream.uart_vprintf = esp_log_set_vprintf(log_stream_vprintf);
+}
+
+bool log_stream_set_level(const char *tag, const char *level, uint32_t level_len) {
+	for(uint8_t i = 0; i < LOG_STREAM_NUM_LEVELS; ++i) {
+		if(strlen(level_names[i]) == level_len && strncmp(level_names[i], level, level_len) == 0) {
+			esp_log_level_set(tag, i);
+			ESP_LOGI(LOG_STREAM_TAG, "Log level of %s set to %s", tag, level_names[i]);
+			return true;
+		}
+	}
+	return false;
+}
+
+void log_stream_request_flush() {
+	portENTER_CRITICAL(&log_stream.lock);
+	start_flush();
+	portEXIT_CRITICAL(&log_stream.lock);
+
+	if(publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+// Copy next batch of whole lines into the payload buffer, returns offset of the batch start
+static uint32_t read_batch(uint32_t *data_len) {
+	uint32_t len = 0;
+
+	portENTER_CRITICAL(&log_stream.lock);
+	uint32_t start = log_stream.tail;
+
+	// Report lines lost since the last batch
+	if(log_stream.dropped > 0) {
+		len = snprintf(log_stream_payload, sizeof(log_stream_payload), "-- %u lines dropped --\n", log_stream.dropped);
+		log_stream.dropped = 0;
+	}
+
+	// Lines before the flush point may already have been overwritten
+	uint32_t available = (int32_t)(log_stream.flush_end - start) > 0 ? log_stream.flush_end - start : 0;
+	uint32_t count = sizeof(log_stream_payload) - len;
+	if(count > available) count = available;
+	copy_from_ring(log_stream_payload + len, start, count);
+	portEXIT_CRITICAL(&log_stream.lock);
+
+	// Cut at the last whole line unless a single line fills the batch
+	if(count < available) {
+		uint32_t end = count;
+		while(end > 0 && log_stream_payload[len + end - 1] != '\n') --end;
+		if(end > 0) count = end;
+	}
+
+	*data_len = len + count;
+	return start + count;
+}
+
+void publish_log_stream() {
+	if(!log_stream.is_flush_requested || !is_mqtt_connected) return;
+
+	for(;;) {
+		uint32_t data_len;
+		uint32_t end = read_batch(&data_len);
+
+		portENTER_CRITICAL(&log_stream.lock);
+		bool is_done = (int32_t)(log_stream.flush_end - end) <= 0;
+		if(data_len == 0 || is_done) log_stream.is_flush_requested = false;
+		portEXIT_CRITICAL(&log_stream.lock);
+		if(data_len == 0) return;
+
+		if(publish_topic(LOG_DATA_TOPIC, log_stream_payload, data_len) < 0) {
+			// Lines stay in the ring for the next request
+			portENTER_CRITICAL(&log_stream.lock);
+			log_stream.is_flush_requested = false;
+			portEXIT_CRITICAL(&log_stream.lock);
+			return;
+		}
+
+		// Consume uploaded lines unless they were overwritten meanwhile
+		portENTER_CRITICAL(&log_stream.lock);
+		if((int32_t)(end - log_stream.tail) > 0) log_stream.tail = end;
+		portEXIT_CRITICAL(&log_stream.lock);
+
+		if(is_done) return;
+	}
+}
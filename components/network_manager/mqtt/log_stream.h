@@ -0,0 +1,55 @@
+#ifndef LOG_STREAM_H
+#define LOG_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+#define LOG_STREAM_TAG "LOG_STREAM"
+
+// Size of the log ring, see Kconfig
+#define LOG_STREAM_BUFFER_SIZE CONFIG_LOG_STREAM_BUFFER_SIZE
+
+// Lines are truncated to this length, formatted on the stack of the logging task
+#define LOG_STREAM_LINE_SIZE 128
+
+// Size of one uploaded batch of lines
+#define LOG_STREAM_PAYLOAD_SIZE 1024
+
+// Errors trigger a flush at most this often in ms, so an error loop cannot flood the broker
+#define LOG_STREAM_ERROR_FLUSH_INTERVAL 30000
+
+// Level names of the log_level command, indexed by esp_log_level_t
+#define LOG_STREAM_NUM_LEVELS 6
+
+// Captured ESP_LOG output, oldest lines are overwritten when full
+// Offsets run freely, the ring index is offset % LOG_STREAM_BUFFER_SIZE
+struct log_stream {
+	char buffer[LOG_STREAM_BUFFER_SIZE];
+	uint32_t head; // Offset of next written byte
+	uint32_t tail; // Offset of oldest line
+	uint32_t flush_end; // Lines before this offset are uploaded by the pending flush
+	uint32_t dropped; // Lines overwritten before they were uploaded
+	bool is_flush_requested;
+	TickType_t last_error_flush_tick;
+	vprintf_like_t uart_vprintf; // Previous log output, lines are echoed to it if enabled
+	portMUX_TYPE lock;
+};
+
+// Capture log output, call before anything else logs
+void init_log_stream();
+
+// Set level of tag from a level name, "*" sets all tags
+// Returns false if the level name is unknown
+bool log_stream_set_level(const char *tag, const char *level, uint32_t level_len);
+
+// Upload lines logged so far at the next publish
+void log_stream_request_flush();
+
+// Publish pending batches on the log_data topic, only called from the publish task
+void publish_log_stream();
+
+#endif
@@ -0,0 +1,109 @@
+#include "mqtt_commands.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#include "mqtt_manager.h"
+#include "mqtt_reassembly.h"
+#include "json_writer.h"
+
+static QueueHandle_t command_queue;
+static QueueHandle_t free_slots; // Indices of unused slot buffers
+static char slot_buffers[MQTT_COMMAND_NUM_SLOTS][MQTT_COMMAND_SLOT_SIZE];
+
+// Only written by the worker task
+static struct mqtt_command_stats stats;
+static char diagnostics_payload[MQTT_COMMAND_DIAGNOSTICS_PAYLOAD_SIZE];
+
+// Dropped from the MQTT task
+static volatile uint32_t dropped;
+
+void init_mqtt_commands() {
+	command_queue = xQueueCreate(MQTT_COMMAND_QUEUE_LENGTH, sizeof(struct mqtt_command));
+	free_slots = xQueueCreate(MQTT_COMMAND_NUM_SLOTS, sizeof(int8_t));
+	for(int8_t i = 0; i < MQTT_COMMAND_NUM_SLOTS; ++i) xQueueSend(free_slots, &i, 0);
+}
+
+uint8_t mqtt_command_get_queue_depth() { return uxQueueMessagesWaiting(command_queue); }
+
+static void release_data(const struct mqtt_command *command) {
+	if(command->slot == MQTT_COMMAND_REASSEMBLY_SLOT) mqtt_reassembly_release();
+	else xQueueSend(free_slots, &command->slot, 0);
+}
+
+bool mqtt_command_enqueue(topic_handler_t handler, const char *data, uint32_t data_len) {
+	struct mqtt_command command = { .handler = handler, .data_len = data_len, .enqueue_time = esp_timer_get_time() };
+
+	if(mqtt_reassembly_owns(data)) {
+		// Assembled message stays in the reassembly buffer until the worker is done
+		command.slot = MQTT_COMMAND_REASSEMBLY_SLOT;
+		command.data = data;
+	} else {
+		if(data_len > MQTT_COMMAND_SLOT_SIZE || xQueueReceive(free_slots, &command.slot, 0) != pdTRUE) {
+			ESP_LOGE(MQTT_COMMANDS_TAG, "No free slot for %d byte command", data_len);
+			dropped++;
+			return false;
+		}
+		memcpy(slot_buffers[command.slot], data, data_len);
+		command.data = slot_buffers[command.slot];
+	}
+
+	// Never block the MQTT event loop
+	if(xQueueSend(command_queue, &command, 0) != pdTRUE) {
+		ESP_LOGE(MQTT_COMMANDS_TAG, "Command queue full");
+		release_data(&command);
+		dropped++;
+		return false;
+	}
+	return true;
+}
+
+static void update_stats(int64_t start_time, int64_t end_time, int64_t enqueue_time) {
+	stats.handled++;
+	stats.dropped = dropped;
+	stats.last_wait = start_time - enqueue_time;
+	stats.last_total = end_time - enqueue_time;
+	if(stats.last_wait > stats.max_wait) stats.max_wait = stats.last_wait;
+	if(stats.last_total > stats.max_total) stats.max_total = stats.last_total;
+	stats.sum_total += stats.last_total;
+}
+
+static void publish_diagnostics() {
+	struct json_writer writer;
+
+	json_writer_init(&writer, diagnostics_payload, sizeof(diagnostics_payload));
+	json_writer_begin_object(&writer, NULL);
+	json_writer_begin_object(&writer, "commands");
+	json_writer_add_uint(&writer, "handled", stats.handled);
+	json_writer_add_uint(&writer, "dropped", stats.dropped);
+	json_writer_add_uint(&writer, "reassembly_dropped", mqtt_reassembly_get_dropped());
+	json_writer_add_uint(&writer, "last_wait_us", stats.last_wait);
+	json_writer_add_uint(&writer, "max_wait_us", stats.max_wait);
+	json_writer_add_uint(&writer, "last_us", stats.last_total);
+	json_writer_add_uint(&writer, "max_us", stats.max_total);
+	json_writer_add_uint(&writer, "avg_us", (uint32_t)(stats.sum_total / stats.handled));
+	json_writer_end_object(&writer);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return;
+	if(is_mqtt_connected) publish_topic(DIAGNOSTICS_TOPIC, diagnostics_payload, json_writer_length(&writer));
+}
+
+void mqtt_command_task(void *parameter) {
+	struct mqtt_command command;
+
+	for(;;) {
+		xQueueReceive(command_queue, &command, portMAX_DELAY);
+
+		int64_t start_time = esp_timer_get_time();
+		command.handler(command.data, command.data_len);
+		int64_t end_time = esp_timer_get_time();
+
+		release_data(&command);
+		update_stats(start_time, end_time, command.enqueue_time);
+		ESP_LOGI(MQTT_COMMANDS_TAG, "Command done in %d us, waited %d us", stats.last_total, stats.last_wait);
+
+		publish_diagnostics();
+	}
+}
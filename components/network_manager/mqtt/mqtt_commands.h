@@ -0,0 +1,61 @@
+#ifndef MQTT_COMMANDS_H
+#define MQTT_COMMANDS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include "topic_table.h"
+
+#define MQTT_COMMANDS_TAG "MQTT_COMMANDS"
+
+// Copy buffers for commands received in one event, sized like the default MQTT client buffer
+#define MQTT_COMMAND_NUM_SLOTS 3
+#define MQTT_COMMAND_SLOT_SIZE 1024
+
+// Pending commands, one per slot plus one for the reassembly buffer
+#define MQTT_COMMAND_QUEUE_LENGTH (MQTT_COMMAND_NUM_SLOTS + 1)
+
+// Marks a command whose data is in the reassembly buffer
+#define MQTT_COMMAND_REASSEMBLY_SLOT -1
+
+// Size of the diagnostics payload buffer
+#define MQTT_COMMAND_DIAGNOSTICS_PAYLOAD_SIZE 256
+
+struct mqtt_command {
+	topic_handler_t handler;
+	const char *data;
+	uint32_t data_len;
+	int8_t slot;
+	int64_t enqueue_time; // us since boot
+};
+
+// Latencies in us
+struct mqtt_command_stats {
+	uint32_t handled;
+	uint32_t dropped; // Queue or slots full
+	uint32_t last_wait; // Enqueue to start
+	uint32_t max_wait;
+	uint32_t last_total; // Enqueue to done
+	uint32_t max_total;
+	uint64_t sum_total;
+};
+
+// Task handle
+TaskHandle_t mqtt_command_task_handle;
+
+// Create queue and slot pool, must run before the MQTT client starts
+void init_mqtt_commands();
+
+// Number of commands waiting for the worker
+uint8_t mqtt_command_get_queue_depth();
+
+// Queue handler call from the MQTT event loop, data is copied unless it is in the reassembly buffer
+bool mqtt_command_enqueue(topic_handler_t handler, const char *data, uint32_t data_len);
+
+// Worker task executing queued commands
+void mqtt_command_task(void *parameter);
+
+#endif
@@ -0,0 +1,83 @@
+#include "mqtt_connection.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+
+#include "mqtt_manager.h"
+
+static struct mqtt_connection connection;
+
+uint32_t mqtt_connection_backoff(uint8_t attempts, uint32_t random) {
+	uint32_t delay = MQTT_RECONNECT_MAX_DELAY;
+	if(attempts < 16 && (MQTT_RECONNECT_MIN_DELAY << attempts) < MQTT_RECONNECT_MAX_DELAY) delay = MQTT_RECONNECT_MIN_DELAY << attempts;
+
+	// Keep half the delay so retries never collapse to zero, spread the rest so devices do not reconnect in lockstep
+	return delay / 2 + random % (delay / 2 + 1);
+}
+
+// esp-mqtt reads reconnect_timeout_ms when the connection drops, before the disconnect event is dispatched,
+// so the delay set now is the one used after the next failure
+static uint32_t set_next_delay() {
+	uint32_t delay = mqtt_connection_backoff(connection.attempts, esp_random());
+	connection.config.reconnect_timeout_ms = delay;
+	if(connection.state != MQTT_CONNECTION_IDLE && esp_mqtt_set_config(mqtt_client, &connection.config) != ESP_OK) {
+		ESP_LOGE(MQTT_CONNECTION_TAG, "Failed to set reconnect delay");
+	}
+	return delay;
+}
+
+void init_mqtt_connection(esp_mqtt_client_config_t *config) {
+	connection.state = MQTT_CONNECTION_IDLE;
+	connection.attempts = 0;
+	connection.config = *config;
+	config->reconnect_timeout_ms = set_next_delay();
+}
+
+void mqtt_connection_start() {
+	if(connection.state != MQTT_CONNECTION_IDLE) return;
+
+	connection.state = MQTT_CONNECTION_CONNECTING;
+	if(esp_mqtt_client_start(mqtt_client) != ESP_OK) {
+		ESP_LOGE(MQTT_CONNECTION_TAG, "Failed to start client");
+		connection.state = MQTT_CONNECTION_IDLE;
+	}
+}
+
+void mqtt_connection_connecting() {
+	if(connection.state == MQTT_CONNECTION_WAITING) ESP_LOGI(MQTT_CONNECTION_TAG, "Reconnecting, attempt %d", connection.attempts);
+	connection.state = MQTT_CONNECTION_CONNECTING;
+}
+
+bool mqtt_connection_connected() {
+	bool is_reconnect = connection.was_connected;
+
+	connection.state = MQTT_CONNECTION_CONNECTED;
+	connection.was_connected = true;
+	if(is_reconnect) connection.reconnects++;
+	is_mqtt_connected = true;
+
+	// Next drop starts the backoff over
+	if(connection.attempts > 0) {
+		connection.attempts = 0;
+		set_next_delay();
+	}
+
+	ESP_LOGI(MQTT_CONNECTION_TAG, "Connected, %d reconnects since boot", connection.reconnects);
+	return is_reconnect;
+}
+
+void mqtt_connection_disconnected() {
+	is_mqtt_connected = false;
+
+	// Client was stopped, or the drop was already counted
+	if(connection.state == MQTT_CONNECTION_IDLE || connection.state == MQTT_CONNECTION_WAITING) return;
+
+	uint32_t delay = connection.config.reconnect_timeout_ms;
+	connection.state = MQTT_CONNECTION_WAITING;
+	if(connection.attempts < UINT8_MAX) connection.attempts++;
+	set_next_delay();
+
+	ESP_LOGW(MQTT_CONNECTION_TAG, "Disconnected, retrying in %d ms", delay);
+}
+
+uint8_t mqtt_connection_get_state() { return connection.state; }
@@ -0,0 +1,48 @@
+#ifndef MQTT_CONNECTION_H
+#define MQTT_CONNECTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <mqtt_client.h>
+
+#define MQTT_CONNECTION_TAG "MQTT_CONNECTION"
+
+// Reconnect delay doubles per failed attempt between these bounds in ms
+#define MQTT_RECONNECT_MIN_DELAY 1000
+#define MQTT_RECONNECT_MAX_DELAY 60000
+
+// Connection states
+#define MQTT_CONNECTION_IDLE 0 // Client not started
+#define MQTT_CONNECTION_CONNECTING 1 // Waiting for CONNACK
+#define MQTT_CONNECTION_CONNECTED 2
+#define MQTT_CONNECTION_WAITING 3 // esp-mqtt waiting reconnect_timeout_ms before the next attempt
+
+// Driven by the MQTT event handler
+// esp-mqtt reconnects by itself, only its reconnect_timeout_ms is changed to back off
+struct mqtt_connection {
+	volatile uint8_t state;
+	uint8_t attempts; // Failed attempts since last connected
+	uint32_t reconnects; // Successful connects after the first
+	bool was_connected; // Connected at least once since boot
+	esp_mqtt_client_config_t config; // Reapplied with each new reconnect_timeout_ms
+};
+
+// Set the first reconnect delay in config and keep a copy, call before esp_mqtt_client_init
+void init_mqtt_connection(esp_mqtt_client_config_t *config);
+
+// Start client without blocking, retries with backoff until connected
+void mqtt_connection_start();
+
+// Update state from client events
+void mqtt_connection_connecting();
+// Returns true if this is a reconnect rather than the first connect since boot
+bool mqtt_connection_connected();
+void mqtt_connection_disconnected();
+
+// Get connection state
+uint8_t mqtt_connection_get_state();
+
+// Backoff with equal jitter, returns delay in ms before the next attempt
+uint32_t mqtt_connection_backoff(uint8_t attempts, uint32_t random);
+
+#endif
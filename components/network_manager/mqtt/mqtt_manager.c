@@ -1,3 +1,6 @@
+// Payload dumps are compiled in at debug and enabled at runtime over log_level
+#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+
 #include "mqtt_manager.h"
 
 #include <esp_event.h>
@@ -27,12 +30,95 @@
 #include "reservoir_control.h"
 #include "ports.h"
 #include "test_hardware.h"
-
-static void initiate_ota(const char *mqtt_data);
-static esp_err_t parse_ota_parameters(const char *buffer, char *version, char *endpoint);
+#include "json_writer.h"
+#include "device_metrics.h"
+#include "log_stream.h"
+#include "lzss_encoder.h"
+#include "device_shadow.h"
+#include "mqtt_outbox.h"
+#include "cbor_writer.h"
+#include "telemetry_batch.h"
+#include "telemetry_spool.h"
+#include "topic_table.h"
+#include "json_token.h"
+#include "settings_parser.h"
+#include "mqtt_reassembly.h"
+#include "mqtt_commands.h"
+#include "equipment_status.h"
+#include "mqtt_topics.h"
+#include "live_data_filter.h"
+#include "mqtt_connection.h"
+#include "burst_stream.h"
+
+static void initiate_ota(const char *mqtt_data, uint32_t data_len);
+static esp_err_t parse_ota_parameters(const char *buffer, uint32_t buffer_len, char *version, char *endpoint);
 static esp_err_t validate_ota_parameters(char *version, char *endpoint);
 static void publish_firmware_version();
-    
+static void restore_session(bool is_reconnect);
+static void settings_handler(const char *data, uint32_t data_len);
+static void grow_cycle_handler(const char *data, uint32_t data_len);
+static void rf_control_handler(const char *data, uint32_t data_len);
+static void calibration_handler(const char *data, uint32_t data_len);
+static void ota_update_handler(const char *data, uint32_t data_len);
+static void version_request_handler(const char *data, uint32_t data_len);
+static void test_motor_handler(const char *data, uint32_t data_len);
+static void test_lights_handler(const char *data, uint32_t data_len);
+static void test_ph_handler(const char *data, uint32_t data_len);
+static void test_temperature_handler(const char *data, uint32_t data_len);
+static void test_ec_handler(const char *data, uint32_t data_len);
+static void test_rf_handler(const char *data, uint32_t data_len);
+static void burst_mode_handler(const char *data, uint32_t data_len);
+static void log_level_handler(const char *data, uint32_t data_len);
+static void log_flush_handler(const char *data, uint32_t data_len);
+static void shadow_desired_handler(const char *data, uint32_t data_len);
+
+// Topic layout, resolved once into a single allocation at boot
+static const struct topic_descriptor topic_descriptors[NUM_TOPICS] = {
+	[WIFI_CONNECT_TOPIC] = { WIFI_CONNECT_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, true, NULL, &wifi_connect_topic },
+	[SENSOR_DATA_TOPIC] = { SENSOR_DATA_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &sensor_data_topic, MQTT_OUTBOX_TELEMETRY },
+	[SENSOR_DATA_BATCH_TOPIC] = { SENSOR_DATA_BATCH_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &sensor_data_batch_topic, MQTT_OUTBOX_TELEMETRY },
+	[SENSOR_DATA_SPOOL_TOPIC] = { SENSOR_DATA_SPOOL_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &sensor_data_spool_topic, MQTT_OUTBOX_TELEMETRY },
+	[DIAGNOSTICS_TOPIC] = { DIAGNOSTICS_HEADING, TOPIC_SCOPE_DEVICE_ID, 0, false, NULL, &diagnostics_topic },
+	[SENSOR_SETTINGS_TOPIC] = { SENSOR_SETTINGS_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, settings_handler, &sensor_settings_topic },
+	[EQUIPMENT_STATUS_TOPIC] = { EQUIPMENT_STATUS_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &equipment_status_topic },
+	[GROW_CYCLE_TOPIC] = { GROW_CYCLE_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, grow_cycle_handler, &grow_cycle_topic },
+	[RF_CONTROL_TOPIC] = { RF_CONTROL_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, rf_control_handler, &rf_control_topic },
+	[CALIBRATION_TOPIC] = { CALIBRATION_HEADING, TOPIC_SCOPE_DEVICE_ID, SUBSCRIBE_DATA_QOS, false, calibration_handler, &calibration_topic },
+	[TEST_MOTOR_TOPIC] = { TEST_MOTOR_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_motor_handler, &test_motor_topic },
+	[TEST_PH_TOPIC] = { TEST_PH_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_ph_handler, &test_ph_topic },
+	[TEST_LIGHTS_TOPIC] = { TEST_LIGHTS_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_lights_handler, &test_lights_topic },
+	[TEST_TEMPERATURE_TOPIC] = { TEST_TEMPERATURE_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_temperature_handler, &test_temperature_topic },
+	[TEST_EC_TOPIC] = { TEST_EC_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_ec_handler, &test_ec_topic },
+	[TEST_RF_TOPIC] = { TEST_RF_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, test_rf_handler, &test_rf_topic },
+	[OTA_UPDATE_TOPIC] = { OTA_UPDATE_HEADING, TOPIC_SCOPE_DEVICE_TYPE, SUBSCRIBE_DATA_QOS, false, ota_update_handler, &ota_update_topic },
+	[OTA_DONE_TOPIC] = { OTA_DONE_HEADING, TOPIC_SCOPE_DEVICE_TYPE, 1, false, NULL, &ota_done_topic },
+	[VERSION_REQUEST_TOPIC] = { VERSION_REQUEST_HEADING, TOPIC_SCOPE_DEVICE_TYPE, COMMAND_QOS, false, version_request_handler, &version_request_topic },
+	[VERSION_RESULT_TOPIC] = { VERSION_RESULT_HEADING, TOPIC_SCOPE_DEVICE_TYPE, 1, false, NULL, &version_result_topic },
+	[BURST_MODE_TOPIC] = { BURST_MODE_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, burst_mode_handler, &burst_mode_topic },
+	[BURST_DATA_TOPIC] = { BURST_DATA_HEADING, TOPIC_SCOPE_DEVICE_ID, 0, false, NULL, &burst_data_topic },
+	[METRICS_TOPIC] = { METRICS_HEADING, TOPIC_SCOPE_DEVICE_ID, 0, false, NULL, &metrics_topic },
+	[LOG_LEVEL_TOPIC] = { LOG_LEVEL_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, log_level_handler, &log_level_topic },
+	[LOG_FLUSH_TOPIC] = { LOG_FLUSH_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, log_flush_handler, &log_flush_topic },
+	[LOG_DATA_TOPIC] = { LOG_DATA_HEADING, TOPIC_SCOPE_DEVICE_ID, 0, false, NULL, &log_data_topic },
+	[SHADOW_DESIRED_TOPIC] = { SHADOW_DESIRED_HEADING, TOPIC_SCOPE_DEVICE_ID, COMMAND_QOS, false, shadow_desired_handler, &shadow_desired_topic },
+	[SHADOW_REPORTED_TOPIC] = { SHADOW_REPORTED_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &shadow_reported_topic },
+	[SETTINGS_ACK_TOPIC] = { SETTINGS_ACK_HEADING, TOPIC_SCOPE_DEVICE_ID, PUBLISH_DATA_QOS, false, NULL, &settings_ack_topic }
+};
+
+// Reusable buffers for live sensor data payloads
+static char sensor_data_payload[SENSOR_DATA_PAYLOAD_SIZE];
+static char sensor_data_batch_payload[TELEMETRY_BATCH_PAYLOAD_SIZE];
+static char sensor_data_spool_payload[TELEMETRY_SPOOL_PAYLOAD_SIZE];
+#ifdef CONFIG_TELEMETRY_COMPRESSION
+// Compressed output is never larger than the batch payload it replaces
+static uint8_t compressed_payload[TELEMETRY_BATCH_PAYLOAD_SIZE];
+#endif
+// Parsed settings message and its ack, only used from the command task
+static struct device_settings device_settings;
+static char settings_ack_payload[SETTINGS_ACK_PAYLOAD_SIZE];
+// Set by the publishing task when the outbox refused a spooled chunk, cleared by the event handler once an ack frees space
+static volatile bool is_spool_refused;
+
 
 extern char *url_buf;
 extern bool is_ota_success_on_bootup;
@@ -43,10 +129,12 @@ esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
    switch (event->event_id) {
       case MQTT_EVENT_CONNECTED:
          ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-         xSemaphoreGive(mqtt_connect_semaphore);
+         restore_session(mqtt_connection_connected());
          break;
       case MQTT_EVENT_DISCONNECTED:
          ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+         // Samples are spooled to flash until the client reconnects
+         mqtt_connection_disconnected();
          break;
 
       case MQTT_EVENT_SUBSCRIBED:
@@ -57,18 +145,31 @@ esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
          break;
       case MQTT_EVENT_PUBLISHED:
          ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+         if(mqtt_outbox_acked(event->msg_id)) is_spool_refused = false;
          break;
       case MQTT_EVENT_DATA:
          ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-         printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-         printf("DATA=%.*s\r\n", event->data_len, event->data);
-         data_handler(event->topic, event->topic_len, event->data, event->data_len);
+         ESP_LOGD(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
+         ESP_LOGD(TAG, "DATA=%.*s", event->data_len, event->data);
+         if(event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+            // Whole message in one event, handled without copying
+            data_handler(event->topic, event->topic_len, event->data, event->data_len);
+         } else {
+            // Message larger than the client buffer, handled once all chunks are assembled
+            const char *topic, *data;
+            uint32_t topic_len;
+            if(mqtt_reassembly_add(event->msg_id, event->topic, event->topic_len, event->data, event->data_len,
+                                   event->current_data_offset, event->total_data_len, &topic, &topic_len, &data)) {
+               data_handler(topic, topic_len, data, event->total_data_len);
+            }
+         }
          break;
       case MQTT_EVENT_ERROR:
          ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
          break;
       case MQTT_EVENT_BEFORE_CONNECT:
          ESP_LOGI(TAG, "Before Connection\n");
+         mqtt_connection_connecting();
          break;
       default:
          ESP_LOGI(TAG, "Other event id:%d", event->event_id);
@@ -78,156 +179,39 @@ esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
    return 0;
 }
 
-void create_str(char** str, char* init_str) { // Create method to allocate memory and assign initial value to string
-	*str = malloc(strlen(init_str) * sizeof(char)); // Assign memory based on size of initial value
-	if(!(*str)) { // Restart if memory alloc fails
-		ESP_LOGE("", "Memory allocation failed. Restarting ESP32");
-		restart_esp32();
-	}
-	strcpy(*str, init_str); // Copy initial value into string
-}
-void append_str(char** str, char* str_to_add) { // Create method to reallocate and append string to already allocated string
-	*str = realloc(*str, (strlen(*str) + strlen(str_to_add)) * sizeof(char) + 1); // Reallocate data based on existing and new string size
-	if(!(*str)) { // Restart if memory alloc fails
-		ESP_LOGE("", "Memory allocation failed. Restarting ESP32");
-		restart_esp32();
+void subscribe_topics() {
+	uint8_t command_qos = 0;
+
+	// Subscribe to every topic with a handler, commands share the wildcard subscription
+	for(uint8_t i = 0; i < NUM_TOPICS; ++i) {
+		const struct topic_descriptor *descriptor = &topic_descriptors[i];
+		if(descriptor->handler == NULL) continue;
+		if(topic_is_command(descriptor)) {
+			if(descriptor->qos > command_qos) command_qos = descriptor->qos;
+		} else {
+			esp_mqtt_client_subscribe(mqtt_client, *descriptor->topic, descriptor->qos);
+		}
 	}
-	strcat(*str, str_to_add); // Concatenate strings
-}
-
-// Add sensor data to JSON entry
-void add_entry(char** data, bool* first, char* name, float num) {
-	// Add a comma to the beginning of every entry except the first
-	if(*first) *first = false;
-	else append_str(data, ",");
-
-	// Convert float data into string
-	char value[8];
-	snprintf(value, sizeof(value), "%.2f", num);
-
-	// Create entry string
-	char *entry = NULL;
-	create_str(&entry, "{ \"name\": \"");
-
-	// Create entry using key, value, and other JSON syntax
-	append_str(&entry, name);
-	append_str(&entry, "\", \"value\": \"");
-	append_str(&entry, value);
-	append_str(&entry, "\"}");
-
-	// Add entry to overall JSON data
-	append_str(data, entry);
-
-	// Free allocated memory
-	free(entry);
-	entry = NULL;
-}
-
-void init_topic(char **topic, int topic_len, char *heading) {
-	*topic = malloc(sizeof(char) * topic_len);
-	strcpy(*topic, heading);
-}
 
-void add_id(char *topic) {
-	strcat(topic, "/");
-	strcat(topic, get_network_settings()->device_id);
+	// Granted QoS caps delivery, the backend publishes each command at its own QoS
+	if(get_command_topic_filter() != NULL) esp_mqtt_client_subscribe(mqtt_client, get_command_topic_filter(), command_qos);
 }
 
-void add_device_type(char *topic) {
-   strcat(topic, "/");
-   strcat(topic, DEVICE_TYPE);
+int publish_topic(topic_id_t id, const char *data, int data_len) {
+	return publish_topic_retain(id, data, data_len, topic_descriptors[id].retain);
 }
 
-void make_topics() {
-	ESP_LOGI(MQTT_TAG, "Starting make topics");
+int publish_topic_retain(topic_id_t id, const char *data, int data_len, bool retain) {
+	const struct topic_descriptor *descriptor = &topic_descriptors[id];
+	if(descriptor->qos == 0) return esp_mqtt_client_publish(mqtt_client, *descriptor->topic, data, data_len, 0, retain);
 
-	int device_id_len = strlen(get_network_settings()->device_id);
-   int device_type_len = strlen(DEVICE_TYPE);
-
-	init_topic(&wifi_connect_topic, device_id_len + 1 + strlen(WIFI_CONNECT_HEADING) + 1, WIFI_CONNECT_HEADING);
-	add_id(wifi_connect_topic);
-	ESP_LOGI(MQTT_TAG, "Wifi Topic: %s", wifi_connect_topic);
-
-	init_topic(&sensor_data_topic, device_id_len + 1 + strlen(SENSOR_DATA_HEADING) + 1, SENSOR_DATA_HEADING);
-	add_id(sensor_data_topic);
-	ESP_LOGI(MQTT_TAG, "Sensor data topic: %s", sensor_data_topic);
-
-	init_topic(&sensor_settings_topic, device_id_len + 1 + strlen(SENSOR_SETTINGS_HEADING) + 1, SENSOR_SETTINGS_HEADING);
-	add_id(sensor_settings_topic);
-	ESP_LOGI(MQTT_TAG, "Sensor settings topic: %s", sensor_settings_topic);
-
-	init_topic(&equipment_status_topic, device_id_len + 1 + strlen(EQUIPMENT_STATUS_HEADING) + 1, EQUIPMENT_STATUS_HEADING);
-	add_id(equipment_status_topic);
-	ESP_LOGI(MQTT_TAG, "Equipment settings topic: %s", equipment_status_topic);
-
-	init_topic(&grow_cycle_topic, device_id_len + 1 + strlen(GROW_CYCLE_HEADING) + 1, GROW_CYCLE_HEADING);
-	add_id(grow_cycle_topic);
-	ESP_LOGI(MQTT_TAG, "Grow cycle topic: %s", grow_cycle_topic);
-
-	init_topic(&rf_control_topic, device_id_len + 1 + strlen(RF_CONTROL_HEADING) + 1, RF_CONTROL_HEADING);
-	add_id(rf_control_topic);
-	ESP_LOGI(MQTT_TAG, "RF control settings topic: %s", rf_control_topic);
-
-	//Topic for Calibration//   
-   init_topic(&calibration_topic, device_id_len + 1 + strlen(CALIBRATION_HEADING) + 1, CALIBRATION_HEADING);
-   add_id(calibration_topic);
-   ESP_LOGI(MQTT_TAG, "Calibration sensors topic: %s", calibration_topic);
-
-   init_topic(&test_motor_topic, device_id_len + 1 + strlen(TEST_MOTOR_HEADING) + 1, TEST_MOTOR_HEADING);
-   add_id(test_motor_topic);
-   ESP_LOGI(MQTT_TAG, "Test motor topic: %s", test_motor_topic);
-
-   init_topic(&test_ph_topic, device_id_len + 1 + strlen(TEST_PH_HEADING) + 1, TEST_PH_HEADING);
-   add_id(test_ph_topic);
-   ESP_LOGI(MQTT_TAG, "Test ph topic: %s", test_ph_topic);
-
-   init_topic(&test_lights_topic, device_id_len + 1 + strlen(TEST_LIGHTS_HEADING) + 1, TEST_LIGHTS_HEADING);
-   add_id(test_lights_topic);
-   ESP_LOGI(MQTT_TAG, "Test lights topic: %s", test_lights_topic);
-
-   init_topic(&test_temperature_topic, device_id_len + 1 + strlen(TEST_TEMPERATURE_HEADING) + 1, TEST_TEMPERATURE_HEADING);
-   add_id(test_temperature_topic);
-   ESP_LOGI(MQTT_TAG, "Test water temperature topic: %s",test_temperature_topic);
-
-   init_topic(&test_ec_topic, device_id_len + 1 + strlen(TEST_EC_HEADING) + 1, TEST_EC_HEADING);
-   add_id(test_ec_topic);
-   ESP_LOGI(MQTT_TAG, "Test ec topic: %s", test_ph_topic);   
-
-   init_topic(&test_rf_topic, device_id_len + 1 + strlen(TEST_RF_HEADING) + 1, TEST_RF_HEADING);
-   add_id(test_rf_topic);
-   ESP_LOGI(MQTT_TAG, "Test rf topic: %s", test_rf_topic);
-
-   init_topic(&ota_update_topic, device_type_len + 1 + strlen(OTA_UPDATE_HEADING) + 1, OTA_UPDATE_HEADING);
-   add_device_type(ota_update_topic);
-   ESP_LOGI(MQTT_TAG, "OTA update topic: %s", ota_update_topic);
-
-   init_topic(&ota_done_topic, device_type_len + 1 + strlen(OTA_DONE_HEADING) + 1, OTA_DONE_HEADING);
-   add_device_type(ota_done_topic);
-   ESP_LOGI(MQTT_TAG, "OTA done topic: %s", ota_done_topic);
-
-   init_topic(&version_request_topic, device_type_len + 1 + strlen(VERSION_REQUEST_HEADING) + 1, VERSION_REQUEST_HEADING);
-   add_device_type(version_request_topic);
-   ESP_LOGI(MQTT_TAG, "Version request topic: %s", version_request_topic);
-
-   init_topic(&version_result_topic, device_type_len + 1 + strlen(VERSION_RESULT_HEADING) + 1, VERSION_RESULT_HEADING);
-   add_device_type(version_result_topic);
-   ESP_LOGI(MQTT_TAG, "Version result topic: %s", version_result_topic);
-}
+	// QoS > 0 messages stay in the esp-mqtt outbox until acknowledged, so telemetry is held back while the broker is not acking
+	uint32_t size = data_len + strlen(*descriptor->topic);
+	if(!mqtt_outbox_admit(descriptor->priority, size)) return MQTT_OUTBOX_REFUSED;
 
-void subscribe_topics() {
-	// Subscribe to topics
-	esp_mqtt_client_subscribe(mqtt_client, sensor_settings_topic, SUBSCRIBE_DATA_QOS);
-	esp_mqtt_client_subscribe(mqtt_client, grow_cycle_topic, SUBSCRIBE_DATA_QOS);
-	esp_mqtt_client_subscribe(mqtt_client, rf_control_topic, SUBSCRIBE_DATA_QOS);
-	esp_mqtt_client_subscribe(mqtt_client, calibration_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, ota_update_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, version_request_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_motor_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_lights_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_ph_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_temperature_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_ec_topic, SUBSCRIBE_DATA_QOS);
-   esp_mqtt_client_subscribe(mqtt_client, test_rf_topic, SUBSCRIBE_DATA_QOS);
+	int msg_id = esp_mqtt_client_publish(mqtt_client, *descriptor->topic, data, data_len, descriptor->qos, retain);
+	mqtt_outbox_add(msg_id, size);
+	return msg_id;
 }
 
 void init_mqtt() {
@@ -238,205 +222,281 @@ void init_mqtt() {
 			.event_handle = mqtt_event_handler
 	};
 
+	// Commands can arrive as soon as the client starts
+	init_mqtt_commands();
+	init_mqtt_connection(&mqtt_cfg); // Sets the first reconnect delay
+	init_burst_stream();
+
 	// Create MQTT client
 	mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
 
-	// Dynamically create topics
-	make_topics();
+	// Resolve topics and map handled topics for dispatch
+	if(resolve_topics(topic_descriptors, NUM_TOPICS, get_network_settings()->device_id, DEVICE_TYPE) != ESP_OK) restart_esp32();
 
 	// Create equipment status JSON
 	init_equipment_status();
+	init_device_shadow();
+
+	// Create telemetry ring buffer and recover flash spool
+	init_telemetry_batch();
+	init_telemetry_spool();
 }
 
 void mqtt_connect() {
-	// First check if wifi is connected
-	if(!is_wifi_connected) {
-		is_mqtt_connected = false;
-		return;
-	}
-
-	// Connect mqtt
-	mqtt_connect_semaphore = xSemaphoreCreateBinary();
-	esp_mqtt_client_start(mqtt_client);
-	xSemaphoreTake(mqtt_connect_semaphore, portMAX_DELAY); //  add approximate time to connect to mqtt
+	// Returns straight away, session is set up once the broker accepts the connection
+	if(!is_wifi_connected) ESP_LOGW(MQTT_TAG, "Wifi not connected, retrying MQTT until it is");
+	mqtt_connection_start();
+}
 
-	// Subscribe to topics
+// Runs on the MQTT task after every connect, subscriptions are lost with the clean session
+static void restore_session(bool is_reconnect) {
+	// Queue every subscription back to back instead of waiting for each SUBACK
 	subscribe_topics();
 
 	// Send connect success message (must be retain message)
-	esp_mqtt_client_publish(mqtt_client, wifi_connect_topic, "1", 0, PUBLISH_DATA_QOS, 1);
+	publish_topic(WIFI_CONNECT_TOPIC, "1", 0);
+
+	// Retained statuses and readings may have been missed while disconnected
+	equipment_status_request_snapshot();
+	live_data_filter_reset();
 
-	// Send equipment statuses
-	publish_equipment_status();
+	// Only what changed since the last report is sent after a reconnect
+	device_shadow_resync();
 
-	is_mqtt_connected = true;
+	// Start draining samples spooled while offline
+	if(publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
 
-   if (is_ota_success_on_bootup == true) {
-      printf("Publishing OTA Success result on boot up ...");
+   if (!is_reconnect && is_ota_success_on_bootup == true) {
+      ESP_LOGD(MQTT_TAG, "Publishing OTA success result on boot up");
       publish_ota_result(mqtt_client, OTA_SUCCESS, NO_FALIURE);
    }
 }
 
-void create_time_json(cJSON **time_json) {
-	char time_str[TIME_STRING_LENGTH];
+#ifdef CONFIG_LIVE_DATA_ENCODING_CBOR
+// Serialize readings of sensors in sensor_mask as CBOR into buffer, returns payload length or 0 if it does not fit
+static size_t create_sensor_data_payload(char *buffer, size_t size, uint8_t sensor_mask, const float *values) {
+	struct cbor_writer writer;
+	time_t unix_time;
+	get_unix_time(&dev, &unix_time);
+
+	cbor_writer_init(&writer, (uint8_t*)buffer, size);
+	cbor_writer_begin_map(&writer, 2);
+
+	// Adding time
+	cbor_writer_add_string(&writer, "t");
+	cbor_writer_add_uint(&writer, (uint32_t)unix_time);
+
+	// Adding readings keyed by sensor id
+	cbor_writer_add_string(&writer, "s");
+	cbor_writer_begin_map(&writer, __builtin_popcount(sensor_mask));
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		if(!(sensor_mask & (1 << i))) continue;
+		cbor_writer_add_uint(&writer, i);
+		cbor_writer_add_float(&writer, values[i]);
+	}
 
+	if(cbor_writer_finish(&writer) == NULL) return 0;
+	return cbor_writer_length(&writer);
+}
+#else
+// Serialize readings of sensors in sensor_mask into buffer, returns payload length or 0 if it does not fit
+static size_t create_sensor_data_payload(char *buffer, size_t size, uint8_t sensor_mask, const float *values) {
+	struct json_writer writer;
 	struct tm time;
 	get_date_time(&time);
 
-	sprintf(time_str, "%.4d", time.tm_year + 1900);
-	strcat(time_str, "-");
-	sprintf(time_str + 5, "%.2d", time.tm_mon + 1); // convert from (0 to 11) to (1 to 12)
-	strcat(time_str, "-");
-	sprintf(time_str + 8, "%.2d", time.tm_mday);
-	strcat(time_str, "T");
-	sprintf(time_str + 11, "%.2d", time.tm_hour);
-	strcat(time_str, ":");
-	sprintf(time_str + 14, "%.2d", time.tm_min);
-	strcat(time_str, ":");
-	sprintf(time_str + 17, "%.2d", time.tm_sec);
-	strcat(time_str, "Z");
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
 
-	*time_json = cJSON_CreateString(time_str);
-}
+	// Adding time
+	json_writer_add_time(&writer, "time", &time);
 
-void publish_sensor_data(void *parameter) {			// MQTT Setup and Data Publishing Task
-	ESP_LOGI(MQTT_TAG, "Sensor data topic: %s", sensor_data_topic);
+	// Adding water temperature, ec and pH if they changed
+	json_writer_begin_array(&writer, "sensors");
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		if(!(sensor_mask & (1 << i))) continue;
+		json_writer_begin_object(&writer, NULL);
+		json_writer_add_string(&writer, "name", telemetry_get_sensor(i)->name);
+		json_writer_add_float_string(&writer, "value", values[i], 2);
+		json_writer_end_object(&writer);
+	}
+	json_writer_end_array(&writer);
 
-	for (;;) {
-		if(!is_mqtt_connected) {
-			ESP_LOGE(MQTT_TAG, "Wifi not connected, cannot send MQTT data");
+	json_writer_end_object(&writer);
 
-			// Wait for delay period and try again
-			vTaskDelay(pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
-			continue;
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+#endif
+
+// Publish payload compressed if that makes it smaller, compressed payloads start with the "HS" header
+static int publish_topic_compressed(topic_id_t id, const char *data, size_t data_len) {
+#ifdef CONFIG_TELEMETRY_COMPRESSION
+	if(data_len >= COMPRESSION_MIN_SIZE) {
+		size_t compressed_len = lzss_compress((const uint8_t*)data, data_len, compressed_payload, sizeof(compressed_payload),
+				CONFIG_TELEMETRY_COMPRESSION_WINDOW_BITS, CONFIG_TELEMETRY_COMPRESSION_LOOKAHEAD_BITS);
+		if(compressed_len > 0) {
+			ESP_LOGD(MQTT_TAG, "Compressed %d to %d bytes", data_len, compressed_len);
+			return publish_topic(id, (const char*)compressed_payload, compressed_len);
 		}
+	}
+#endif
+	return publish_topic(id, data, data_len);
+}
 
-		cJSON *root, *time, *sensor_arr, *sensor;
-
-		// Initializing json object and sensor array
-		root = cJSON_CreateObject();
-		sensor_arr = cJSON_CreateArray();
+// Publish buffered samples as one message, samples stay buffered if publishing fails
+static void publish_sensor_data_batch() {
+	uint8_t num_samples;
+	size_t data_len = telemetry_batch_serialize(sensor_data_batch_payload, sizeof(sensor_data_batch_payload), &num_samples);
+	if(data_len == 0) {
+		ESP_LOGE(MQTT_TAG, "Sensor data batch does not fit in %d byte payload buffer", TELEMETRY_BATCH_PAYLOAD_SIZE);
+		return;
+	}
 
-		// Adding time
-		create_time_json(&time);
-		cJSON_AddItemToObject(root, "time", time);
+	int msg_id = publish_topic_compressed(SENSOR_DATA_BATCH_TOPIC, sensor_data_batch_payload, data_len);
+	if(msg_id == MQTT_OUTBOX_REFUSED) {
+		// Same as an outage, the spool keeps the newest samples
+		telemetry_batch_spool();
+		return;
+	}
+	if(msg_id < 0) {
+		ESP_LOGE(MQTT_TAG, "Failed to publish sensor data batch");
+		return;
+	}
+	telemetry_batch_consume(num_samples);
+	ESP_LOGI(MQTT_TAG, "Sensor data batch: %d samples, %d bytes", num_samples, data_len);
+}
 
-		// Adding water temperature
-		sensor_get_json(get_water_temp_sensor(), &sensor);
-		cJSON_AddItemToArray(sensor_arr, sensor);
+// Publish current readings of sensors that changed as a single message
+static void publish_live_sensor_data() {
+	float values[TELEMETRY_NUM_SENSORS];
 
-		// Adding ec
-		sensor_get_json(get_ec_sensor(), &sensor);
-		cJSON_AddItemToArray(sensor_arr, sensor);
+	// Skip sensors still inside their deadband
+	uint8_t sensor_mask = live_data_filter_select(values);
+	if(sensor_mask == 0) return;
 
-		// Adding pH
-		sensor_get_json(get_ph_sensor(), &sensor);
-		cJSON_AddItemToArray(sensor_arr, sensor);
+	// Serialize straight into the reusable payload buffer
+	size_t data_len = create_sensor_data_payload(sensor_data_payload, sizeof(sensor_data_payload), sensor_mask, values);
+	if(data_len == 0) {
+		ESP_LOGE(MQTT_TAG, "Sensor data does not fit in %d byte payload buffer", SENSOR_DATA_PAYLOAD_SIZE);
+		return;
+	}
 
-		// Adding array to object
-		cJSON_AddItemToObject(root, "sensors", sensor_arr);
+	// Publish data to MQTT broker using topic and data
+	int msg_id = publish_topic(SENSOR_DATA_TOPIC, sensor_data_payload, data_len);
+	if(msg_id == MQTT_OUTBOX_REFUSED) {
+		// Spool drains oldest first once the broker acks again and overwrites the oldest samples if it fills up
+		struct telemetry_sample sample;
+		telemetry_read_sample(&sample);
+		telemetry_spool_append(&sample);
+		return;
+	}
+	if(msg_id < 0) return;
+	live_data_filter_commit(sensor_mask, values);
+#ifdef CONFIG_LIVE_DATA_ENCODING_CBOR
+	ESP_LOGI(MQTT_TAG, "Sensor data: %d bytes", data_len);
+#else
+	ESP_LOGD(MQTT_TAG, "Sensor data: %s", sensor_data_payload);
+#endif
+}
 
-		// Creating string from JSON
-		char *data = cJSON_PrintUnformatted(root);
+// Publish next chunk of samples recorded while offline
+static void publish_spooled_sensor_data() {
+	uint32_t end_seq;
+	size_t data_len = telemetry_spool_serialize(sensor_data_spool_payload, sizeof(sensor_data_spool_payload), &end_seq);
+	if(data_len == 0) return;
 
-		// Free memory
-		cJSON_Delete(root);
+	int msg_id = publish_topic_compressed(SENSOR_DATA_SPOOL_TOPIC, sensor_data_spool_payload, data_len);
+	if(msg_id == MQTT_OUTBOX_REFUSED) {
+		// Chunk stays spooled, counted in the outbox metrics
+		is_spool_refused = true;
+		return;
+	}
+	if(msg_id < 0) {
+		ESP_LOGE(MQTT_TAG, "Failed to publish spooled sensor data");
+		return;
+	}
+	// Space may also come from expired messages rather than an ack
+	is_spool_refused = false;
+	telemetry_spool_consume(end_seq);
+	ESP_LOGI(MQTT_TAG, "Spooled sensor data sent up to seq %d", end_seq);
+}
 
-		// Publish data to MQTT broker using topic and data
-		esp_mqtt_client_publish(mqtt_client, sensor_data_topic, data, 0, PUBLISH_DATA_QOS, 0);
+void publish_sensor_data(void *parameter) {			// MQTT Setup and Data Publishing Task
+	ESP_LOGI(MQTT_TAG, "Sensor data topic: %s", sensor_data_topic);
 
-      
+	struct telemetry_sample sample;
+	TickType_t last_sample_tick = xTaskGetTickCount();
 
+	for (;;) {
+		// Wake for the next sample, once a batch is ready, or for the next spooled chunk while draining
+		// A refused chunk is retried with the next sample until an ack frees space in the outbox
+		bool is_draining = is_mqtt_connected && telemetry_spool_pending() && !is_spool_refused;
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(is_draining ? TELEMETRY_SPOOL_DRAIN_PERIOD : SENSOR_MEASUREMENT_PERIOD));
+
+		// Also sends samples left over after batching was turned off
+		if(telemetry_batch_flush_due()) {
+			if(is_mqtt_connected) publish_sensor_data_batch();
+			else telemetry_batch_spool();
+		}
 
-		ESP_LOGI(MQTT_TAG, "Sensor data: %s", data);
+		if(!telemetry_batch_enabled() && xTaskGetTickCount() - last_sample_tick >= pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD)) {
+			last_sample_tick = xTaskGetTickCount();
+			if(is_mqtt_connected) {
+				publish_live_sensor_data();
+			} else {
+				ESP_LOGW(MQTT_TAG, "MQTT not connected, spooling sensor data");
+				telemetry_read_sample(&sample);
+				telemetry_spool_append(&sample);
+			}
+		}
 
-		// Publish data every sensor reading
-		vTaskDelay(pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
-	}
+		// Readings streamed in burst mode wake the task as they arrive
+		publish_burst_stream();
 
-	free(wifi_connect_topic);
-	free(sensor_data_topic);
-	free(sensor_settings_topic);
-}
+		// Flush timers wake the task once their coalescing window has passed
+		equipment_status_flush();
+		device_shadow_flush();
 
-cJSON* get_ph_control_status() { return ph_control_status; }
-cJSON* get_ec_control_status() { return ec_control_status; }
-cJSON* get_water_temp_control_status() { return water_temp_control_status; }
-cJSON **get_rf_statuses() { return rf_statuses; }
+		if(device_metrics_due()) publish_device_metrics();
 
-void init_equipment_status() {
-	equipment_status_root = cJSON_CreateObject();
-	control_status_root = cJSON_CreateObject();
-	rf_status_root = cJSON_CreateObject();
+		// Log batches requested over log_flush or after an error
+		publish_log_stream();
 
-	// Create sensor statuses
-	ph_control_status = cJSON_CreateNumber(0);
-	ec_control_status = cJSON_CreateNumber(0);
-	water_temp_control_status = cJSON_CreateNumber(0);
-	cJSON_AddItemToObject(control_status_root, "ph_control", ph_control_status);
-	cJSON_AddItemToObject(control_status_root, "ec_control", ec_control_status);
-	cJSON_AddItemToObject(control_status_root, "water_temp_control", water_temp_control_status);
+		// Drain spool at a limited rate so live data and commands are not starved
+		if(is_mqtt_connected && telemetry_spool_pending()) publish_spooled_sensor_data();
+	}
+}
 
-	// Create rf statuses
-	char key[3];
-	for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
-		rf_statuses[i] = cJSON_CreateNumber(0);
+void update_settings(const char *settings, uint32_t settings_len) {
+	// Documents can be several kB, only dumped at debug level so they do not flood the log stream
+	ESP_LOGD(MQTT_TAG, "Settings: %.*s", (int)settings_len, settings);
 
-		sprintf(key, "%d", i);
-		cJSON_AddItemToObject(rf_status_root, key, rf_statuses[i]);
-	}
+	// A document is applied only if every section in it is valid
+	esp_err_t result = parse_device_settings(settings, settings_len, &device_settings);
+	if(result == ESP_FAIL) memset(&device_settings, 0, sizeof(device_settings));
+	bool is_applied = result == ESP_OK;
 
-	cJSON_AddItemToObject(equipment_status_root, "rf", rf_status_root);
-	cJSON_AddItemToObject(equipment_status_root, "control", control_status_root);
-}
-
-void publish_equipment_status() {
-	char *data = cJSON_Print(equipment_status_root); // Create data string
-	esp_mqtt_client_publish(mqtt_client, equipment_status_topic, data, 0, PUBLISH_DATA_QOS, 1); // Publish data
-	ESP_LOGI(MQTT_TAG, "Equipment Data: %s", data);
-}
-
-void update_settings(char *settings) {
-	cJSON *root = cJSON_Parse(settings);
-	char* string = cJSON_Print(root);
-	ESP_LOGI(MQTT_TAG, "datavalue:\n %s\n", string);
-	cJSON *object_settings = root->child;
-	
-	char *data_topic = object_settings->string;
-	ESP_LOGI(MQTT_TAG, "datatopic: %s\n", data_topic);
-
-	if(strcmp("ph", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "pH data received");
-		ph_update_settings(object_settings);
-	} else if(strcmp("ec", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "EC data received");
-		ec_update_settings(object_settings);
-	} else if(strcmp("water_temp", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "Water Temperature data received");
-		water_temp_update_settings(object_settings);
-	} else if(strcmp("irrigation", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "Irrigation data received");
-		update_irrigation_timings(object_settings);
-	} else if(strcmp("grow_lights", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "Grow Lights data received");
-		update_grow_light_timings(object_settings);
-	} else if(strcmp("reservoir", data_topic) == 0) {
-		ESP_LOGI(MQTT_TAG, "Reservoir data received");
-		update_reservoir_settings(object_settings);
+	if(is_applied) {
+		apply_device_settings(&device_settings);
+		device_shadow_request_update();
+		ESP_LOGI(MQTT_TAG, "Settings updated");
 	} else {
-		ESP_LOGE(MQTT_TAG, "Data %s not recognized", data_topic);
+		ESP_LOGE(MQTT_TAG, "Settings not applied, invalid sections: 0x%02x", device_settings.invalid_sections);
 	}
-	cJSON_Delete(root);
 
-	ESP_LOGI(MQTT_TAG, "Settings updated");
-	if(!get_is_settings_received()) settings_received();
+	// Single ack with the result of each section
+	size_t ack_len = create_settings_ack(settings_ack_payload, sizeof(settings_ack_payload), &device_settings, is_applied);
+	if(ack_len > 0) publish_topic(SETTINGS_ACK_TOPIC, settings_ack_payload, ack_len);
+
+	if(is_applied && !get_is_settings_received()) settings_received();
 }
 
-static void initiate_ota(const char *mqtt_data) {
+static void initiate_ota(const char *mqtt_data, uint32_t data_len) {
    const char *TAG = "INITIATE_OTA";
 
    char version[FIRMWARE_VERSION_LEN], endpoint[OTA_URL_SIZE];
-   if (ESP_OK == parse_ota_parameters(mqtt_data, version, endpoint)) {
+   if (ESP_OK == parse_ota_parameters(mqtt_data, data_len, version, endpoint)) {
       if (ESP_OK == validate_ota_parameters(version, endpoint)) {
          ESP_LOGI(TAG, "FW upgrade command received over MQTT - checking for valid URL\n");
          if (strlen(endpoint) > OTA_URL_SIZE) {
@@ -445,16 +505,16 @@ static void initiate_ota(const char *mqtt_data) {
          }
          else {
             /* Copy FW upgrade URL to local buffer */
-            printf("Received URL lenght is: %d\r\n", strlen(endpoint));
+            ESP_LOGD(TAG, "Received URL length is: %d", strlen(endpoint));
             url_buf = (char *)malloc(strlen(endpoint) + 1);
             if (NULL == url_buf) {
-               printf("Unable to allocate memory to save received URL\r\n");
+               ESP_LOGE(TAG, "Unable to allocate memory to save received URL");
                publish_ota_result(mqtt_client, OTA_FAIL, INVALID_OTA_URL_RECEIVED);
             }
             else {
                memset(url_buf, 0x00, strlen(endpoint) + 1);
                strncpy(url_buf, endpoint, strlen(endpoint));
-               printf("Received URL is: %s\r\n", url_buf);
+               ESP_LOGD(TAG, "Received URL is: %s", url_buf);
 
                /* Starting OTA thread */
                xTaskCreate(&ota_task, "ota_task", 8192, mqtt_client, 5, NULL);
@@ -485,34 +545,38 @@ static esp_err_t validate_ota_parameters(char *version, char *endpoint)
    return ESP_OK;
 }
 
-static esp_err_t parse_ota_parameters(const char *buffer, char *version_buf, char *endpoint_buf)
+static esp_err_t parse_ota_parameters(const char *buffer, uint32_t buffer_len, char *version_buf, char *endpoint_buf)
 {
    const char *TAG = "PARSE_OTA_PARAMETERS";
 
-   cJSON *version;
-   cJSON *endpoint;
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   int version, endpoint;
 
    if (buffer == NULL) {
       ESP_LOGI(TAG, "Invalid parameter received");
       return ESP_FAIL;
    }
 
-   cJSON *root = cJSON_Parse(buffer);
-   if (root == NULL) {
+   int num_tokens = json_tokenize(buffer, buffer_len, tokens, MQTT_MAX_MESSAGE_TOKENS);
+   if (num_tokens < 1) {
       ESP_LOGI(TAG, "Fail to deserialize Json");
       return ESP_FAIL;
    }
 
-   version = cJSON_GetObjectItemCaseSensitive(root, "version");
-   if (cJSON_IsString(version) && (version->valuestring != NULL)) {
-      strcpy(version_buf, version->valuestring);
+   // Copies are bounded by the destination buffers
+   version_buf[0] = '\0';
+   version = json_object_get(buffer, tokens, num_tokens, 0, "version");
+   if (version >= 0 && json_token_copy_string(buffer, &tokens[version], version_buf, FIRMWARE_VERSION_LEN)) {
       ESP_LOGI(TAG, "version: \"%s\"\n", version_buf);
    }
 
-   endpoint = cJSON_GetObjectItemCaseSensitive(root, "endpoint");
-   if (cJSON_IsString(endpoint) && (endpoint->valuestring != NULL)) {
-      strcpy(endpoint_buf, endpoint->valuestring);
+   endpoint_buf[0] = '\0';
+   endpoint = json_object_get(buffer, tokens, num_tokens, 0, "endpoint");
+   if (endpoint >= 0 && json_token_copy_string(buffer, &tokens[endpoint], endpoint_buf, OTA_URL_SIZE)) {
       ESP_LOGI(TAG, "endpoint: \"%s\"\n", endpoint_buf);
+   } else {
+      ESP_LOGI(TAG, "Missing or too long endpoint");
+      return ESP_FAIL;
    }
    return ESP_OK;
 }
@@ -587,107 +651,215 @@ static void create_and_publish_ota_result(esp_mqtt_client_handle_t client, ota_r
 
    ESP_LOGI(TAG, "Message: %s", data);
 
-   esp_mqtt_client_publish(client, ota_done_topic, data, 0, 1, 0);
+   publish_topic(OTA_DONE_TOPIC, data, strlen(data));
 
    ESP_LOGI(TAG, "ota_failed message publish successful, Message: %s", data);
+   free(data);
 }
 
 void publish_ota_result(esp_mqtt_client_handle_t client, ota_result_t ota_result, ota_failure_reason_t ota_failure_reason) {
    create_and_publish_ota_result(client, ota_result, ota_failure_reason);
 }
 
-void data_handler(char *topic_in, uint32_t topic_len, char *data_in, uint32_t data_len) {
-   const char *TAG = "DATA_HANDLER";
+// Tokenize small command message, returns number of tokens or 0 if it is not a json object
+static int tokenize_message(const char *data, uint32_t data_len, struct json_token *tokens) {
+   int num_tokens = json_tokenize(data, data_len, tokens, MQTT_MAX_MESSAGE_TOKENS);
+   if(num_tokens < 1 || tokens[0].type != JSON_OBJECT) {
+      ESP_LOGE(MQTT_TAG, "Invalid message: %.*s", (int)data_len, data);
+      return 0;
+   }
+   return num_tokens;
+}
+
+// Get choice and switch status of a test message
+static bool parse_test_message(const char *data, uint32_t data_len, int32_t *choice, int32_t *status) {
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   int32_t switch_status;
+
+   int num_tokens = tokenize_message(data, data_len, tokens);
+   if(num_tokens == 0) return false;
+
+   int choice_index = json_object_get(data, tokens, num_tokens, 0, "choice");
+   int status_index = json_object_get(data, tokens, num_tokens, 0, "switch_status");
+   if(choice_index < 0 || status_index < 0 ||
+      !json_token_to_int(data, &tokens[choice_index], choice) ||
+      !json_token_to_int(data, &tokens[status_index], &switch_status)) {
+      ESP_LOGE(MQTT_TAG, "Invalid test message");
+      return false;
+   }
+
+   *status = 0;
+   if (switch_status == 0 || switch_status == 1 || switch_status == -1) {
+      *status = switch_status;
+      ESP_LOGI(MQTT_TAG, "%d\n", *status);
+   }
+   return true;
+}
+
+static void settings_handler(const char *data, uint32_t data_len) {
+   // Update sensor settings
+   ESP_LOGI(MQTT_TAG, "Sensor settings received");
+   update_settings(data, data_len);
+}
+
+static void grow_cycle_handler(const char *data, uint32_t data_len) {
+   // Start/stop grow cycle according to message
+   ESP_LOGI(MQTT_TAG, "Grow cycle status received");
+   if(data_len > 0 && data[0] == '0') stop_grow_cycle();
+   else start_grow_cycle();
+}
 
-   // Create dynamically allocated vars for topic and data
-   char *topic = malloc(sizeof(char) * (topic_len+1));
-   char *data = malloc(sizeof(char) * (data_len+1));
+static void rf_control_handler(const char *data, uint32_t data_len) {
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   int32_t rf_id, rf_state;
 
-   // Copy over topic
-   for(int i = 0; i < topic_len; i++) {
-      topic[i] = topic_in[i];
+   // Message is {"<rf id>": <state>}
+   int num_tokens = tokenize_message(data, data_len, tokens);
+   if(num_tokens < 3) return;
+
+   // Key is read as a number in place
+   struct json_token id_token = tokens[1];
+   id_token.type = JSON_PRIMITIVE;
+   if(!json_token_to_int(data, &id_token, &rf_id) || !json_token_to_int(data, &tokens[2], &rf_state) || rf_id < 0 || rf_id >= NUM_OUTLETS) {
+      ESP_LOGE(MQTT_TAG, "Invalid RF control message");
+      return;
    }
-   topic[topic_len] = 0;
+   ESP_LOGI(MQTT_TAG, "RF id number %d: RF state: %d", rf_id, rf_state);
+   control_power_outlet(rf_id, rf_state);
+}
+
+static void calibration_handler(const char *data, uint32_t data_len) {
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   char type[CALIBRATION_TYPE_LEN];
 
-   // Copy over data
-   for(int i = 0; i < data_len; i++) {
-      data[i] = data_in[i];
+   ESP_LOGD(MQTT_TAG, "Calibration: %.*s", (int)data_len, data);
+   int num_tokens = tokenize_message(data, data_len, tokens);
+   if(num_tokens == 0) return;
+
+   int type_index = json_object_get(data, tokens, num_tokens, 0, "type");
+   if(type_index < 0 || !json_token_copy_string(data, &tokens[type_index], type, sizeof(type))) {
+      ESP_LOGE(MQTT_TAG, "Invalid Key Recieved, Expected Key: type");
+      return;
    }
-   data[data_len] = 0;
-
-   ESP_LOGI(TAG, "Incoming Topic: %s", topic);
-
-   // Check topic against each subscribed topic possible
-   if(strcmp(topic, sensor_settings_topic) == 0) {
-      // Update sensor settings
-      ESP_LOGI(TAG, "Sensor settings received");
-      update_settings(data);
-   } else if(strcmp(topic, grow_cycle_topic) == 0) {
-      // Start/stop grow cycle according to message
-      ESP_LOGI(TAG, "Grow cycle status received");
-      if(data[0] == '0') stop_grow_cycle();
-      else start_grow_cycle();
-   } else if(strcmp(topic, rf_control_topic) == 0) {
-      cJSON *obj = cJSON_Parse(data);
-      obj = obj->child;
-      ESP_LOGI(TAG, "RF id number %d: RF state: %d", atoi(obj->string), obj->valueint);
-      control_power_outlet(atoi(obj->string), obj->valueint);
-   } else if(strcmp(topic, calibration_topic) == 0) {
-      cJSON *obj = cJSON_Parse(data);
-      update_calibration(obj); 
-   } 	else if(strcmp(topic, ota_update_topic) == 0) {
-      // Initiate ota
-      ESP_LOGI(TAG, "OTA update message received");
-      initiate_ota(data);
-   } else if(strcmp(topic, version_request_topic) == 0) {
-      // Send back firmware version
-      ESP_LOGI(TAG, "Firmware version requested");
-      publish_firmware_version();
-   } else if(strcmp(topic, test_motor_topic) == 0) {
-      int pump_status = 0;
-      cJSON *choice;
-      cJSON *switch_status;
-      cJSON *root  = cJSON_Parse(data);  
-      choice = cJSON_GetObjectItemCaseSensitive(root, "choice");
-      switch_status = cJSON_GetObjectItemCaseSensitive(root, "switch_status");
-      if (switch_status->valueint == 0 || switch_status->valueint == 1 || switch_status->valueint == -1) {
-         pump_status = switch_status->valueint;   
-         ESP_LOGI(TAG, "%d\n",pump_status);
-      }
-      ESP_LOGI(TAG, "Received the test motor message");
-      test_motor(choice->valueint,pump_status);
-   } else if(strcmp(topic, test_lights_topic) == 0){
-      int light_status = 0;
-      cJSON *choice;
-      cJSON *switch_status;
-      cJSON *object = cJSON_Parse(data);
-      choice = cJSON_GetObjectItemCaseSensitive(object, "choice");
-      switch_status = cJSON_GetObjectItemCaseSensitive(object, "switch_status");
-      if(switch_status->valueint == 0 || switch_status->valueint == 1 || switch_status->valueint == -1){
-         light_status = switch_status->valueint;
-         ESP_LOGI(TAG, "%d\n",light_status);
+   update_calibration(type);
+}
+
+static void ota_update_handler(const char *data, uint32_t data_len) {
+   // Initiate ota
+   ESP_LOGI(MQTT_TAG, "OTA update message received");
+   initiate_ota(data, data_len);
+}
+
+static void version_request_handler(const char *data, uint32_t data_len) {
+   // Send back firmware version
+   ESP_LOGI(MQTT_TAG, "Firmware version requested");
+   publish_firmware_version();
+}
+
+static void test_motor_handler(const char *data, uint32_t data_len) {
+   int32_t choice, pump_status;
+   if(!parse_test_message(data, data_len, &choice, &pump_status)) return;
+   ESP_LOGI(MQTT_TAG, "Received the test motor message");
+   test_motor(choice, pump_status);
+}
+
+static void test_lights_handler(const char *data, uint32_t data_len) {
+   int32_t choice, light_status;
+   if(!parse_test_message(data, data_len, &choice, &light_status)) return;
+   ESP_LOGI(MQTT_TAG,"Received the test lights message");
+   test_lights(choice, light_status);
+}
+
+static void test_ph_handler(const char *data, uint32_t data_len) {
+   ESP_LOGI(MQTT_TAG, "Received the test PH message");
+   test_ph();
+}
+
+static void test_temperature_handler(const char *data, uint32_t data_len) {
+   ESP_LOGI(MQTT_TAG, "Received the test Water TEmperature message");
+   test_water_temperature();
+}
+
+static void test_ec_handler(const char *data, uint32_t data_len) {
+   ESP_LOGI(MQTT_TAG, "Received the test EC message");
+   test_ec();
+}
+
+static void test_rf_handler(const char *data, uint32_t data_len) {
+   ESP_LOGI(MQTT_TAG,"Received the test RF message");
+   test_rf();
+}
+
+static void burst_mode_handler(const char *data, uint32_t data_len) {
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   int32_t period = BURST_DEFAULT_PERIOD, duration = BURST_DEFAULT_DURATION;
+   uint8_t sensor_id;
+
+   // Message is {"sensor": "<name>", "period": <ms>, "duration": <s>}, duration 0 stops streaming
+   int num_tokens = tokenize_message(data, data_len, tokens);
+   if(num_tokens == 0) return;
+
+   int sensor_index = json_object_get(data, tokens, num_tokens, 0, BURST_SENSOR_KEY);
+   int period_index = json_object_get(data, tokens, num_tokens, 0, BURST_PERIOD_KEY);
+   int duration_index = json_object_get(data, tokens, num_tokens, 0, BURST_DURATION_KEY);
+   if(sensor_index < 0 || tokens[sensor_index].type != JSON_STRING
+         || !burst_stream_find_sensor(data + tokens[sensor_index].start, json_token_length(&tokens[sensor_index]), &sensor_id)
+         || (period_index >= 0 && !json_token_to_int(data, &tokens[period_index], &period))
+         || (duration_index >= 0 && !json_token_to_int(data, &tokens[duration_index], &duration))
+         || period < 0 || period > UINT16_MAX || duration < 0 || duration > UINT16_MAX) {
+      ESP_LOGE(MQTT_TAG, "Invalid burst mode message");
+      return;
+   }
+
+   if(burst_stream_start(sensor_id, period, duration) != ESP_OK) {
+      ESP_LOGE(MQTT_TAG, "Burst period must be at least %d ms and duration at most %d s", BURST_MIN_PERIOD, BURST_MAX_DURATION);
+   }
+}
+
+static void log_level_handler(const char *data, uint32_t data_len) {
+   struct json_token tokens[MQTT_MAX_MESSAGE_TOKENS];
+   char tag[LOG_LEVEL_MAX_TAG_LEN];
+
+   // Message is {"<tag>": "<level>", ...}, tag "*" sets all tags
+   int num_tokens = tokenize_message(data, data_len, tokens);
+   if(num_tokens == 0) return;
+
+   int key = 1;
+   for(uint16_t i = 0; i < tokens[0].size && key > 0; ++i, key = json_object_next(tokens, num_tokens, key)) {
+      const struct json_token *level = &tokens[key + 1];
+      if(!json_token_copy_string(data, &tokens[key], tag, sizeof(tag)) || level->type != JSON_STRING
+            || !log_stream_set_level(tag, data + level->start, json_token_length(level))) {
+         ESP_LOGE(MQTT_TAG, "Invalid log level: %.*s", (int)json_token_length(level), data + level->start);
       }
-      ESP_LOGI(TAG,"Received the test lights message");
-      test_lights(choice->valueint,light_status);
-   } else if(strcmp(topic, test_ph_topic) == 0){
-      ESP_LOGI(TAG, "Received the test PH message");
-      test_ph();
-   } else if(strcmp(topic, test_temperature_topic) == 0){
-      ESP_LOGI(TAG, "Received the test Water TEmperature message");
-      test_water_temperature();
-   } else if(strcmp(topic, test_ec_topic) == 0){
-      ESP_LOGI(TAG, "Received the test EC message");
-      test_ec();
-   } else if(strcmp(topic, test_rf_topic) == 0){
-      ESP_LOGI(TAG,"Received the test RF message");
-      test_rf();
-   } else {
+   }
+}
+
+static void shadow_desired_handler(const char *data, uint32_t data_len) {
+   ESP_LOGI(MQTT_TAG, "Desired state received");
+   device_shadow_apply_desired(data, data_len);
+}
+
+static void log_flush_handler(const char *data, uint32_t data_len) {
+   // Upload everything logged so far, payload is ignored
+   log_stream_request_flush();
+}
+
+void data_handler(const char *topic, uint32_t topic_len, const char *data, uint32_t data_len) {
+   const char *TAG = "DATA_HANDLER";
+
+   ESP_LOGI(TAG, "Incoming Topic: %.*s", (int)topic_len, topic);
+
+   // Look up handler straight from the event topic
+   topic_handler_t handler = lookup_topic_handler(topic, topic_len);
+   if(handler == NULL) {
       // Topic doesn't match any known topics
       ESP_LOGE(TAG, "Topic unknown");
+      if(mqtt_reassembly_owns(data)) mqtt_reassembly_release();
+      return;
    }
 
-   free(topic);
-   free(data);
+   // Handlers run on the command task so the event loop never blocks
+   mqtt_command_enqueue(handler, data, data_len);
 }
 
 static void publish_firmware_version() {
@@ -707,44 +879,38 @@ static void publish_firmware_version() {
    }
    cJSON_AddItemToObject(root, "version", version);
 
-   esp_mqtt_client_publish(mqtt_client, version_result_topic, cJSON_PrintUnformatted(root), 0, 1, 0);
+   char *data = cJSON_PrintUnformatted(root);
+   publish_topic(VERSION_RESULT_TOPIC, data, strlen(data));
    cJSON_Delete(root);
+   free(data);
 }
 
-void update_calibration(cJSON *data) {
-    cJSON *obj = data->child;  
-    char *data_string = cJSON_Print(data);
-    ESP_LOGI(MQTT_TAG, "%s", data_string);
-    if (strcmp(obj->string, "type") == 0) {
-        if (strcmp(obj->valuestring, "ph") == 0) {
-            sensor_set_calib_status(get_ph_sensor(), true);
-            ESP_LOGI(MQTT_TAG, "pH calibration received");
-            if (!get_is_grow_active()) {
-                vTaskResume(*sensor_get_task_handle(get_water_temp_sensor()));
-                vTaskResume(*sensor_get_task_handle(get_ph_sensor()));
-                ESP_LOGI(MQTT_TAG, "pH and water_temp task resumed");
-            }
-        } else if (strcmp(obj->valuestring, "ec_wet") == 0) {
-            sensor_set_calib_status(get_ec_sensor(), true);
-            ESP_LOGI(MQTT_TAG, "ec wet calibration received");
-            if (!get_is_grow_active()) {
-                vTaskResume(*sensor_get_task_handle(get_ec_sensor()));
-                ESP_LOGI(MQTT_TAG, "ec task resumed");
-            }
-        } else if (strcmp(obj->valuestring, "ec_dry") == 0) {
-            dry_calib = true; 
-            ESP_LOGI(MQTT_TAG, "ec dry calibration received");
-            if (!get_is_grow_active()) {
-                vTaskResume(*sensor_get_task_handle(get_ec_sensor()));
-                ESP_LOGI(MQTT_TAG, "ec task resumed");
-            }
-        } else {
-            ESP_LOGE(MQTT_TAG, "Invalid Value Recieved");
+void update_calibration(const char *type) {
+    if (strcmp(type, "ph") == 0) {
+        sensor_set_calib_status(get_ph_sensor(), true);
+        ESP_LOGI(MQTT_TAG, "pH calibration received");
+        if (!get_is_grow_active()) {
+            vTaskResume(*sensor_get_task_handle(get_water_temp_sensor()));
+            vTaskResume(*sensor_get_task_handle(get_ph_sensor()));
+            ESP_LOGI(MQTT_TAG, "pH and water_temp task resumed");
+        }
+    } else if (strcmp(type, "ec_wet") == 0) {
+        sensor_set_calib_status(get_ec_sensor(), true);
+        ESP_LOGI(MQTT_TAG, "ec wet calibration received");
+        if (!get_is_grow_active()) {
+            vTaskResume(*sensor_get_task_handle(get_ec_sensor()));
+            ESP_LOGI(MQTT_TAG, "ec task resumed");
+        }
+    } else if (strcmp(type, "ec_dry") == 0) {
+        dry_calib = true; 
+        ESP_LOGI(MQTT_TAG, "ec dry calibration received");
+        if (!get_is_grow_active()) {
+            vTaskResume(*sensor_get_task_handle(get_ec_sensor()));
+            ESP_LOGI(MQTT_TAG, "ec task resumed");
         }
     } else {
-        ESP_LOGE(MQTT_TAG, "Invalid Key Recieved, Expected Key: type");
+        ESP_LOGE(MQTT_TAG, "Invalid Value Recieved");
     }
-    cJSON_Delete(data);
 }
 
 void publish_pump_status(int publish_motor_choice , int publish_status){
@@ -763,10 +929,11 @@ void publish_pump_status(int publish_motor_choice , int publish_status){
 
    ESP_LOGI(TAG, "Message: %s", data);
 
-   esp_mqtt_client_publish(mqtt_client,test_motor_topic, data, 0, 1, 0);
+   publish_topic(TEST_MOTOR_TOPIC, data, strlen(data));
    cJSON_Delete(temp_obj);
 
    ESP_LOGI(TAG, "Message publish successful, Message: %s", data);
+   free(data);
 }
 
 void publish_light_status(int publish_light_choice, int publish_status)
@@ -785,8 +952,9 @@ void publish_light_status(int publish_light_choice, int publish_status)
 
    ESP_LOGI(TAG, "Message: %s", data);
 
-   esp_mqtt_client_publish(mqtt_client,test_lights_topic, data, 0, 1, 0);
+   publish_topic(TEST_LIGHTS_TOPIC, data, strlen(data));
    cJSON_Delete(info);
 
    ESP_LOGI(TAG, "Message publish successful, Message: %s", data);
+   free(data);
 }
@@ -15,11 +15,15 @@
 // QOS settings
 #define PUBLISH_DATA_QOS 1
 #define SUBSCRIBE_DATA_QOS 2
+#define COMMAND_QOS 1 // Commands that are safe to handle twice
 
 #define DEVICE_TYPE "fertigation"
 
 #define WIFI_CONNECT_HEADING "wifi_connect_status"
 #define SENSOR_DATA_HEADING "live_data"
+#define SENSOR_DATA_BATCH_HEADING "live_data_batch"
+#define SENSOR_DATA_SPOOL_HEADING "live_data_spool"
+#define DIAGNOSTICS_HEADING "diagnostics"
 #define SENSOR_SETTINGS_HEADING "device_settings"
 #define EQUIPMENT_STATUS_HEADING "equipment_status"
 #define GROW_CYCLE_HEADING "device_status"
@@ -35,6 +39,51 @@
 #define TEST_TEMPERATURE_HEADING "test_water_temperature"
 #define TEST_EC_HEADING "test_ec"
 #define TEST_RF_HEADING "test_rf"
+#define BURST_MODE_HEADING "burst_mode"
+#define BURST_DATA_HEADING "live_data_burst"
+#define METRICS_HEADING "metrics"
+#define LOG_LEVEL_HEADING "log_level"
+#define LOG_FLUSH_HEADING "log_flush"
+#define LOG_DATA_HEADING "log_data"
+#define SHADOW_DESIRED_HEADING "shadow_desired"
+#define SHADOW_REPORTED_HEADING "shadow_reported"
+#define SETTINGS_ACK_HEADING "settings_ack"
+
+/**
+ * Topic ids, index into the topic descriptor table
+ */
+typedef enum {
+    WIFI_CONNECT_TOPIC = 0,
+    SENSOR_DATA_TOPIC,
+    SENSOR_DATA_BATCH_TOPIC,
+    SENSOR_DATA_SPOOL_TOPIC,
+    DIAGNOSTICS_TOPIC,
+    SENSOR_SETTINGS_TOPIC,
+    EQUIPMENT_STATUS_TOPIC,
+    GROW_CYCLE_TOPIC,
+    RF_CONTROL_TOPIC,
+    CALIBRATION_TOPIC,
+    TEST_MOTOR_TOPIC,
+    TEST_PH_TOPIC,
+    TEST_LIGHTS_TOPIC,
+    TEST_TEMPERATURE_TOPIC,
+    TEST_EC_TOPIC,
+    TEST_RF_TOPIC,
+    OTA_UPDATE_TOPIC,
+    OTA_DONE_TOPIC,
+    VERSION_REQUEST_TOPIC,
+    VERSION_RESULT_TOPIC,
+    BURST_MODE_TOPIC,
+    BURST_DATA_TOPIC,
+    METRICS_TOPIC,
+    LOG_LEVEL_TOPIC,
+    LOG_FLUSH_TOPIC,
+    LOG_DATA_TOPIC,
+    SHADOW_DESIRED_TOPIC,
+    SHADOW_REPORTED_TOPIC,
+    SETTINGS_ACK_TOPIC,
+    NUM_TOPICS
+} topic_id_t;
 
 /**
  * OTA Result
@@ -59,7 +108,23 @@ typedef enum {
     NO_FALIURE
 } ota_failure_reason_t;
 
-#define TIME_STRING_LENGTH 21
+// Size of the live sensor data payload buffer
+#define SENSOR_DATA_PAYLOAD_SIZE 256
+
+// Size of the settings ack payload buffer, an ack with every section is about 170 bytes
+#define SETTINGS_ACK_PAYLOAD_SIZE 256
+
+// Batch and spool payloads at least this large are compressed if enabled, smaller ones gain too little
+#define COMPRESSION_MIN_SIZE 128
+
+// Max tokens in a command message (ota, calibration, rf control, tests), kept on the command task stack
+#define MQTT_MAX_MESSAGE_TOKENS 16
+
+// Max tag length of a log_level message
+#define LOG_LEVEL_MAX_TAG_LEN 32
+
+// Max length of a calibration type
+#define CALIBRATION_TYPE_LEN 16
 
 #define MQTT_TAG "MQTT_MANAGER"
 
@@ -75,6 +140,9 @@ bool is_mqtt_connected;
 // Topics
 char *wifi_connect_topic;
 char *sensor_data_topic;
+char *sensor_data_batch_topic;
+char *sensor_data_spool_topic;
+char *diagnostics_topic;
 char *sensor_settings_topic;
 char *ota_update_topic;
 char *ota_done_topic;
@@ -90,26 +158,17 @@ char *test_ph_topic;
 char *test_temperature_topic;
 char *test_ec_topic;
 char *test_rf_topic;
-
-SemaphoreHandle_t mqtt_connect_semaphore;
-
-// JSON objects for equipment status
-cJSON *equipment_status_root;
-cJSON *control_status_root;
-cJSON *ph_control_status;
-cJSON *ec_control_status;
-cJSON *water_temp_control_status;
-cJSON *rf_status_root;
-cJSON *rf_statuses[NUM_OUTLETS];
-
-
-// Get JSON objects
-cJSON *get_ph_control_status();
-cJSON *get_ec_control_status();
-cJSON *get_water_temp_control_status();
-cJSON **get_rf_statuses();
-
-// Set broker IP config in MQTT
+char *burst_mode_topic;
+char *burst_data_topic;
+char *metrics_topic;
+char *log_level_topic;
+char *log_flush_topic;
+char *log_data_topic;
+char *shadow_desired_topic;
+char *shadow_reported_topic;
+char *settings_ack_topic;
+
+// Start MQTT connection without blocking, reconnects are handled by mqtt_connection
 void mqtt_connect();
 
 // Initialize MQTT connection
@@ -119,16 +178,17 @@ void init_mqtt();
 void publish_sensor_data();
 
 // Handle data recieved through subscribed topics
-void data_handler(char *topic, uint32_t topic_len, char *data, uint32_t data_len);
+void data_handler(const char *topic, uint32_t topic_len, const char *data, uint32_t data_len);
 
-// Initialize equipment data JSON
-void init_equipment_status();
+// Update system settings from settings json, data is not null terminated
+void update_settings(const char *settings, uint32_t settings_len);
 
-// Send equipment data over MQTT
-void publish_equipment_status();
+// Publish on topic with the QoS and retain flag from its descriptor
+// Returns the message id, -1 on error, or MQTT_OUTBOX_REFUSED if telemetry is held back by the outbox limit
+int publish_topic(topic_id_t id, const char *data, int data_len);
 
-// Update system settings
-void update_settings();
+// Same as publish_topic with the retain flag of the descriptor overridden, e.g. for retained snapshots
+int publish_topic_retain(topic_id_t id, const char *data, int data_len, bool retain);
 
 // Create publishing topic
 void create_sensor_data_topic();
@@ -140,7 +200,7 @@ void create_settings_data_topic();
 void publish_ota_result(esp_mqtt_client_handle_t client, ota_result_t ota_result, ota_failure_reason_t ota_failure_reason);
 
 //Update calibration settings
-void update_calibration(cJSON *obj);
+void update_calibration(const char *type);
 
 //Publish status for motors
 void publish_pump_status(int publish_motor_choice, int publish_status);
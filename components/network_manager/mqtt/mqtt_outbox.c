@@ -0,0 +1,91 @@
+#include "mqtt_outbox.h"
+
+#include <esp_log.h>
+#include <freertos/task.h>
+
+// Shared by the publishing tasks and the MQTT event handler
+static struct mqtt_outbox mqtt_outbox = { .lock = portMUX_INITIALIZER_UNLOCKED };
+
+// Must hold lock
+static void release_entry(struct mqtt_outbox_entry *entry) {
+	mqtt_outbox.size -= entry->size;
+	entry->msg_id = 0;
+}
+
+// Must hold lock, drop messages esp-mqtt has given up on so they stop counting
+static void expire_entries(TickType_t now) {
+	for(uint8_t i = 0; i < MQTT_OUTBOX_MAX_ENTRIES; ++i) {
+		struct mqtt_outbox_entry *entry = &mqtt_outbox.entries[i];
+		if(entry->msg_id == 0 || now - entry->tick < pdMS_TO_TICKS(MQTT_OUTBOX_EXPIRE_PERIOD)) continue;
+		release_entry(entry);
+		mqtt_outbox.expired++;
+	}
+}
+
+// Must hold lock
+static struct mqtt_outbox_entry* find_free_entry() {
+	for(uint8_t i = 0; i < MQTT_OUTBOX_MAX_ENTRIES; ++i) {
+		if(mqtt_outbox.entries[i].msg_id == 0) return &mqtt_outbox.entries[i];
+	}
+	return NULL;
+}
+
+bool mqtt_outbox_admit(uint8_t priority, uint32_t size) {
+	if(priority == MQTT_OUTBOX_CONTROL) return true;
+
+	size += MQTT_OUTBOX_MESSAGE_OVERHEAD;
+	portENTER_CRITICAL(&mqtt_outbox.lock);
+	expire_entries(xTaskGetTickCount());
+	bool is_admitted = mqtt_outbox.size + size <= MQTT_OUTBOX_LIMIT && find_free_entry() != NULL;
+	if(!is_admitted) mqtt_outbox.refused++;
+	uint32_t outbox_size = mqtt_outbox.size;
+	portEXIT_CRITICAL(&mqtt_outbox.lock);
+
+	// Refusals repeat until the broker acks, a warning each time would flood the log ring
+	if(!is_admitted) ESP_LOGD(MQTT_OUTBOX_TAG, "Outbox at %d bytes, telemetry refused", outbox_size);
+	return is_admitted;
+}
+
+void mqtt_outbox_add(int msg_id, uint32_t size) {
+	// QoS 0 messages are never kept for retransmission
+	if(msg_id <= 0) return;
+
+	TickType_t now = xTaskGetTickCount();
+	portENTER_CRITICAL(&mqtt_outbox.lock);
+	expire_entries(now);
+	struct mqtt_outbox_entry *entry = find_free_entry();
+	if(entry != NULL) {
+		entry->msg_id = msg_id;
+		entry->size = size + MQTT_OUTBOX_MESSAGE_OVERHEAD;
+		entry->tick = now;
+		mqtt_outbox.size += entry->size;
+		if(mqtt_outbox.size > mqtt_outbox.peak_size) mqtt_outbox.peak_size = mqtt_outbox.size;
+	}
+	portEXIT_CRITICAL(&mqtt_outbox.lock);
+
+	if(entry == NULL) ESP_LOGW(MQTT_OUTBOX_TAG, "Outbox table full, msg_id %d not tracked", msg_id);
+}
+
+bool mqtt_outbox_acked(int msg_id) {
+	bool is_released = false;
+	if(msg_id <= 0) return false;
+
+	portENTER_CRITICAL(&mqtt_outbox.lock);
+	for(uint8_t i = 0; i < MQTT_OUTBOX_MAX_ENTRIES; ++i) {
+		if(mqtt_outbox.entries[i].msg_id != msg_id) continue;
+		release_entry(&mqtt_outbox.entries[i]);
+		is_released = true;
+		break;
+	}
+	portEXIT_CRITICAL(&mqtt_outbox.lock);
+	return is_released;
+}
+
+void mqtt_outbox_get_stats(struct mqtt_outbox_stats *stats) {
+	portENTER_CRITICAL(&mqtt_outbox.lock);
+	stats->size = mqtt_outbox.size;
+	stats->peak_size = mqtt_outbox.peak_size;
+	stats->refused = mqtt_outbox.refused;
+	stats->expired = mqtt_outbox.expired;
+	portEXIT_CRITICAL(&mqtt_outbox.lock);
+}
@@ -0,0 +1,69 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+#define MQTT_OUTBOX_TAG "MQTT_OUTBOX"
+
+// Priority classes of published topics
+#define MQTT_OUTBOX_CONTROL 0 // Commands, acks and status, never refused
+#define MQTT_OUTBOX_TELEMETRY 1 // Refused once the outbox is at its limit
+
+// Bytes of unacknowledged messages before telemetry is refused, see Kconfig
+#define MQTT_OUTBOX_LIMIT CONFIG_MQTT_OUTBOX_LIMIT
+
+// Max tracked messages, telemetry is refused and control is left untracked when full
+#define MQTT_OUTBOX_MAX_ENTRIES 32
+
+// esp-mqtt outbox item, fixed header and message id stored with each payload and topic
+#define MQTT_OUTBOX_MESSAGE_OVERHEAD 48
+
+// esp-mqtt deletes messages still unacknowledged after OUTBOX_EXPIRED_TIMEOUT_MS without an event
+#define MQTT_OUTBOX_EXPIRE_PERIOD 30000
+
+// Returned by publish_topic when telemetry is refused
+#define MQTT_OUTBOX_REFUSED -2
+
+// QoS > 0 message waiting for its PUBACK
+struct mqtt_outbox_entry {
+	int msg_id; // 0 if slot is free
+	uint16_t size;
+	TickType_t tick;
+};
+
+// Mirror of the esp-mqtt outbox, which has no size limit of its own
+struct mqtt_outbox {
+	struct mqtt_outbox_entry entries[MQTT_OUTBOX_MAX_ENTRIES];
+	uint32_t size; // Bytes of tracked messages
+	uint32_t peak_size;
+	uint32_t refused; // Telemetry messages refused, the data stays buffered or spooled
+	uint32_t expired; // Messages deleted by esp-mqtt before they were acknowledged
+	portMUX_TYPE lock;
+};
+
+// Outbox counters, see struct mqtt_outbox
+struct mqtt_outbox_stats {
+	uint32_t size;
+	uint32_t peak_size;
+	uint32_t refused;
+	uint32_t expired;
+};
+
+// Check if a message of size bytes fits, control messages always fit
+// Counts a refusal if not, logged at debug level only since the refused counter goes out with the metrics
+bool mqtt_outbox_admit(uint8_t priority, uint32_t size);
+
+// Track message published with QoS > 0 until it is acknowledged
+void mqtt_outbox_add(int msg_id, uint32_t size);
+
+// Release message on MQTT_EVENT_PUBLISHED
+// Returns true if a tracked message was released, freeing space for telemetry
+bool mqtt_outbox_acked(int msg_id);
+
+// Copy counters
+void mqtt_outbox_get_stats(struct mqtt_outbox_stats *stats);
+
+#endif
@@ -0,0 +1,72 @@
+#include "mqtt_reassembly.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+// Filled by the MQTT task, released by the command task
+static struct mqtt_reassembly reassembly;
+
+static void start_message(int msg_id, const char *topic, uint32_t topic_len, uint32_t total_len) {
+	// A new first chunk means the previous message will never complete
+	if(reassembly.is_active && !reassembly.is_discarding) {
+		ESP_LOGW(MQTT_REASSEMBLY_TAG, "Message %d incomplete, %d of %d bytes received", reassembly.msg_id, reassembly.received, reassembly.total_len);
+		reassembly.dropped++;
+	}
+
+	reassembly.is_active = true;
+	reassembly.msg_id = msg_id;
+	reassembly.total_len = total_len;
+	reassembly.received = 0;
+	reassembly.is_discarding = false;
+
+	// Buffer still holds the previous message
+	if(reassembly.is_busy) {
+		ESP_LOGE(MQTT_REASSEMBLY_TAG, "Buffer busy, dropping message %d on %.*s", msg_id, topic_len, topic);
+		reassembly.is_discarding = true;
+		reassembly.dropped++;
+		return;
+	}
+
+	if(total_len > MQTT_REASSEMBLY_BUFFER_SIZE || topic_len > MQTT_REASSEMBLY_MAX_TOPIC_LEN) {
+		ESP_LOGE(MQTT_REASSEMBLY_TAG, "Message %d on %.*s too large: %d bytes", msg_id, topic_len, topic, total_len);
+		reassembly.is_discarding = true;
+		reassembly.dropped++;
+		return;
+	}
+
+	memcpy(reassembly.topic, topic, topic_len);
+	reassembly.topic_len = topic_len;
+}
+
+bool mqtt_reassembly_add(int msg_id, const char *topic, uint32_t topic_len, const char *data, uint32_t data_len,
+						 uint32_t offset, uint32_t total_len, const char **topic_out, uint32_t *topic_len_out, const char **data_out) {
+	if(offset == 0) start_message(msg_id, topic, topic_len, total_len);
+
+	if(!reassembly.is_active || reassembly.is_discarding) return false;
+
+	// Chunks must continue the message in progress
+	if(msg_id != reassembly.msg_id || total_len != reassembly.total_len || offset != reassembly.received || data_len > total_len - offset) {
+		ESP_LOGE(MQTT_REASSEMBLY_TAG, "Unexpected chunk of message %d at offset %d, expected %d", msg_id, offset, reassembly.received);
+		reassembly.is_active = false;
+		reassembly.dropped++;
+		return false;
+	}
+
+	memcpy(reassembly.buffer + offset, data, data_len);
+	reassembly.received += data_len;
+	if(reassembly.received < reassembly.total_len) return false;
+
+	ESP_LOGI(MQTT_REASSEMBLY_TAG, "Assembled message %d: %d bytes", msg_id, reassembly.total_len);
+	reassembly.is_active = false;
+	reassembly.is_busy = true;
+	*topic_out = reassembly.topic;
+	*topic_len_out = reassembly.topic_len;
+	*data_out = reassembly.buffer;
+	return true;
+}
+
+bool mqtt_reassembly_owns(const char *data) { return data == reassembly.buffer; }
+
+void mqtt_reassembly_release() { reassembly.is_busy = false; }
+
+uint32_t mqtt_reassembly_get_dropped() { return reassembly.dropped; }
@@ -0,0 +1,44 @@
+#ifndef MQTT_REASSEMBLY_H
+#define MQTT_REASSEMBLY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+
+#define MQTT_REASSEMBLY_TAG "MQTT_REASSEMBLY"
+
+// Max size of an assembled message, see Kconfig
+#define MQTT_REASSEMBLY_BUFFER_SIZE CONFIG_MQTT_REASSEMBLY_BUFFER_SIZE
+
+// Max length of the topic of a fragmented message
+#define MQTT_REASSEMBLY_MAX_TOPIC_LEN 96
+
+// Message received in chunks, only one can be in progress since the client delivers chunks in order
+struct mqtt_reassembly {
+	char topic[MQTT_REASSEMBLY_MAX_TOPIC_LEN];
+	uint16_t topic_len;
+	int msg_id;
+	uint32_t total_len;
+	uint32_t received; // Bytes received so far
+	bool is_active;
+	bool is_discarding; // Message does not fit, remaining chunks are skipped
+	volatile bool is_busy; // Assembled message still being handled by the command task
+	uint32_t dropped; // Messages dropped because they were too large or incomplete
+	char buffer[MQTT_REASSEMBLY_BUFFER_SIZE];
+};
+
+// Add chunk of a fragmented message, topic is only set on the first chunk
+// Returns true once the message is complete, topic and data then point into the reassembly buffers
+bool mqtt_reassembly_add(int msg_id, const char *topic, uint32_t topic_len, const char *data, uint32_t data_len,
+						 uint32_t offset, uint32_t total_len, const char **topic_out, uint32_t *topic_len_out, const char **data_out);
+
+// Check if data points into the reassembly buffer
+bool mqtt_reassembly_owns(const char *data);
+
+// Free buffer once the assembled message has been handled
+void mqtt_reassembly_release();
+
+// Number of messages dropped since boot
+uint32_t mqtt_reassembly_get_dropped();
+
+#endif
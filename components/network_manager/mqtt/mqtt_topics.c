@@ -0,0 +1,88 @@
+#include "mqtt_topics.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Holds every resolved topic, lives as long as the client
+static char *topic_arena;
+
+// Wildcard subscription and length of "<device id>/cmd/" in front of each command heading
+static char *command_filter;
+static uint16_t command_prefix_len;
+
+bool topic_is_command(const struct topic_descriptor *descriptor) {
+#ifdef CONFIG_MQTT_COMMAND_TOPIC_WILDCARD
+	return descriptor->scope == TOPIC_SCOPE_DEVICE_ID && descriptor->handler != NULL;
+#else
+	return false;
+#endif
+}
+
+static const char* get_topic_suffix(const struct topic_descriptor *descriptor, const char *device_id, const char *device_type) {
+	return descriptor->scope == TOPIC_SCOPE_DEVICE_TYPE ? device_type : device_id;
+}
+
+esp_err_t resolve_topics(const struct topic_descriptor *descriptors, uint8_t count, const char *device_id, const char *device_type) {
+	size_t arena_size = 0;
+	size_t separate_size = 0;
+
+#ifdef CONFIG_MQTT_COMMAND_TOPIC_WILDCARD
+	command_prefix_len = strlen(device_id) + 1 + strlen(TOPIC_COMMAND_SEGMENT) + 1;
+	arena_size += command_prefix_len + 2;
+#endif
+
+	// Size arena for this device id
+	for(uint8_t i = 0; i < count; ++i) {
+		size_t topic_len = strlen(descriptors[i].heading) + 1 + strlen(get_topic_suffix(&descriptors[i], device_id, device_type)) + 1;
+		if(topic_is_command(&descriptors[i])) topic_len = command_prefix_len + strlen(descriptors[i].heading) + 1;
+		arena_size += topic_len;
+		separate_size += ((topic_len + 3) & ~3) + TOPIC_HEAP_BLOCK_OVERHEAD;
+	}
+
+	uint32_t free_heap = esp_get_free_heap_size();
+	topic_arena = malloc(arena_size);
+	if(topic_arena == NULL) {
+		ESP_LOGE(MQTT_TOPICS_TAG, "Failed to allocate %d byte topic arena", arena_size);
+		return ESP_ERR_NO_MEM;
+	}
+	uint32_t arena_heap = free_heap - esp_get_free_heap_size();
+
+	char *next = topic_arena;
+#ifdef CONFIG_MQTT_COMMAND_TOPIC_WILDCARD
+	command_filter = next;
+	next += sprintf(next, "%s/%s/+", device_id, TOPIC_COMMAND_SEGMENT) + 1;
+	ESP_LOGI(MQTT_TOPICS_TAG, "Command filter: %s", command_filter);
+#endif
+
+	for(uint8_t i = 0; i < count; ++i) {
+		const struct topic_descriptor *descriptor = &descriptors[i];
+		*descriptor->topic = next;
+		if(topic_is_command(descriptor)) {
+			next += sprintf(next, "%s/%s/%s", device_id, TOPIC_COMMAND_SEGMENT, descriptor->heading) + 1;
+		} else {
+			next += sprintf(next, "%s/%s", descriptor->heading, get_topic_suffix(descriptor, device_id, device_type)) + 1;
+		}
+		ESP_LOGI(MQTT_TOPICS_TAG, "Topic: %s", *descriptor->topic);
+
+		// Commands are dispatched by heading so the device id is never hashed
+		if(descriptor->handler != NULL) topic_table_register(topic_is_command(descriptor) ? descriptor->heading : *descriptor->topic, descriptor->handler);
+	}
+
+	// Memory report, compared against one malloc per topic
+	ESP_LOGI(MQTT_TOPICS_TAG, "%d topics: %d byte arena using %d bytes of heap in 1 block, separate allocations would use about %d bytes in %d blocks",
+			count, arena_size, arena_heap, separate_size, count);
+	return ESP_OK;
+}
+
+const char* get_command_topic_filter() { return command_filter; }
+
+topic_handler_t lookup_topic_handler(const char *topic, uint32_t topic_len) {
+	// Strip "<device id>/cmd/", the wildcard only matches this device
+	if(command_filter != NULL && topic_len > command_prefix_len && strncmp(topic, command_filter, command_prefix_len) == 0) {
+		return topic_table_lookup(topic + command_prefix_len, topic_len - command_prefix_len);
+	}
+	return topic_table_lookup(topic, topic_len);
+}
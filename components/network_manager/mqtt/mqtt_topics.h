@@ -0,0 +1,46 @@
+#ifndef MQTT_TOPICS_H
+#define MQTT_TOPICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <sdkconfig.h>
+
+#include "topic_table.h"
+
+#define MQTT_TOPICS_TAG "MQTT_TOPICS"
+
+// Topic suffix
+#define TOPIC_SCOPE_DEVICE_ID 0
+#define TOPIC_SCOPE_DEVICE_TYPE 1
+
+// Device commands are "<device id>/cmd/<heading>" with CONFIG_MQTT_COMMAND_TOPIC_WILDCARD
+#define TOPIC_COMMAND_SEGMENT "cmd"
+
+// Heap allocator block header, only used to estimate the cost of one allocation per topic
+#define TOPIC_HEAP_BLOCK_OVERHEAD 8
+
+// Static description of a topic, resolved to "<heading>/<device id or type>" at boot
+struct topic_descriptor {
+	const char *heading;
+	uint8_t scope;
+	uint8_t qos; // Subscribe QoS if handled, publish QoS otherwise. Commands that are safe to handle twice use QoS 1
+	bool retain;
+	topic_handler_t handler; // NULL if topic is only published
+	char **topic; // Set to the resolved topic
+	uint8_t priority; // Outbox class of published messages, MQTT_OUTBOX_CONTROL if left out
+};
+
+// Resolve all topics into one allocation and register handlers for dispatch
+esp_err_t resolve_topics(const struct topic_descriptor *descriptors, uint8_t count, const char *device_id, const char *device_type);
+
+// Check if topic is received through the command wildcard subscription
+bool topic_is_command(const struct topic_descriptor *descriptor);
+
+// Get "<device id>/cmd/+", NULL if commands use one subscription per topic
+const char* get_command_topic_filter();
+
+// Find handler for a received topic, commands are looked up by their heading
+topic_handler_t lookup_topic_handler(const char *topic, uint32_t topic_len);
+
+#endif
@@ -0,0 +1,321 @@
+#include "settings_parser.h"
+
+#include <esp_log.h>
+#include <float.h>
+#include <string.h>
+
+#include "json_token.h"
+#include "json_writer.h"
+#include "control_task.h"
+#include "control_settings_keys.h"
+#include "ec_control.h"
+#include "ph_control.h"
+#include "water_temp_control.h"
+
+// Only used from the command task
+static struct json_token tokens[SETTINGS_MAX_TOKENS];
+static int num_tokens;
+
+// Parsed into scratch copy so a failed message leaves caller settings untouched
+static struct device_settings parsed_settings;
+
+// Section keys, indexed by section bit
+static const char *section_keys[SETTINGS_NUM_SECTIONS] = { "ph", "ec", "water_temp", "irrigation", "grow_lights", "reservoir", "telemetry" };
+
+// Negative numbers are invalid rather than clamped to 0
+static bool get_uint(const char *json, int index, uint32_t *value) {
+	int32_t result;
+	if(!json_token_to_int(json, &tokens[index], &result) || result < 0) return false;
+	*value = result;
+	return true;
+}
+
+static bool get_float(const char *json, int index, float min, float max, float *value) {
+	return json_token_to_float(json, &tokens[index], value) && *value >= min && *value <= max;
+}
+
+static bool get_timestamp(const char *json, int index, struct tm *time) {
+	char timestamp[SETTINGS_TIMESTAMP_LEN];
+
+	// Shortest accepted form is YYYY-MM-DDTHH:mm:ssZ
+	if(!json_token_copy_string(json, &tokens[index], timestamp, sizeof(timestamp)) || strlen(timestamp) < 20) return false;
+	memset(time, 0, sizeof(struct tm));
+	parse_iso_timestamp(timestamp, time);
+	return true;
+}
+
+static bool parse_pumps(const char *json, int object, struct control_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		// Pump keys are pump_1 to pump_N
+		uint16_t key_len = json_token_length(&tokens[key]);
+		uint8_t pump_num = key_len == PUMP_NUM_INDEX + 1 ? json[tokens[key].start + PUMP_NUM_INDEX] - '1' : CONTROL_SETTINGS_MAX_PUMPS;
+		if(pump_num >= CONTROL_SETTINGS_MAX_PUMPS || strncmp(json + tokens[key].start, PUMP_NUM, PUMP_NUM_INDEX) != 0) {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Invalid pump key: %.*s", key_len, json + tokens[key].start);
+			continue;
+		}
+		if(!get_float(json, key + 1, 0, FLT_MAX, &settings->pump_proportions[pump_num])) return false;
+		settings->pumps |= 1 << pump_num;
+	}
+	return true;
+}
+
+static bool parse_control(const char *json, int object, float max_target, struct control_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		const struct json_token *token = &tokens[key];
+		const struct json_token *value = &tokens[key + 1];
+		bool is_valid = true;
+
+		if(json_token_equals(json, token, DOSING_TIME)) {
+			is_valid = get_float(json, key + 1, 0, FLT_MAX, &settings->dose_time);
+			settings->fields |= CONTROL_SETTINGS_DOSE_TIME;
+		} else if(json_token_equals(json, token, DOSING_INTERVAL)) {
+			is_valid = get_float(json, key + 1, 0, FLT_MAX, &settings->dose_interval) && settings->dose_interval > 0;
+			settings->fields |= CONTROL_SETTINGS_DOSE_INTERVAL;
+		} else if(json_token_equals(json, token, DAY_AND_NIGHT)) {
+			is_valid = json_token_to_bool(json, value, &settings->is_day_night_active);
+			settings->fields |= CONTROL_SETTINGS_DAY_NIGHT;
+		} else if(json_token_equals(json, token, DAY_TARGET_VALUE) || json_token_equals(json, token, TARGET_VALUE)) {
+			is_valid = get_float(json, key + 1, 0, max_target, &settings->target_value);
+			settings->fields |= CONTROL_SETTINGS_TARGET;
+		} else if(json_token_equals(json, token, NIGHT_TARGET_VALUE)) {
+			is_valid = get_float(json, key + 1, 0, max_target, &settings->night_target_value);
+			settings->fields |= CONTROL_SETTINGS_NIGHT_TARGET;
+		} else if(json_token_equals(json, token, UP_CONTROL)) {
+			is_valid = json_token_to_bool(json, value, &settings->is_up_control);
+			settings->fields |= CONTROL_SETTINGS_UP_CONTROL;
+		} else if(json_token_equals(json, token, DOWN_CONTROL)) {
+			is_valid = json_token_to_bool(json, value, &settings->is_down_control);
+			settings->fields |= CONTROL_SETTINGS_DOWN_CONTROL;
+		} else if(json_token_equals(json, token, PUMPS)) {
+			is_valid = parse_pumps(json, key + 1, settings);
+		}
+
+		if(!is_valid) {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Invalid value for %.*s", json_token_length(token), json + token->start);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool parse_control_settings(const char *json, int object, float max_target, struct control_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(json_token_equals(json, &tokens[key], MONITORING_ONLY)) {
+			if(!json_token_to_bool(json, &tokens[key + 1], &settings->monitoring_only)) return false;
+			settings->fields |= CONTROL_SETTINGS_MONITORING_ONLY;
+		} else if(json_token_equals(json, &tokens[key], CONTROL)) {
+			if(!parse_control(json, key + 1, max_target, settings)) return false;
+		} else if(json_token_equals(json, &tokens[key], PUBLISH_DEADBAND)) {
+			if(!json_token_to_float(json, &tokens[key + 1], &settings->publish_deadband) || settings->publish_deadband < 0) return false;
+			settings->fields |= CONTROL_SETTINGS_PUBLISH_DEADBAND;
+		} else if(json_token_equals(json, &tokens[key], PUBLISH_MAX_SILENCE)) {
+			if(!get_uint(json, key + 1, &settings->publish_max_silence)) return false;
+			settings->fields |= CONTROL_SETTINGS_PUBLISH_MAX_SILENCE;
+		}
+	}
+	return true;
+}
+
+static bool parse_irrigation_settings(const char *json, int object, struct irrigation_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(json_token_equals(json, &tokens[key], IRRIGATION_ON_KEY)) {
+			if(!get_uint(json, key + 1, &settings->on_interval) || settings->on_interval == 0) return false;
+			settings->fields |= IRRIGATION_SETTINGS_ON;
+		} else if(json_token_equals(json, &tokens[key], IRRIGATION_OFF_KEY)) {
+			if(!get_uint(json, key + 1, &settings->off_interval) || settings->off_interval == 0) return false;
+			settings->fields |= IRRIGATION_SETTINGS_OFF;
+		} else {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Error: Invalid Key");
+		}
+	}
+	return true;
+}
+
+static bool parse_grow_light_settings(const char *json, int object, struct grow_light_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(json_token_equals(json, &tokens[key], LIGHTS_ON_KEY)) {
+			if(!get_timestamp(json, key + 1, &settings->lights_on)) return false;
+			settings->fields |= GROW_LIGHT_SETTINGS_ON;
+		} else if(json_token_equals(json, &tokens[key], LIGHTS_OFF_KEY)) {
+			if(!get_timestamp(json, key + 1, &settings->lights_off)) return false;
+			settings->fields |= GROW_LIGHT_SETTINGS_OFF;
+		} else {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Error: Invalid Key: %.*s", json_token_length(&tokens[key]), json + tokens[key].start);
+		}
+	}
+	return true;
+}
+
+static bool parse_reservoir_settings(const char *json, int object, struct reservoir_settings *settings) {
+	uint32_t interval;
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(json_token_equals(json, &tokens[key], RESERVOIR_REPLACEMENT_INTERVAL_KEY)) {
+			if(!get_uint(json, key + 1, &interval) || interval == 0 || interval > UINT16_MAX) return false;
+			settings->replacement_interval = interval;
+			settings->fields |= RESERVOIR_SETTINGS_INTERVAL;
+		} else if(json_token_equals(json, &tokens[key], RESERVOIR_ENABLED_KEY)) {
+			if(!json_token_to_bool(json, &tokens[key + 1], &settings->is_control_active)) return false;
+			settings->fields |= RESERVOIR_SETTINGS_ENABLED;
+		} else if(json_token_equals(json, &tokens[key], RESERVOIR_NEXT_REPLACEMENT_DATE_KEY)) {
+			if(!get_timestamp(json, key + 1, &settings->next_replacement_date)) return false;
+			settings->fields |= RESERVOIR_SETTINGS_DATE;
+		} else {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Error: Invalid Key");
+		}
+	}
+	return true;
+}
+
+static bool parse_telemetry_settings(const char *json, int object, struct telemetry_settings *settings) {
+	if(tokens[object].type != JSON_OBJECT) return false;
+
+	int key = object + 1;
+	for(uint16_t i = 0; i < tokens[object].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(json_token_equals(json, &tokens[key], TELEMETRY_BATCH_SIZE_KEY)) {
+			if(!get_uint(json, key + 1, &settings->batch_size) || settings->batch_size == 0) return false;
+			settings->fields |= TELEMETRY_SETTINGS_BATCH_SIZE;
+		} else if(json_token_equals(json, &tokens[key], TELEMETRY_BATCH_INTERVAL_KEY)) {
+			if(!get_uint(json, key + 1, &settings->batch_interval) || settings->batch_interval == 0) return false;
+			settings->fields |= TELEMETRY_SETTINGS_BATCH_INTERVAL;
+		} else {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Error: Invalid Key");
+		}
+	}
+	return true;
+}
+
+esp_err_t parse_device_settings(const char *json, size_t len, struct device_settings *settings) {
+	num_tokens = json_tokenize(json, len, tokens, SETTINGS_MAX_TOKENS);
+	if(num_tokens < 1 || tokens[0].type != JSON_OBJECT) {
+		ESP_LOGE(SETTINGS_PARSER_TAG, "Invalid settings message: %d", num_tokens);
+		return ESP_FAIL;
+	}
+
+	memset(&parsed_settings, 0, sizeof(parsed_settings));
+
+	// Every section is validated so the ack can report all problems at once
+	int key = 1;
+	for(uint16_t i = 0; i < tokens[0].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		const struct json_token *token = &tokens[key];
+		uint16_t flag = 0;
+		bool is_valid = true;
+
+		if(json_token_equals(json, token, "ph")) {
+			is_valid = parse_control_settings(json, key + 1, SETTINGS_MAX_PH, &parsed_settings.ph);
+			flag = SETTINGS_SECTION_PH;
+		} else if(json_token_equals(json, token, "ec")) {
+			is_valid = parse_control_settings(json, key + 1, FLT_MAX, &parsed_settings.ec);
+			flag = SETTINGS_SECTION_EC;
+		} else if(json_token_equals(json, token, "water_temp")) {
+			is_valid = parse_control_settings(json, key + 1, FLT_MAX, &parsed_settings.water_temp);
+			flag = SETTINGS_SECTION_WATER_TEMP;
+		} else if(json_token_equals(json, token, "irrigation")) {
+			is_valid = parse_irrigation_settings(json, key + 1, &parsed_settings.irrigation);
+			flag = SETTINGS_SECTION_IRRIGATION;
+		} else if(json_token_equals(json, token, "grow_lights")) {
+			is_valid = parse_grow_light_settings(json, key + 1, &parsed_settings.grow_lights);
+			flag = SETTINGS_SECTION_GROW_LIGHTS;
+		} else if(json_token_equals(json, token, "reservoir")) {
+			is_valid = parse_reservoir_settings(json, key + 1, &parsed_settings.reservoir);
+			flag = SETTINGS_SECTION_RESERVOIR;
+		} else if(json_token_equals(json, token, "telemetry")) {
+			is_valid = parse_telemetry_settings(json, key + 1, &parsed_settings.telemetry);
+			flag = SETTINGS_SECTION_TELEMETRY;
+		} else if(json_token_equals(json, token, SETTINGS_VERSION_KEY)) {
+			is_valid = get_uint(json, key + 1, &parsed_settings.version);
+			flag = SETTINGS_HAS_VERSION;
+		} else if(json_token_equals(json, token, SETTINGS_REQUEST_ID_KEY)) {
+			is_valid = get_uint(json, key + 1, &parsed_settings.request_id);
+			flag = SETTINGS_HAS_REQUEST_ID;
+		} else {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Data %.*s not recognized", json_token_length(token), json + token->start);
+		}
+
+		parsed_settings.sections |= flag;
+		if(!is_valid) {
+			ESP_LOGE(SETTINGS_PARSER_TAG, "Invalid %.*s settings", json_token_length(token), json + token->start);
+			parsed_settings.invalid_sections |= flag;
+		}
+	}
+
+	*settings = parsed_settings;
+	return parsed_settings.invalid_sections == 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void apply_device_settings(const struct device_settings *settings) {
+	// Control loop waits until every section is in place
+	if(control_settings_lock != NULL) xSemaphoreTake(control_settings_lock, portMAX_DELAY);
+
+	if(settings->sections & SETTINGS_SECTION_PH) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "pH data received");
+		ph_update_settings(&settings->ph);
+	}
+	if(settings->sections & SETTINGS_SECTION_EC) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "EC data received");
+		ec_update_settings(&settings->ec);
+	}
+	if(settings->sections & SETTINGS_SECTION_WATER_TEMP) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "Water Temperature data received");
+		water_temp_update_settings(&settings->water_temp);
+	}
+	if(settings->sections & SETTINGS_SECTION_IRRIGATION) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "Irrigation data received");
+		update_irrigation_timings(&settings->irrigation);
+	}
+	if(settings->sections & SETTINGS_SECTION_GROW_LIGHTS) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "Grow Lights data received");
+		update_grow_light_timings(&settings->grow_lights);
+	}
+	if(settings->sections & SETTINGS_SECTION_RESERVOIR) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "Reservoir data received");
+		update_reservoir_settings(&settings->reservoir);
+	}
+	if(settings->sections & SETTINGS_SECTION_TELEMETRY) {
+		ESP_LOGI(SETTINGS_PARSER_TAG, "Telemetry data received");
+		telemetry_update_settings(&settings->telemetry);
+	}
+
+	if(control_settings_lock != NULL) xSemaphoreGive(control_settings_lock);
+}
+
+// Ack is {"req_id": n, "applied": bool, "sections": {"<section>": "ok" | "invalid" | "skipped"}}
+size_t create_settings_ack(char *buffer, size_t size, const struct device_settings *settings, bool is_applied) {
+	struct json_writer writer;
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	if(settings->sections & SETTINGS_HAS_REQUEST_ID) json_writer_add_uint(&writer, SETTINGS_REQUEST_ID_KEY, settings->request_id);
+	json_writer_add_bool(&writer, "applied", is_applied);
+
+	json_writer_begin_object(&writer, "sections");
+	for(uint8_t section = 0; section < SETTINGS_NUM_SECTIONS; ++section) {
+		if(!(settings->sections & (1 << section))) continue;
+		const char *result = SETTINGS_RESULT_OK;
+		if(settings->invalid_sections & (1 << section)) result = SETTINGS_RESULT_INVALID;
+		else if(!is_applied) result = SETTINGS_RESULT_SKIPPED;
+		json_writer_add_string(&writer, section_keys[section], result);
+	}
+	json_writer_end_object(&writer);
+
+	json_writer_end_object(&writer);
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
@@ -0,0 +1,76 @@
+#ifndef SETTINGS_PARSER_H
+#define SETTINGS_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#include "sensor_control.h"
+#include "reservoir_control.h"
+#include "rtc.h"
+#include "telemetry_batch.h"
+
+#define SETTINGS_PARSER_TAG "SETTINGS_PARSER"
+
+// Max tokens in a settings message, enough for every section in one message
+#define SETTINGS_MAX_TOKENS 192
+
+// Max length of an ISO timestamp value
+#define SETTINGS_TIMESTAMP_LEN 32
+
+// Sections present in a settings message
+#define SETTINGS_SECTION_PH (1 << 0)
+#define SETTINGS_SECTION_EC (1 << 1)
+#define SETTINGS_SECTION_WATER_TEMP (1 << 2)
+#define SETTINGS_SECTION_IRRIGATION (1 << 3)
+#define SETTINGS_SECTION_GROW_LIGHTS (1 << 4)
+#define SETTINGS_SECTION_RESERVOIR (1 << 5)
+#define SETTINGS_SECTION_TELEMETRY (1 << 6)
+#define SETTINGS_HAS_VERSION (1 << 7) // Shadow documents carry a version
+#define SETTINGS_HAS_REQUEST_ID (1 << 8) // Echoed in the ack
+
+// Number of settings sections, section i is flagged by bit i
+#define SETTINGS_NUM_SECTIONS 7
+
+// Version key of shadow documents
+#define SETTINGS_VERSION_KEY "version"
+
+// Request id key, echoed in the ack
+#define SETTINGS_REQUEST_ID_KEY "req_id"
+
+// Max pH target
+#define SETTINGS_MAX_PH 14
+
+// Ack section results
+#define SETTINGS_RESULT_OK "ok"
+#define SETTINGS_RESULT_INVALID "invalid"
+#define SETTINGS_RESULT_SKIPPED "skipped" // Valid but not applied since another section was invalid
+
+// Settings parsed from one message, only sections flagged in sections are applied
+struct device_settings {
+	uint16_t sections;
+	uint16_t invalid_sections; // Sections that failed validation, none are applied if any is set
+	struct control_settings ph;
+	struct control_settings ec;
+	struct control_settings water_temp;
+	struct irrigation_settings irrigation;
+	struct grow_light_settings grow_lights;
+	struct reservoir_settings reservoir;
+	struct telemetry_settings telemetry;
+	uint32_t version;
+	uint32_t request_id;
+};
+
+// Parse and validate every section of len bytes of settings json without copying or allocating
+// Returns ESP_ERR_INVALID_ARG if any section is invalid, settings then flags the invalid sections for the ack
+// Returns ESP_FAIL without touching settings if the message is not a JSON object
+esp_err_t parse_device_settings(const char *json, size_t len, struct device_settings *settings);
+
+// Apply every parsed section in one swap, the control loop never runs on a partly applied message
+void apply_device_settings(const struct device_settings *settings);
+
+// Serialize ack with a result per section, returns payload length or 0 if it does not fit
+size_t create_settings_ack(char *buffer, size_t size, const struct device_settings *settings, bool is_applied);
+
+#endif
@@ -0,0 +1,222 @@
+#include "telemetry_batch.h"
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <string.h>
+#include <freertos/task.h>
+
+#include "mqtt_manager.h"
+#include "json_writer.h"
+#include "telemetry_spool.h"
+#include "nvs_manager.h"
+#include "nvs_namespace_keys.h"
+#include "rtc.h"
+#include "sensor.h"
+#include "ec_reading.h"
+#include "ph_reading.h"
+#include "water_temp_reading.h"
+#include "ec_control.h"
+#include "ph_control.h"
+#include "water_temp_control.h"
+
+static struct telemetry_batch telemetry_batch;
+
+struct sensor* telemetry_get_sensor(uint8_t index) {
+	switch(index) {
+		case 0: return get_water_temp_sensor();
+		case 1: return get_ec_sensor();
+		default: return get_ph_sensor();
+	}
+}
+
+struct sensor_control* telemetry_get_control(uint8_t index) {
+	switch(index) {
+		case 0: return get_water_temp_control();
+		case 1: return get_ec_control();
+		default: return get_ph_control();
+	}
+}
+
+static uint8_t clamp_batch_size(uint32_t batch_size) {
+	if(batch_size < 1) return 1;
+	if(batch_size > TELEMETRY_BATCH_MAX_SAMPLES) return TELEMETRY_BATCH_MAX_SAMPLES;
+	return batch_size;
+}
+
+static struct telemetry_sample* get_sample(uint8_t offset) {
+	return &telemetry_batch.samples[(telemetry_batch.head + offset) % TELEMETRY_BATCH_MAX_SAMPLES];
+}
+
+// Must hold lock
+static bool is_flush_due() {
+	if(telemetry_batch.count == 0) return false;
+	if(telemetry_batch.count >= telemetry_batch.batch_size) return true;
+
+	time_t span = get_sample(telemetry_batch.count - 1)->time - get_sample(0)->time;
+	return span >= (time_t)telemetry_batch.batch_interval;
+}
+
+void init_telemetry_batch() {
+	memset(&telemetry_batch, 0, sizeof(telemetry_batch));
+	telemetry_batch.batch_size = 1;
+	telemetry_batch.batch_interval = TELEMETRY_DEFAULT_BATCH_INTERVAL;
+	telemetry_batch.lock = xSemaphoreCreateMutex();
+
+	telemetry_get_nvs_settings();
+}
+
+void telemetry_read_sample(struct telemetry_sample *sample) {
+	get_unix_time(&dev, &sample->time);
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		sample->values[i] = sensor_get_value(telemetry_get_sensor(i));
+	}
+}
+
+bool telemetry_batch_enabled() { return telemetry_batch.batch_size > 1; }
+
+void telemetry_batch_add_sample() {
+	if(!telemetry_batch_enabled()) return;
+
+	struct telemetry_sample sample;
+	telemetry_read_sample(&sample);
+
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+
+	// Overwrite oldest sample if publisher has fallen behind
+	if(telemetry_batch.count == TELEMETRY_BATCH_MAX_SAMPLES) {
+		telemetry_batch.head = (telemetry_batch.head + 1) % TELEMETRY_BATCH_MAX_SAMPLES;
+		telemetry_batch.count--;
+		telemetry_batch.dropped++;
+	}
+	*get_sample(telemetry_batch.count) = sample;
+	telemetry_batch.count++;
+
+	bool flush_due = is_flush_due();
+	xSemaphoreGive(telemetry_batch.lock);
+
+	// Wake publish task once a batch is ready
+	if(flush_due && publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+bool telemetry_batch_flush_due() {
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	bool flush_due = is_flush_due();
+	xSemaphoreGive(telemetry_batch.lock);
+	return flush_due;
+}
+
+size_t telemetry_batch_serialize(char *buffer, size_t size, uint8_t *num_samples) {
+	struct json_writer writer;
+	struct tm base_time;
+
+	*num_samples = 0;
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	if(telemetry_batch.count == 0) {
+		xSemaphoreGive(telemetry_batch.lock);
+		return 0;
+	}
+
+	// Samples are sent as offsets in seconds from the oldest sample
+	time_t base = get_sample(0)->time;
+	localtime_r(&base, &base_time);
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_time(&writer, "time", &base_time);
+
+	json_writer_begin_array(&writer, "sensors");
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		json_writer_add_string(&writer, NULL, telemetry_get_sensor(i)->name);
+	}
+	json_writer_end_array(&writer);
+
+	// Each sample is [offset, water temp, ec, ph]
+	json_writer_begin_array(&writer, "samples");
+	for(uint8_t i = 0; i < telemetry_batch.count; ++i) {
+		struct telemetry_sample *sample = get_sample(i);
+		json_writer_begin_array(&writer, NULL);
+		json_writer_add_uint(&writer, NULL, (uint32_t)(sample->time - base));
+		for(uint8_t j = 0; j < TELEMETRY_NUM_SENSORS; ++j) {
+			json_writer_add_float(&writer, NULL, sample->values[j], 2);
+		}
+		json_writer_end_array(&writer);
+	}
+	json_writer_end_array(&writer);
+
+	json_writer_add_uint(&writer, "dropped", telemetry_batch.dropped);
+	json_writer_end_object(&writer);
+
+	*num_samples = telemetry_batch.count;
+	xSemaphoreGive(telemetry_batch.lock);
+
+	if(json_writer_finish(&writer) == NULL) {
+		*num_samples = 0;
+		return 0;
+	}
+	return json_writer_length(&writer);
+}
+
+void telemetry_batch_consume(uint8_t num_samples) {
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	if(num_samples > telemetry_batch.count) num_samples = telemetry_batch.count;
+	telemetry_batch.head = (telemetry_batch.head + num_samples) % TELEMETRY_BATCH_MAX_SAMPLES;
+	telemetry_batch.count -= num_samples;
+	telemetry_batch.dropped = 0;
+	xSemaphoreGive(telemetry_batch.lock);
+}
+
+void telemetry_batch_spool() {
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	for(uint8_t i = 0; i < telemetry_batch.count; ++i) {
+		telemetry_spool_append(get_sample(i));
+	}
+	ESP_LOGI(TELEMETRY_TAG, "Moved %d samples to spool", telemetry_batch.count);
+	telemetry_batch.head = 0;
+	telemetry_batch.count = 0;
+	telemetry_batch.dropped = 0;
+	xSemaphoreGive(telemetry_batch.lock);
+}
+
+void telemetry_get_settings(struct telemetry_settings *settings) {
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	settings->fields = TELEMETRY_SETTINGS_BATCH_SIZE | TELEMETRY_SETTINGS_BATCH_INTERVAL;
+	settings->batch_size = telemetry_batch.batch_size;
+	settings->batch_interval = telemetry_batch.batch_interval;
+	xSemaphoreGive(telemetry_batch.lock);
+}
+
+void telemetry_update_settings(const struct telemetry_settings *settings) {
+	nvs_handle_t *handle = nvs_get_handle(TELEMETRY_NVS_NAMESPACE);
+
+	xSemaphoreTake(telemetry_batch.lock, portMAX_DELAY);
+	if(settings->fields & TELEMETRY_SETTINGS_BATCH_SIZE) {
+		telemetry_batch.batch_size = clamp_batch_size(settings->batch_size);
+		nvs_add_uint8(handle, TELEMETRY_BATCH_SIZE_KEY, telemetry_batch.batch_size);
+		ESP_LOGI(TELEMETRY_TAG, "Updated batch size to: %d", telemetry_batch.batch_size);
+	}
+	if(settings->fields & TELEMETRY_SETTINGS_BATCH_INTERVAL) {
+		telemetry_batch.batch_interval = settings->batch_interval;
+		nvs_add_uint32(handle, TELEMETRY_BATCH_INTERVAL_KEY, telemetry_batch.batch_interval);
+		ESP_LOGI(TELEMETRY_TAG, "Updated batch interval to: %d", telemetry_batch.batch_interval);
+	}
+
+	// Samples left over when batching is turned off go out as one last batch
+	bool flush_due = is_flush_due();
+	if(!telemetry_batch_enabled() && flush_due) {
+		ESP_LOGI(TELEMETRY_TAG, "Batching disabled, flushing %d buffered samples", telemetry_batch.count);
+	}
+	xSemaphoreGive(telemetry_batch.lock);
+
+	nvs_commit_data(handle);
+
+	if(flush_due && publish_task_handle != NULL) xTaskNotifyGive(publish_task_handle);
+}
+
+void telemetry_get_nvs_settings() {
+	uint8_t batch_size;
+	if(nvs_get_uint8(TELEMETRY_NVS_NAMESPACE, TELEMETRY_BATCH_SIZE_KEY, &batch_size)) {
+		telemetry_batch.batch_size = clamp_batch_size(batch_size);
+	}
+	nvs_get_uint32(TELEMETRY_NVS_NAMESPACE, TELEMETRY_BATCH_INTERVAL_KEY, &telemetry_batch.batch_interval);
+	ESP_LOGI(TELEMETRY_TAG, "Batch size: %d, batch interval: %d", telemetry_batch.batch_size, telemetry_batch.batch_interval);
+}
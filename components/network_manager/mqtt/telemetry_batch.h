@@ -0,0 +1,97 @@
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+struct sensor;
+struct sensor_control;
+
+#define TELEMETRY_TAG "TELEMETRY"
+
+// Settings keys
+#define TELEMETRY_BATCH_SIZE_KEY "batch_size"
+#define TELEMETRY_BATCH_INTERVAL_KEY "batch_interv"
+
+// Ring buffer capacity, batch size is clamped to it
+#define TELEMETRY_BATCH_MAX_SAMPLES 30
+
+// Default max age of the oldest buffered sample in seconds before a flush
+#define TELEMETRY_DEFAULT_BATCH_INTERVAL 300
+
+// Sensors stored per sample (water temp, ec, ph), index doubles as the sensor id in CBOR payloads
+#define TELEMETRY_NUM_SENSORS 3
+
+// Size of the batched sensor data payload buffer
+#define TELEMETRY_BATCH_PAYLOAD_SIZE 1280
+
+// Fields present in a telemetry settings update
+#define TELEMETRY_SETTINGS_BATCH_SIZE (1 << 0)
+#define TELEMETRY_SETTINGS_BATCH_INTERVAL (1 << 1)
+
+// Parsed telemetry settings
+struct telemetry_settings {
+	uint8_t fields;
+	uint32_t batch_size;
+	uint32_t batch_interval;
+};
+
+struct telemetry_sample {
+	time_t time;
+	float values[TELEMETRY_NUM_SENSORS];
+};
+
+struct telemetry_batch {
+	struct telemetry_sample samples[TELEMETRY_BATCH_MAX_SAMPLES];
+	uint8_t head; // Index of oldest sample
+	uint8_t count;
+	uint8_t batch_size; // Flush after this many samples, 1 publishes every sample on its own
+	uint32_t batch_interval; // Flush once the buffered samples span this many seconds
+	uint32_t dropped; // Samples overwritten before they were sent
+	SemaphoreHandle_t lock;
+};
+
+// Initialize ring buffer and load settings from NVS
+void init_telemetry_batch();
+
+// Get sensor stored at index of each sample
+struct sensor* telemetry_get_sensor(uint8_t index);
+
+// Get control of the sensor stored at index
+struct sensor_control* telemetry_get_control(uint8_t index);
+
+// Read current sensor values and time into sample
+void telemetry_read_sample(struct telemetry_sample *sample);
+
+// Check if samples are batched instead of published one by one
+bool telemetry_batch_enabled();
+
+// Store current sensor values as a sample, called once per completed sensor round
+void telemetry_batch_add_sample();
+
+// Check if buffered samples reached batch size or interval
+bool telemetry_batch_flush_due();
+
+// Serialize buffered samples into buffer, returns payload length or 0 if empty or it does not fit
+size_t telemetry_batch_serialize(char *buffer, size_t size, uint8_t *num_samples);
+
+// Remove the oldest samples once they have been published
+void telemetry_batch_consume(uint8_t num_samples);
+
+// Move buffered samples to the flash spool while MQTT is down
+void telemetry_batch_spool();
+
+// Update settings
+void telemetry_update_settings(const struct telemetry_settings *settings);
+
+// Get current settings with every field flagged
+void telemetry_get_settings(struct telemetry_settings *settings);
+
+// Get and store settings from NVS
+void telemetry_get_nvs_settings();
+
+#endif
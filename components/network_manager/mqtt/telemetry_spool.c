@@ -0,0 +1,242 @@
+#include "telemetry_spool.h"
+
+#include <esp_log.h>
+#include <string.h>
+#include <esp32/rom/crc.h>
+
+#include "json_writer.h"
+#include "nvs_manager.h"
+#include "nvs_namespace_keys.h"
+#include "sensor.h"
+
+#define RECORDS_PER_SECTOR (TELEMETRY_SPOOL_SECTOR_SIZE / sizeof(struct telemetry_spool_record))
+
+static struct telemetry_spool telemetry_spool;
+
+static uint32_t record_crc(const struct telemetry_spool_record *record) {
+	struct telemetry_spool_record unsent = *record;
+	unsent.sent = TELEMETRY_SPOOL_RECORD_UNSENT;
+	return crc32_le(0, (const uint8_t*)&unsent, offsetof(struct telemetry_spool_record, crc));
+}
+
+static size_t slot_offset(uint32_t slot) {
+	return (slot % telemetry_spool.num_records) * sizeof(struct telemetry_spool_record);
+}
+
+// Read slot, returns true if it holds a valid record belonging to that slot
+static bool read_slot(uint32_t slot, struct telemetry_spool_record *record) {
+	if(esp_partition_read(telemetry_spool.partition, slot_offset(slot), record, sizeof(*record)) != ESP_OK) return false;
+	return record->magic == TELEMETRY_SPOOL_RECORD_MAGIC
+			&& record->seq % telemetry_spool.num_records == slot % telemetry_spool.num_records
+			&& record->crc == record_crc(record);
+}
+
+// Read record with sequence number seq
+static bool read_record(uint32_t seq, struct telemetry_spool_record *record) {
+	return read_slot(seq, record) && record->seq == seq;
+}
+
+static bool is_slot_erased(uint32_t slot) {
+	uint8_t data[sizeof(struct telemetry_spool_record)];
+	if(esp_partition_read(telemetry_spool.partition, slot_offset(slot), data, sizeof(data)) != ESP_OK) return false;
+	for(uint8_t i = 0; i < sizeof(data); ++i) {
+		if(data[i] != 0xFF) return false;
+	}
+	return true;
+}
+
+// Flash bits can be cleared without an erase, so marking a record costs a single small write
+static void mark_sent(uint32_t seq) {
+	uint16_t sent = 0;
+	esp_err_t err = esp_partition_write(telemetry_spool.partition, slot_offset(seq) + offsetof(struct telemetry_spool_record, sent), &sent, sizeof(sent));
+	if(err != ESP_OK) {
+		ESP_LOGW(TELEMETRY_SPOOL_TAG, "Failed marking seq %d as sent, error: %d", seq, err);
+	}
+}
+
+static void save_send_seq() {
+	nvs_handle_t *handle = nvs_get_handle(TELEMETRY_NVS_NAMESPACE);
+	nvs_add_uint32(handle, TELEMETRY_SPOOL_SEND_SEQ_KEY, telemetry_spool.send_seq);
+	nvs_commit_data(handle);
+	telemetry_spool.saved_seq = telemetry_spool.send_seq;
+}
+
+// Skip records sent after send_seq was last stored, they all lie in the sector holding it
+static void skip_marked_sent() {
+	struct telemetry_spool_record record;
+	uint32_t sector_end = telemetry_spool.send_seq - telemetry_spool.send_seq % RECORDS_PER_SECTOR + RECORDS_PER_SECTOR;
+	for(uint32_t seq = telemetry_spool.send_seq; seq < sector_end && seq < telemetry_spool.next_seq; ++seq) {
+		if(read_record(seq, &record) && record.sent != TELEMETRY_SPOOL_RECORD_UNSENT) {
+			telemetry_spool.send_seq = seq + 1;
+		}
+	}
+}
+
+// Oldest sequence number still in flash, writing into a sector erases its previous contents
+static uint32_t get_oldest_seq() {
+	uint32_t sector_start = telemetry_spool.next_seq - telemetry_spool.next_seq % RECORDS_PER_SECTOR;
+	uint32_t kept = telemetry_spool.num_records - RECORDS_PER_SECTOR;
+	return sector_start > kept ? sector_start - kept : 0;
+}
+
+// Skip samples that have been overwritten
+static void drop_overwritten() {
+	uint32_t oldest_seq = get_oldest_seq();
+	if(telemetry_spool.send_seq < oldest_seq) {
+		ESP_LOGW(TELEMETRY_SPOOL_TAG, "%d spooled samples overwritten before being sent", oldest_seq - telemetry_spool.send_seq);
+		telemetry_spool.lost += oldest_seq - telemetry_spool.send_seq;
+		telemetry_spool.send_seq = oldest_seq;
+	}
+}
+
+void init_telemetry_spool() {
+	struct telemetry_spool_record record;
+	memset(&telemetry_spool, 0, sizeof(telemetry_spool));
+
+	telemetry_spool.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, TELEMETRY_SPOOL_PARTITION_SUBTYPE, TELEMETRY_SPOOL_PARTITION_LABEL);
+	if(telemetry_spool.partition == NULL) {
+		ESP_LOGE(TELEMETRY_SPOOL_TAG, "Spool partition not found, samples taken while offline will be dropped");
+		return;
+	}
+	telemetry_spool.num_records = telemetry_spool.partition->size / TELEMETRY_SPOOL_SECTOR_SIZE * RECORDS_PER_SECTOR;
+
+	// Sectors are filled in order, so the first record of each sector is enough to find the newest sector
+	bool is_found = false;
+	uint32_t newest_seq = 0;
+	uint32_t newest_slot = 0;
+	for(uint32_t slot = 0; slot < telemetry_spool.num_records; slot += RECORDS_PER_SECTOR) {
+		if(read_slot(slot, &record) && (!is_found || record.seq > newest_seq)) {
+			is_found = true;
+			newest_seq = record.seq;
+			newest_slot = slot;
+		}
+	}
+
+	// Walk newest sector up to its last record
+	if(is_found) {
+		for(uint32_t slot = newest_slot + 1; slot < newest_slot + RECORDS_PER_SECTOR; ++slot) {
+			if(!read_slot(slot, &record) || record.seq != newest_seq + 1) break;
+			newest_seq++;
+		}
+		telemetry_spool.next_seq = newest_seq + 1;
+	}
+
+	// Sequence numbers keep increasing even if the partition was erased
+	uint32_t send_seq;
+	if(nvs_get_uint32(TELEMETRY_NVS_NAMESPACE, TELEMETRY_SPOOL_SEND_SEQ_KEY, &send_seq)) {
+		telemetry_spool.send_seq = send_seq;
+		if(telemetry_spool.next_seq < send_seq) telemetry_spool.next_seq = send_seq;
+		skip_marked_sent();
+	} else {
+		telemetry_spool.send_seq = telemetry_spool.next_seq;
+	}
+	telemetry_spool.saved_seq = telemetry_spool.send_seq;
+
+	// Move to next sector if the write slot was left half written by a reset
+	if(telemetry_spool.next_seq % RECORDS_PER_SECTOR != 0 && !is_slot_erased(telemetry_spool.next_seq)) {
+		telemetry_spool.next_seq += RECORDS_PER_SECTOR - telemetry_spool.next_seq % RECORDS_PER_SECTOR;
+	}
+	drop_overwritten();
+
+	ESP_LOGI(TELEMETRY_SPOOL_TAG, "Spool capacity: %d samples, next seq: %d, pending: %d", telemetry_spool.num_records, telemetry_spool.next_seq, telemetry_spool.next_seq - telemetry_spool.send_seq);
+}
+
+bool telemetry_spool_pending() { return telemetry_spool.partition != NULL && telemetry_spool.send_seq < telemetry_spool.next_seq; }
+
+esp_err_t telemetry_spool_append(const struct telemetry_sample *sample) {
+	if(telemetry_spool.partition == NULL) return ESP_ERR_NOT_FOUND;
+
+	struct telemetry_spool_record record;
+	memset(&record, 0, sizeof(record));
+	record.magic = TELEMETRY_SPOOL_RECORD_MAGIC;
+	record.sent = TELEMETRY_SPOOL_RECORD_UNSENT;
+	record.seq = telemetry_spool.next_seq;
+	record.time = (uint32_t)sample->time;
+	memcpy(record.values, sample->values, sizeof(record.values));
+	record.crc = record_crc(&record);
+
+	size_t offset = slot_offset(record.seq);
+	esp_err_t err = ESP_OK;
+
+	// Erase sector when entering it, dropping the oldest samples once the spool is full
+	if(record.seq % RECORDS_PER_SECTOR == 0) {
+		err = esp_partition_erase_range(telemetry_spool.partition, offset, TELEMETRY_SPOOL_SECTOR_SIZE);
+	}
+	if(err == ESP_OK) {
+		err = esp_partition_write(telemetry_spool.partition, offset, &record, sizeof(record));
+	}
+	if(err != ESP_OK) {
+		ESP_LOGE(TELEMETRY_SPOOL_TAG, "Failed writing seq %d to spool, error: %d", record.seq, err);
+	}
+
+	// Slot is used up even on failure since it may be partially written
+	telemetry_spool.next_seq++;
+	drop_overwritten();
+
+	return err;
+}
+
+size_t telemetry_spool_serialize(char *buffer, size_t size, uint32_t *end_seq) {
+	struct telemetry_spool_record record;
+	struct json_writer writer;
+	struct tm base_time;
+
+	drop_overwritten();
+
+	// Skip records lost to a reset or flash error
+	uint32_t seq = telemetry_spool.send_seq;
+	while(seq < telemetry_spool.next_seq && !read_record(seq, &record)) {
+		telemetry_spool.lost++;
+		seq++;
+	}
+	telemetry_spool.send_seq = seq;
+	*end_seq = seq;
+	if(seq == telemetry_spool.next_seq) return 0;
+
+	// Samples are sent as offsets in seconds from the first sample, first row has sequence number seq
+	uint32_t first_seq = seq;
+	uint32_t base = record.time;
+	time_t base_unix = base;
+	localtime_r(&base_unix, &base_time);
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_uint(&writer, "seq", first_seq);
+	json_writer_add_time(&writer, "time", &base_time);
+
+	json_writer_begin_array(&writer, "sensors");
+	for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+		json_writer_add_string(&writer, NULL, telemetry_get_sensor(i)->name);
+	}
+	json_writer_end_array(&writer);
+
+	// Records are read one at a time so RAM use does not depend on spool size
+	json_writer_begin_array(&writer, "samples");
+	do {
+		json_writer_begin_array(&writer, NULL);
+		json_writer_add_int(&writer, NULL, (int32_t)(record.time - base));
+		for(uint8_t i = 0; i < TELEMETRY_NUM_SENSORS; ++i) {
+			json_writer_add_float(&writer, NULL, record.values[i], 2);
+		}
+		json_writer_end_array(&writer);
+		seq++;
+	} while(seq - first_seq < TELEMETRY_SPOOL_DRAIN_CHUNK && seq < telemetry_spool.next_seq && read_record(seq, &record));
+	json_writer_end_array(&writer);
+
+	json_writer_add_uint(&writer, "lost", telemetry_spool.lost);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	*end_seq = seq;
+	return json_writer_length(&writer);
+}
+
+void telemetry_spool_consume(uint32_t end_seq) {
+	if(end_seq > telemetry_spool.send_seq) mark_sent(end_seq - 1);
+	telemetry_spool.send_seq = end_seq;
+	telemetry_spool.lost = 0;
+
+	// Progress within a sector is recovered from the sent marks on boot
+	bool is_sector_done = end_seq / RECORDS_PER_SECTOR != telemetry_spool.saved_seq / RECORDS_PER_SECTOR;
+	if(is_sector_done || end_seq == telemetry_spool.next_seq) save_send_seq();
+}
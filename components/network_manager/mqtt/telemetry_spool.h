@@ -0,0 +1,70 @@
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_partition.h>
+
+#include "telemetry_batch.h"
+
+#define TELEMETRY_SPOOL_TAG "TELEMETRY_SPOOL"
+
+// Data partition holding the spool, see partitions.csv
+#define TELEMETRY_SPOOL_PARTITION_LABEL "telemetry"
+#define TELEMETRY_SPOOL_PARTITION_SUBTYPE 0x40
+
+// NVS key of the first sequence number not yet sent, only updated per sector and when the spool is drained
+#define TELEMETRY_SPOOL_SEND_SEQ_KEY "spool_send"
+
+#define TELEMETRY_SPOOL_RECORD_MAGIC 0x5354
+#define TELEMETRY_SPOOL_RECORD_UNSENT 0xFFFF
+#define TELEMETRY_SPOOL_SECTOR_SIZE 4096
+
+// Max samples sent per spooled message
+#define TELEMETRY_SPOOL_DRAIN_CHUNK 10
+
+// Delay between spooled messages in ms while draining
+#define TELEMETRY_SPOOL_DRAIN_PERIOD 500
+
+// Size of the spooled sensor data payload buffer
+#define TELEMETRY_SPOOL_PAYLOAD_SIZE 768
+
+// Fixed size flash record, record with sequence number seq is stored in slot seq % num_records
+struct telemetry_spool_record {
+	uint16_t magic;
+	uint16_t sent; // Cleared in place once the record is acked, not covered by crc
+	uint32_t seq;
+	uint32_t time;
+	float values[TELEMETRY_NUM_SENSORS];
+	uint32_t padding;
+	uint32_t crc;
+};
+
+// Circular log of samples recorded while MQTT is down, only used from the publish task
+struct telemetry_spool {
+	const esp_partition_t *partition;
+	uint32_t num_records;
+	uint32_t next_seq; // Sequence number of next appended sample
+	uint32_t send_seq; // First sequence number not yet sent
+	uint32_t saved_seq; // send_seq last stored in NVS
+	uint32_t lost; // Samples overwritten or corrupted before they were sent
+};
+
+// Find spool partition and recover write and send positions
+void init_telemetry_spool();
+
+// Check if spooled samples are waiting to be sent
+bool telemetry_spool_pending();
+
+// Append sample to spool, overwrites oldest sector when full
+esp_err_t telemetry_spool_append(const struct telemetry_sample *sample);
+
+// Serialize the next chunk of spooled samples into buffer, returns payload length or 0 if none
+size_t telemetry_spool_serialize(char *buffer, size_t size, uint32_t *end_seq);
+
+// Mark samples before end_seq as sent
+void telemetry_spool_consume(uint32_t end_seq);
+
+#endif
@@ -0,0 +1,58 @@
+#include "topic_table.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+static struct topic_entry entries[TOPIC_TABLE_MAX_TOPICS];
+static uint8_t num_entries;
+
+// Index + 1 into entries, 0 marks an empty bucket
+static uint8_t buckets[TOPIC_TABLE_BUCKETS];
+
+// FNV-1a
+static uint32_t hash_topic(const char *topic, uint32_t topic_len) {
+	uint32_t hash = 2166136261u;
+	for(uint32_t i = 0; i < topic_len; ++i) {
+		hash ^= (uint8_t)topic[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool topic_table_register(const char *topic, topic_handler_t handler) {
+	if(num_entries == TOPIC_TABLE_MAX_TOPICS) {
+		ESP_LOGE(TOPIC_TABLE_TAG, "Topic table full, cannot register %s", topic);
+		return false;
+	}
+
+	struct topic_entry *entry = &entries[num_entries];
+	entry->topic = topic;
+	entry->topic_len = strlen(topic);
+	entry->hash = hash_topic(topic, entry->topic_len);
+	entry->handler = handler;
+
+	// Linear probing, table is never more than half full
+	uint32_t bucket = entry->hash & (TOPIC_TABLE_BUCKETS - 1);
+	while(buckets[bucket] != 0) bucket = (bucket + 1) & (TOPIC_TABLE_BUCKETS - 1);
+	buckets[bucket] = ++num_entries;
+
+	return true;
+}
+
+topic_handler_t topic_table_lookup(const char *topic, uint32_t topic_len) {
+	uint32_t hash = hash_topic(topic, topic_len);
+	uint32_t bucket = hash & (TOPIC_TABLE_BUCKETS - 1);
+
+	while(buckets[bucket] != 0) {
+		const struct topic_entry *entry = &entries[buckets[bucket] - 1];
+		if(entry->hash == hash && entry->topic_len == topic_len && memcmp(entry->topic, topic, topic_len) == 0) {
+			return entry->handler;
+		}
+		bucket = (bucket + 1) & (TOPIC_TABLE_BUCKETS - 1);
+	}
+	return NULL;
+}
+
+uint8_t topic_table_count() { return num_entries; }
+
+const struct topic_entry* topic_table_get(uint8_t index) { return &entries[index]; }
@@ -0,0 +1,35 @@
+#ifndef TOPIC_TABLE_H
+#define TOPIC_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TOPIC_TABLE_TAG "TOPIC_TABLE"
+
+// Max number of subscribed topics
+#define TOPIC_TABLE_MAX_TOPICS 24
+
+// Hash buckets, power of two and at least twice the max number of topics
+#define TOPIC_TABLE_BUCKETS 64
+
+// Handler for data received on a topic, data points into the MQTT event and is not null terminated
+typedef void (*topic_handler_t)(const char *data, uint32_t data_len);
+
+struct topic_entry {
+	const char *topic; // Not copied, must stay allocated
+	uint16_t topic_len;
+	uint32_t hash;
+	topic_handler_t handler;
+};
+
+// Register handler for topic, returns false if table is full
+bool topic_table_register(const char *topic, topic_handler_t handler);
+
+// Find handler for a topic that is not null terminated, returns NULL if none registered
+topic_handler_t topic_table_lookup(const char *topic, uint32_t topic_len);
+
+// Iterate registered topics in registration order
+uint8_t topic_table_count();
+const struct topic_entry* topic_table_get(uint8_t index);
+
+#endif
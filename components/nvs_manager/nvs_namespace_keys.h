@@ -27,4 +27,10 @@
 // RF transmitter namespace
 #define RF_TRANSMITTER_NVS_NAMESPACE "RF"
 
+// Telemetry namespace
+#define TELEMETRY_NVS_NAMESPACE "TELEMETRY"
+
+// Device shadow namespace
+#define SHADOW_NVS_NAMESPACE "SHADOW"
+
 #endif
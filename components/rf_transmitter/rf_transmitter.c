@@ -9,6 +9,7 @@
 
 #include "ports.h"
 #include "mqtt_manager.h"
+#include "equipment_status.h"
 
 void init_rf_protocol() {
 	// Setup Transmission Protocol
@@ -74,8 +75,8 @@ esp_err_t control_power_outlet(int power_outlet_id, bool state) {
 		return ESP_FAIL;
 	}
 
-	cJSON_SetNumberValue(get_rf_statuses()[power_outlet_id], state);
-	publish_equipment_status();
+	// Published once the coalescing window closes
+	equipment_status_set_rf(power_outlet_id, state);
 
 	xQueueSend(rf_transmitter_queue, &setup_rf_message, pdMS_TO_TICKS(20000)); // TODO check if rf_message_address is not null (very important)
 	ESP_LOGI(RF_TAG, "xqueue sent");
@@ -357,58 +357,39 @@ void irrigation_control() {
 	}
 }
 
-void update_irrigation_timings(cJSON *obj) {
+void update_irrigation_timings(const struct irrigation_settings *settings) {
 	const char* UPDATE_IRRIGATION_KEY = "UPDATE_IRRIGATION";
-	bool updatedIrrigationTimings = false;
-
-	cJSON *element = obj->child;
 	nvs_handle_t *handle = nvs_get_handle(IRRIGATION_NVS_NAMESPACE);
 
-	while(element != NULL) {
-		if(strcmp(element->string, IRRIGATION_ON_KEY) == 0) {
-			irrigation_on_time = element->valueint * 60;
-			nvs_add_uint32(handle, IRRIGATION_ON_KEY, irrigation_on_time);
-			updatedIrrigationTimings = true;
-			ESP_LOGI(UPDATE_IRRIGATION_KEY, "Updated irrigation on time to: %d", irrigation_on_time);
-		} else if(strcmp(element->string, IRRIGATION_OFF_KEY) == 0) {
-			irrigation_off_time = element->valueint * 60;
-			nvs_add_uint32(handle, IRRIGATION_OFF_KEY, irrigation_off_time);
-			updatedIrrigationTimings = true;
-			ESP_LOGI(UPDATE_IRRIGATION_KEY, "Updated irrigation off time to: %d", irrigation_off_time);
-		} else {
-			ESP_LOGE(UPDATE_IRRIGATION_KEY, "Error: Invalid Key");
-		}
-		element = element->next;
+	if(settings->fields & IRRIGATION_SETTINGS_ON) {
+		irrigation_on_time = settings->on_interval * 60;
+		nvs_add_uint32(handle, IRRIGATION_ON_KEY, irrigation_on_time);
+		ESP_LOGI(UPDATE_IRRIGATION_KEY, "Updated irrigation on time to: %d", irrigation_on_time);
+	}
+	if(settings->fields & IRRIGATION_SETTINGS_OFF) {
+		irrigation_off_time = settings->off_interval * 60;
+		nvs_add_uint32(handle, IRRIGATION_OFF_KEY, irrigation_off_time);
+		ESP_LOGI(UPDATE_IRRIGATION_KEY, "Updated irrigation off time to: %d", irrigation_off_time);
 	}
 
-	if(updatedIrrigationTimings) enable_timer(&dev, &irrigation_timer, irrigation_on_time);
+	if(settings->fields) enable_timer(&dev, &irrigation_timer, irrigation_on_time);
 	nvs_commit_data(handle);
 }
 
-void update_grow_light_timings(cJSON *obj) {
+void update_grow_light_timings(const struct grow_light_settings *settings) {
 	const char* UPDATE_GROW_LIGHTS_KEY = "UPDATE_GROW_LIGHTS";
-	struct tm lights_on, lights_off;
-
-	cJSON *element = obj->child;
+	struct tm lights_on = settings->lights_on, lights_off = settings->lights_off;
 	nvs_handle_t *handle = nvs_get_handle(GROW_LIGHT_NVS_NAMESPACE);
 
-	while(element != NULL) {
-		if(strcmp(element->string, LIGHTS_ON_KEY) == 0) {
-			parse_iso_timestamp(element->valuestring, &lights_on);
-			
-			nvs_add_uint8(handle, LIGHTS_ON_HR_KEY, lights_on.tm_hour);
-			nvs_add_uint8(handle, LIGHTS_ON_MIN_KEY, lights_on.tm_min);
-			ESP_LOGI(UPDATE_GROW_LIGHTS_KEY, "Lights on time: %d hr and %d min", lights_on.tm_hour, lights_on.tm_min);
-		} else if(strcmp(element->string, LIGHTS_OFF_KEY) == 0) {
-			parse_iso_timestamp(element->valuestring, &lights_off);
-
-			nvs_add_uint8(handle, LIGHTS_OFF_HR_KEY, lights_off.tm_hour);
-			nvs_add_uint8(handle, LIGHTS_OFF_MIN_KEY, lights_off.tm_min);
-			ESP_LOGI(UPDATE_GROW_LIGHTS_KEY, "Lights off time: %d hr and %d min", lights_off.tm_hour, lights_off.tm_min);
-		} else {
-			ESP_LOGE(UPDATE_GROW_LIGHTS_KEY, "Error: Invalid Key: %s", element->string);
-		}
-		element = element->next;
+	if(settings->fields & GROW_LIGHT_SETTINGS_ON) {
+		nvs_add_uint8(handle, LIGHTS_ON_HR_KEY, lights_on.tm_hour);
+		nvs_add_uint8(handle, LIGHTS_ON_MIN_KEY, lights_on.tm_min);
+		ESP_LOGI(UPDATE_GROW_LIGHTS_KEY, "Lights on time: %d hr and %d min", lights_on.tm_hour, lights_on.tm_min);
+	}
+	if(settings->fields & GROW_LIGHT_SETTINGS_OFF) {
+		nvs_add_uint8(handle, LIGHTS_OFF_HR_KEY, lights_off.tm_hour);
+		nvs_add_uint8(handle, LIGHTS_OFF_MIN_KEY, lights_off.tm_min);
+		ESP_LOGI(UPDATE_GROW_LIGHTS_KEY, "Lights off time: %d hr and %d min", lights_off.tm_hour, lights_off.tm_min);
 	}
 	nvs_commit_data(handle);
 
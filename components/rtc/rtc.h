@@ -1,3 +1,6 @@
+#ifndef RTC_H
+#define RTC_H
+
 #include "ds3231.h"
 
 #include <cJSON.h>
@@ -20,6 +23,26 @@ i2c_dev_t dev;
 #define LIGHTS_OFF_HR_KEY "off_hr"
 #define LIGHTS_OFF_MIN_KEY "off_min"
 
+// Fields present in an irrigation or grow light settings update
+#define IRRIGATION_SETTINGS_ON (1 << 0)
+#define IRRIGATION_SETTINGS_OFF (1 << 1)
+#define GROW_LIGHT_SETTINGS_ON (1 << 0)
+#define GROW_LIGHT_SETTINGS_OFF (1 << 1)
+
+// Parsed irrigation settings, intervals in minutes
+struct irrigation_settings {
+	uint8_t fields;
+	uint32_t on_interval;
+	uint32_t off_interval;
+};
+
+// Parsed grow light settings
+struct grow_light_settings {
+	uint8_t fields;
+	struct tm lights_on;
+	struct tm lights_off;
+};
+
 // Task handle
 TaskHandle_t timer_alarm_task_handle;
 
@@ -64,7 +87,7 @@ void init_irrigation();
 void irrigation_control();
 
 // Update irrigation timings
-void update_irrigation_timings(cJSON *obj);
+void update_irrigation_timings(const struct irrigation_settings *settings);
 
 // Initialize grow light control
 void init_lights();
@@ -73,8 +96,10 @@ void init_lights();
 void update_grow_light_alarms(uint8_t on_hr, uint8_t on_min, uint8_t off_hr, uint8_t off_min);
 
 // Update growlight timings
-void update_grow_light_timings(cJSON *obj);
+void update_grow_light_timings(const struct grow_light_settings *settings);
 
 // Turn irrigation on/off
 void irrigation_on();
 void irrigation_off();
+
+#endif
@@ -15,6 +15,8 @@
 #define PUMPS "pumps"
 #define ALARM_MIN "alarm_min"
 #define ALARM_MAX "alarm_max"
+#define PUBLISH_DEADBAND "pub_dband"
+#define PUBLISH_MAX_SILENCE "pub_silence"
 
 // ec specific keys
 #define PUMP_NUM "pump_"
@@ -13,8 +13,11 @@
 #include "ports.h"
 #include "mqtt_manager.h"
 #include "rf_transmitter.h"
+#include "equipment_status.h"
 
 void init_control() {
+	control_settings_lock = xSemaphoreCreateMutex();
+
 	ec_pump_gpios[0] = EC_NUTRIENT_1_PUMP_GPIO;
 	ec_pump_gpios[1] = EC_NUTRIENT_2_PUMP_GPIO;
 	ec_pump_gpios[2] = EC_NUTRIENT_3_PUMP_GPIO;
@@ -29,13 +32,13 @@ void init_control() {
 	gpio_pad_select_gpio(FLOAT_SWITCH_BOTTOM_GPIO);
 	gpio_set_direction(FLOAT_SWITCH_BOTTOM_GPIO, GPIO_MODE_INPUT);
 
-	init_sensor_control(get_ph_control(), "PH_CONTROL", get_ph_control_status(), PH_MARGIN_ERROR);
+	init_sensor_control(get_ph_control(), "PH_CONTROL", EQUIPMENT_STATUS_PH, PH_MARGIN_ERROR);
 	init_doser_control(get_ph_control());
 
-	init_sensor_control(get_ec_control(), "EC_CONTROL", get_ec_control_status(), EC_MARGIN_ERROR);
+	init_sensor_control(get_ec_control(), "EC_CONTROL", EQUIPMENT_STATUS_EC, EC_MARGIN_ERROR);
 	init_doser_control(get_ec_control());
 
-	init_sensor_control(get_water_temp_control(), "WATER_TEMP_CONTROL", get_water_temp_control_status(), WATER_TEMP_MARGIN_ERROR);
+	init_sensor_control(get_water_temp_control(), "WATER_TEMP_CONTROL", EQUIPMENT_STATUS_WATER_TEMP, WATER_TEMP_MARGIN_ERROR);
 	is_water_cooler_on = false;
 
 	init_reservoir();
@@ -46,11 +49,13 @@ void init_control() {
 
 void sensor_control (void *parameter) {
 	for(;;)  {
-		// Check sensors
+		// Check sensors, never against a partially applied settings document
+		xSemaphoreTake(control_settings_lock, portMAX_DELAY);
 		if(reservoir_control_active) check_water_level(); // TODO remove if statement for consistency
 		check_ec();
 		check_ph();
 		check_water_temp();
+		xSemaphoreGive(control_settings_lock);
 
 		// Wait till next sensor readings
 		vTaskDelay(pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
@@ -1,9 +1,13 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 
 // Task handle
 TaskHandle_t sensor_control_task_handle;
 
+// Held by the control loop during checks and while a settings document is applied
+SemaphoreHandle_t control_settings_lock;
+
 // Init control
 void init_control();
 
@@ -60,9 +60,9 @@ void ec_dose() {
 	}
 }
 
-void ec_update_settings(cJSON *item) {
+void ec_update_settings(const struct control_settings *settings) {
 	nvs_handle_t *handle = nvs_get_handle(EC_NAMESPACE);
-	control_update_settings(&ec_control, item, handle);
+	control_update_settings(&ec_control, settings, handle);
 	if (get_ec_control()->is_control_enabled) {
 		get_ec_control()->is_up_control = true;
 		nvs_add_uint8(handle, UP_CONTROL, 1);
@@ -73,31 +73,15 @@ void ec_update_settings(cJSON *item) {
 		ESP_LOGI(get_ec_control()->name, "Updated up control status to: %s", 0 ? "true" : "false");
 	}
 
-	cJSON *element = item->child;
-	while(element != NULL) {
-		char *key = element->string;
-		if(strcmp(key, CONTROL) == 0) {
-			cJSON *control_element = element->child;
-			while(control_element != NULL) {
-				char *control_key = control_element->string;
-				if(strcmp(control_key, PUMPS) == 0) {
-					cJSON *pumps_element = control_element->child;
-					while(pumps_element != NULL) {
-						char *pumps_key = pumps_element->string;
-						uint8_t pump_num = pumps_key[PUMP_NUM_INDEX] - '1';
-						float pump_val = pumps_element->valuedouble;
-
-						ec_nutrient_proportions[pump_num] = pump_val;
-						ESP_LOGI("Updated ec pump", "%d to: %f", pump_num+1, pump_val);
-						nvs_add_float(handle, pumps_key, pump_val);
-
-						pumps_element = pumps_element->next;
-					}
-				}
-				control_element = control_element->next;
-			}
-		}
-		element = element->next;
+	// Pump keys are pump_1 to pump_N
+	char key[] = PUMP_NUM "1";
+	for(uint8_t pump_num = 0; pump_num < EC_NUM_PUMPS; ++pump_num) {
+		if(!(settings->pumps & (1 << pump_num))) continue;
+
+		ec_nutrient_proportions[pump_num] = settings->pump_proportions[pump_num];
+		key[PUMP_NUM_INDEX] = pump_num + '1';
+		ESP_LOGI("Updated ec pump", "%d to: %f", pump_num+1, ec_nutrient_proportions[pump_num]);
+		nvs_add_float(handle, key, ec_nutrient_proportions[pump_num]);
 	}
 
 	nvs_commit_data(handle);
@@ -36,7 +36,7 @@ void check_ec();
 void ec_dose();
 
 // Update settings
-void ec_update_settings(cJSON *item);
+void ec_update_settings(const struct control_settings *settings);
 
 // Get and store settings from NVS
 void ec_get_nvs_settings();
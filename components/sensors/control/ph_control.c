@@ -49,9 +49,9 @@ void ph_pump_off() {
 	control_start_wait_timer(&ph_control);
 }
 
-void ph_update_settings(cJSON *item) {
+void ph_update_settings(const struct control_settings *settings) {
 	nvs_handle_t *handle = nvs_get_handle(PH_NAMESPACE);
-	control_update_settings(&ph_control, item, handle);
+	control_update_settings(&ph_control, settings, handle);
 
 	nvs_commit_data(handle);
 	ESP_LOGI(PH_TAG, "Updated settings and committed data to NVS");
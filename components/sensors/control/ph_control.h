@@ -26,7 +26,7 @@ void ph_down_pump();
 void ph_pump_off();
 
 // Update settings
-void ph_update_settings(cJSON *item);
+void ph_update_settings(const struct control_settings *settings);
 
 // Get and store settings from NVS
 void ph_get_nvs_settings();
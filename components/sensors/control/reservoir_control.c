@@ -175,37 +175,32 @@ void init_reservoir() {
 	}
 }
 
-void update_reservoir_settings(cJSON* obj) {
+void update_reservoir_settings(const struct reservoir_settings *settings) {
 	char* TAG = "Update Reservoir Settings";
-	cJSON *element = obj->child;
 	nvs_handle_t *handle = nvs_get_handle(WATER_RESERVOIR_NVS_NAMESPACE);
 
-	while(element != NULL) {
-		if(strcmp(element->string, RESERVOIR_REPLACEMENT_INTERVAL_KEY) == 0) {
-			reservoir_replacement_interval = element->valueint;
-			nvs_add_uint16(handle, RESERVOIR_REPLACEMENT_INTERVAL_KEY, reservoir_replacement_interval);
-			ESP_LOGI(TAG, "Updated Reservoir Replacement Interval to: %d", reservoir_replacement_interval);
-		} else if(strcmp(element->string, RESERVOIR_ENABLED_KEY) == 0) {
-			reservoir_control_active = element->valueint;
-			if(reservoir_control_active) {
-				enable_alarm(&reservoir_replacement_alarm, next_replacement_date);
-			} else {
-				disable_alarm(&reservoir_replacement_alarm);
-			}
-			nvs_add_uint8(handle, RESERVOIR_ENABLED_KEY, (uint8_t)(reservoir_control_active));
-			ESP_LOGI(TAG, "Updated Reservoir Enabled to: %s", element->valueint == 0 ? "false" : "true");
-		} else if(strcmp(element->string, RESERVOIR_NEXT_REPLACEMENT_DATE_KEY) == 0) {
-			parse_iso_timestamp(element->valuestring, &next_replacement_date);
-			ESP_LOGI(TAG, "Date: %d, %d, %d, %d, %d", next_replacement_date.tm_year, next_replacement_date.tm_mon, next_replacement_date.tm_mday, next_replacement_date.tm_hour, next_replacement_date.tm_min);
-			uint64_t next_replacement_in_seconds = (uint64_t)(mktime(&next_replacement_date));
+	if(settings->fields & RESERVOIR_SETTINGS_INTERVAL) {
+		reservoir_replacement_interval = settings->replacement_interval;
+		nvs_add_uint16(handle, RESERVOIR_REPLACEMENT_INTERVAL_KEY, reservoir_replacement_interval);
+		ESP_LOGI(TAG, "Updated Reservoir Replacement Interval to: %d", reservoir_replacement_interval);
+	}
+	if(settings->fields & RESERVOIR_SETTINGS_ENABLED) {
+		reservoir_control_active = settings->is_control_active;
+		if(reservoir_control_active) {
 			enable_alarm(&reservoir_replacement_alarm, next_replacement_date);
-			nvs_add_uint64(handle, RESERVOIR_NEXT_REPLACEMENT_DATE_KEY, next_replacement_in_seconds);
-			ESP_LOGI(TAG, "Updated Next Reservoir Replacement Date to : %" PRIu64 "", next_replacement_in_seconds);
 		} else {
-			ESP_LOGE(TAG, "Error: Invalid Key");
+			disable_alarm(&reservoir_replacement_alarm);
 		}
-		
-		element = element->next;
+		nvs_add_uint8(handle, RESERVOIR_ENABLED_KEY, (uint8_t)(reservoir_control_active));
+		ESP_LOGI(TAG, "Updated Reservoir Enabled to: %s", reservoir_control_active ? "true" : "false");
+	}
+	if(settings->fields & RESERVOIR_SETTINGS_DATE) {
+		next_replacement_date = settings->next_replacement_date;
+		ESP_LOGI(TAG, "Date: %d, %d, %d, %d, %d", next_replacement_date.tm_year, next_replacement_date.tm_mon, next_replacement_date.tm_mday, next_replacement_date.tm_hour, next_replacement_date.tm_min);
+		uint64_t next_replacement_in_seconds = (uint64_t)(mktime(&next_replacement_date));
+		enable_alarm(&reservoir_replacement_alarm, next_replacement_date);
+		nvs_add_uint64(handle, RESERVOIR_NEXT_REPLACEMENT_DATE_KEY, next_replacement_in_seconds);
+		ESP_LOGI(TAG, "Updated Next Reservoir Replacement Date to : %" PRIu64 "", next_replacement_in_seconds);
 	}
 
 	nvs_commit_data(handle);
@@ -1,3 +1,6 @@
+#ifndef RESERVOIR_CONTROL_H
+#define RESERVOIR_CONTROL_H
+
 #include <stdbool.h>
 #include "rf_transmitter.h"
 #include "time.h"
@@ -7,6 +10,19 @@
 #define RESERVOIR_ENABLED_KEY "is_control"
 #define RESERVOIR_NEXT_REPLACEMENT_DATE_KEY "replace_date"
 
+// Fields present in a reservoir settings update
+#define RESERVOIR_SETTINGS_INTERVAL (1 << 0)
+#define RESERVOIR_SETTINGS_ENABLED (1 << 1)
+#define RESERVOIR_SETTINGS_DATE (1 << 2)
+
+// Parsed reservoir settings
+struct reservoir_settings {
+	uint8_t fields;
+	uint16_t replacement_interval;
+	bool is_control_active;
+	struct tm next_replacement_date;
+};
+
 bool reservoir_control_active;
 bool reservoir_change_flag;
 bool top_float_switch_trigger;
@@ -30,6 +46,8 @@ struct alarm* get_reservoir_alarm();
 
 void replace_reservoir();
 
-void update_reservoir_settings(cJSON* obj);
+void update_reservoir_settings(const struct reservoir_settings *settings);
 
 void init_reservoir();
+
+#endif
@@ -6,6 +6,7 @@
 #include "rtc.h"
 #include "sync_sensors.h"
 #include "control_settings_keys.h"
+#include "equipment_status.h"
 
 // --------------------------------------------------- Helper functions ----------------------------------------------
 
@@ -24,6 +25,11 @@ bool control_add_check(struct sensor_control *control_in) {
 	return false;
 }
 
+// Mark control status for publishing, only sent when it changed
+void control_update_status(struct sensor_control *control_in) {
+	equipment_status_set_control(control_in->status_id, control_in->is_control_active);
+}
+
 float control_get_target_value(struct sensor_control *control_in) {
 	return !is_day && control_in->is_day_night_active ? control_in->night_target_value : control_in->target_value;
 }
@@ -33,13 +39,15 @@ float control_get_target_value(struct sensor_control *control_in) {
 
 // --------------------------------------------------- Public interface ----------------------------------------------
 
-void init_sensor_control(struct sensor_control *control_in, char *name_in, cJSON *object_in, float margin_error_in) {
+void init_sensor_control(struct sensor_control *control_in, char *name_in, uint8_t status_id_in, float margin_error_in) {
 	strcpy(control_in->name, name_in);
 
-	control_in->status_object = object_in;
+	control_in->status_id = status_id_in;
 	control_in->is_control_active = false;
 	control_in->is_doser = false;
 	control_in->margin_error = margin_error_in;
+	control_in->publish_deadband = 0;
+	control_in->publish_max_silence = 0;
 
 	control_reset_checks(control_in);
 
@@ -56,6 +64,9 @@ void init_doser_control(struct sensor_control *control_in) {
 bool control_get_enabled(struct sensor_control *control_in) { return control_in->is_control_enabled; }
 bool control_get_active(struct sensor_control *control_in) { return control_in->is_control_active; }
 
+float control_get_publish_deadband(struct sensor_control *control_in) { return control_in->publish_deadband; }
+uint32_t control_get_publish_max_silence(struct sensor_control *control_in) { return control_in->publish_max_silence; }
+
 struct timer* control_get_dose_timer(struct sensor_control *control_in) { return &control_in->dose_timer; }
 struct timer* control_get_wait_timer(struct sensor_control *control_in) { return &control_in->wait_timer; }
 
@@ -72,6 +83,7 @@ void control_disable(struct sensor_control *control_in) {
 
 	//TODO turn off pumps if possible/ensure pumps are turned off (if doser)
 	control_reset_checks(control_in);
+	control_update_status(control_in);
 
 	ESP_LOGI(control_in->name, "Disabled");
 }
@@ -95,6 +107,7 @@ int control_check_sensor(struct sensor_control *control_in, float current_value)
 	if(under_target || over_target) {
 		if(control_add_check(control_in)) {
 			control_in->is_control_active = true;
+			control_update_status(control_in);
 			return under_target ? -1 : 1;
 		}
 	} else if(control_in->check_index > 0) {
@@ -103,6 +116,7 @@ int control_check_sensor(struct sensor_control *control_in, float current_value)
 	}
 
 	if(!control_in->is_doser) control_in->is_control_active = false;
+	control_update_status(control_in);
 	return 0;
 }
 
@@ -111,61 +125,58 @@ void control_start_wait_timer(struct sensor_control *control_in) { enable_timer(
 void control_set_dose_percentage(struct sensor_control *control_in, float value) { control_in->dose_percentage = value; }
 float control_get_dose_time(struct sensor_control *control_in) { return control_in->dose_time * control_in->dose_percentage; }
 
-void control_update_settings(struct sensor_control *control_in, cJSON *item, nvs_handle_t *handle) {
-	cJSON *element = item->child;
-	while(element != NULL) {
-		char *key = element->string;
-		if(strcmp(key, MONITORING_ONLY) == 0) {
-			!element->valueint ? control_enable(control_in) : control_disable(control_in);
-			nvs_add_uint8(handle, MONITORING_ONLY, (uint8_t)(control_in->is_control_enabled));
-			ESP_LOGI(control_in->name, "Updated control only to: %s", element->valueint != 0 ? "false" : "true");
-		} else if(strcmp(key, CONTROL) == 0) {
-			cJSON *control_element = element->child;
-			while(control_element != NULL) {
-				char *control_key = control_element->string;
-				if(strcmp(control_key, DOSING_TIME) == 0) {
-					control_in->dose_time = control_element->valuedouble;
-					nvs_add_float(handle, DOSING_TIME, control_in->dose_time);
-					ESP_LOGI(control_in->name, "Updated dosing time to: %f", control_element->valuedouble);
-				} else if(strcmp(control_key, DOSING_INTERVAL) == 0) {
-					control_in->wait_time = control_element->valuedouble;
-					nvs_add_float(handle, DOSING_INTERVAL, control_in->wait_time);
-					ESP_LOGI(control_in->name, "Updated wait time to: %f", control_element->valuedouble);
-				} else if(strcmp(control_key, DAY_AND_NIGHT) == 0) {
-					control_in->is_day_night_active = control_element->valueint;
-					nvs_add_uint8(handle, DAY_AND_NIGHT, control_element->valueint);
-					ESP_LOGI(control_in->name,"Updated day night control status to: %s", control_element->valueint == 0 ? "false" : "true");
-				} else if(strcmp(control_key, DAY_TARGET_VALUE) == 0 || strcmp(control_key, TARGET_VALUE) == 0) {
-					control_in->target_value = control_element->valuedouble;
-					nvs_add_float(handle, TARGET_VALUE, control_in->target_value);
-					ESP_LOGI(control_in->name, "Updated target value to: %f", control_element->valuedouble);
-				} else if(strcmp(control_key, NIGHT_TARGET_VALUE) == 0) {
-					control_in->night_target_value = control_element->valuedouble;
-					nvs_add_float(handle, NIGHT_TARGET_VALUE, (control_in->night_target_value));
-					ESP_LOGI(control_in->name, "Updated night target value to: %f", control_element->valuedouble);
-				} else if(strcmp(control_key, UP_CONTROL) == 0) {
-					control_in->is_up_control = control_element->valueint;
-					nvs_add_uint8(handle, UP_CONTROL, control_element->valueint);
-					ESP_LOGI(control_in->name, "Updated up control status to: %s", control_element->valueint ? "true" : "false");
-				} else if(strcmp(control_key, DOWN_CONTROL) == 0) {
-					control_in->is_down_control = control_element->valueint;
-					nvs_add_uint8(handle, DOWN_CONTROL, control_element->valueint);
-					ESP_LOGI(control_in->name, "Updated down control status to: %s", control_element->valueint ? "true" : "false");
-				}
-				control_element = control_element->next;
-			}
-		}
-		// TODO add alarm functionality
-		//else if(strcmp(key, ALARM_MIN) == 0) {
-//			//TODO update alarm min
-//			ESP_LOGI("Updated ph alarm min to: ", "%d", element->valueint);
-//		} else if(strcmp(key, ALARM_MAX) == 0) {
-//			//TODO update alarm min
-//			ESP_LOGI("Updated ph alarm max to: ", "%d", element->valueint);
-//		}
-
-		element = element->next;
+void control_update_settings(struct sensor_control *control_in, const struct control_settings *settings, nvs_handle_t *handle) {
+	if(settings->fields & CONTROL_SETTINGS_MONITORING_ONLY) {
+		!settings->monitoring_only ? control_enable(control_in) : control_disable(control_in);
+		nvs_add_uint8(handle, MONITORING_ONLY, (uint8_t)(control_in->is_control_enabled));
+		ESP_LOGI(control_in->name, "Updated control only to: %s", settings->monitoring_only ? "false" : "true");
+	}
+	if(settings->fields & CONTROL_SETTINGS_DOSE_TIME) {
+		control_in->dose_time = settings->dose_time;
+		nvs_add_float(handle, DOSING_TIME, control_in->dose_time);
+		ESP_LOGI(control_in->name, "Updated dosing time to: %f", control_in->dose_time);
+	}
+	if(settings->fields & CONTROL_SETTINGS_DOSE_INTERVAL) {
+		control_in->wait_time = settings->dose_interval;
+		nvs_add_float(handle, DOSING_INTERVAL, control_in->wait_time);
+		ESP_LOGI(control_in->name, "Updated wait time to: %f", control_in->wait_time);
+	}
+	if(settings->fields & CONTROL_SETTINGS_DAY_NIGHT) {
+		control_in->is_day_night_active = settings->is_day_night_active;
+		nvs_add_uint8(handle, DAY_AND_NIGHT, control_in->is_day_night_active);
+		ESP_LOGI(control_in->name,"Updated day night control status to: %s", control_in->is_day_night_active ? "true" : "false");
+	}
+	if(settings->fields & CONTROL_SETTINGS_TARGET) {
+		control_in->target_value = settings->target_value;
+		nvs_add_float(handle, TARGET_VALUE, control_in->target_value);
+		ESP_LOGI(control_in->name, "Updated target value to: %f", control_in->target_value);
+	}
+	if(settings->fields & CONTROL_SETTINGS_NIGHT_TARGET) {
+		control_in->night_target_value = settings->night_target_value;
+		nvs_add_float(handle, NIGHT_TARGET_VALUE, control_in->night_target_value);
+		ESP_LOGI(control_in->name, "Updated night target value to: %f", control_in->night_target_value);
+	}
+	if(settings->fields & CONTROL_SETTINGS_UP_CONTROL) {
+		control_in->is_up_control = settings->is_up_control;
+		nvs_add_uint8(handle, UP_CONTROL, control_in->is_up_control);
+		ESP_LOGI(control_in->name, "Updated up control status to: %s", control_in->is_up_control ? "true" : "false");
+	}
+	if(settings->fields & CONTROL_SETTINGS_DOWN_CONTROL) {
+		control_in->is_down_control = settings->is_down_control;
+		nvs_add_uint8(handle, DOWN_CONTROL, control_in->is_down_control);
+		ESP_LOGI(control_in->name, "Updated down control status to: %s", control_in->is_down_control ? "true" : "false");
+	}
+	if(settings->fields & CONTROL_SETTINGS_PUBLISH_DEADBAND) {
+		control_in->publish_deadband = settings->publish_deadband;
+		nvs_add_float(handle, PUBLISH_DEADBAND, control_in->publish_deadband);
+		ESP_LOGI(control_in->name, "Updated publish deadband to: %f", control_in->publish_deadband);
+	}
+	if(settings->fields & CONTROL_SETTINGS_PUBLISH_MAX_SILENCE) {
+		control_in->publish_max_silence = settings->publish_max_silence;
+		nvs_add_uint32(handle, PUBLISH_MAX_SILENCE, control_in->publish_max_silence);
+		ESP_LOGI(control_in->name, "Updated publish max silence to: %d", control_in->publish_max_silence);
 	}
+	// TODO add alarm functionality
 	ESP_LOGI(control_in->name, "Finished updating all values");
 }
 
@@ -181,6 +192,8 @@ void control_get_nvs_settings(struct sensor_control *control_in, char *namespace
 	nvs_get_uint8(namespace, DOWN_CONTROL, (uint8_t*)(&control_in->is_down_control));
 	nvs_get_float(namespace, DOSING_TIME, &control_in->dose_time);
 	nvs_get_float(namespace, DOSING_INTERVAL, &control_in->wait_time);
+	nvs_get_float(namespace, PUBLISH_DEADBAND, &control_in->publish_deadband);
+	nvs_get_uint32(namespace, PUBLISH_MAX_SILENCE, &control_in->publish_max_silence);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
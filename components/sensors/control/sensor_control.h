@@ -17,7 +17,7 @@
 // TODO separate out struct vars
 struct sensor_control {
 	char name[25];
-	cJSON *status_object;
+	uint8_t status_id; // Control id in equipment status
 	bool is_control_enabled;
 	bool is_control_active;
 	bool is_doser;
@@ -34,6 +34,40 @@ struct sensor_control {
 	float dose_time;
 	float wait_time;
 	float dose_percentage;
+	float publish_deadband; // Live data is only published if the reading moved more than this, 0 publishes every reading
+	uint32_t publish_max_silence; // Seconds after which live data is published even if unchanged, 0 for no limit
+};
+
+// Fields present in a control settings update
+#define CONTROL_SETTINGS_MONITORING_ONLY (1 << 0)
+#define CONTROL_SETTINGS_DOSE_TIME (1 << 1)
+#define CONTROL_SETTINGS_DOSE_INTERVAL (1 << 2)
+#define CONTROL_SETTINGS_DAY_NIGHT (1 << 3)
+#define CONTROL_SETTINGS_TARGET (1 << 4)
+#define CONTROL_SETTINGS_NIGHT_TARGET (1 << 5)
+#define CONTROL_SETTINGS_UP_CONTROL (1 << 6)
+#define CONTROL_SETTINGS_DOWN_CONTROL (1 << 7)
+#define CONTROL_SETTINGS_PUBLISH_DEADBAND (1 << 8)
+#define CONTROL_SETTINGS_PUBLISH_MAX_SILENCE (1 << 9)
+
+// Max pump proportions in a control settings update
+#define CONTROL_SETTINGS_MAX_PUMPS 6
+
+// Parsed control settings, only fields flagged in fields are applied
+struct control_settings {
+	uint16_t fields;
+	bool monitoring_only;
+	float dose_time;
+	float dose_interval;
+	bool is_day_night_active;
+	float target_value;
+	float night_target_value;
+	bool is_up_control;
+	bool is_down_control;
+	float publish_deadband;
+	uint32_t publish_max_silence;
+	uint8_t pumps; // Bit i set if pump_proportions[i] is present
+	float pump_proportions[CONTROL_SETTINGS_MAX_PUMPS];
 };
 
 #endif /* COMPONENTS_SENSORS_CONTROL_SENSOR_CONTROL_H_ */
@@ -41,13 +75,17 @@ struct sensor_control {
 // TODO add RME's
 
 // Initialize control structure
-void init_sensor_control(struct sensor_control *control_in, char *name_in, cJSON *object_in, float margin_error_in);
+void init_sensor_control(struct sensor_control *control_in, char *name_in, uint8_t status_id_in, float margin_error_in);
 void init_doser_control(struct sensor_control *control_in);
 
 // Get enable/active statuses
 bool control_get_enabled(struct sensor_control *control_in);
 bool control_get_active(struct sensor_control *control_in);
 
+// Get live data publishing thresholds
+float control_get_publish_deadband(struct sensor_control *control_in);
+uint32_t control_get_publish_max_silence(struct sensor_control *control_in);
+
 // Get timers
 struct timer* control_get_dose_timer(struct sensor_control *control_in);
 struct timer* control_get_wait_timer(struct sensor_control *control_in);
@@ -56,6 +94,9 @@ struct timer* control_get_wait_timer(struct sensor_control *control_in);
 void control_enable(struct sensor_control *control_in);
 void control_disable(struct sensor_control *control_in);
 
+// Queue active status for the next equipment status publish
+void control_update_status(struct sensor_control *control_in);
+
 // Checks if sensor is out of range
 bool control_is_under_target(struct sensor_control *control_in, float current_value);
 bool control_is_over_target(struct sensor_control *control_in, float current_value);
@@ -70,8 +111,8 @@ void control_start_wait_timer(struct sensor_control *control_in);
 void control_set_dose_percentage(struct sensor_control *control_in, float value);
 float control_get_dose_time(struct sensor_control *control_in);
 
-// Update settings using JSON string
-void control_update_settings(struct sensor_control *control_in, cJSON *item, nvs_handle_t *handle);
+// Apply parsed settings and add them to NVS handle
+void control_update_settings(struct sensor_control *control_in, const struct control_settings *settings, nvs_handle_t *handle);
 
 // Get sensor settings stored in NVS
 void control_get_nvs_settings(struct sensor_control *control_in, char *namespace);
@@ -39,9 +39,9 @@ void stop_water_adjustment() {
     control_power_outlet(WATER_COOLER, false);
 }
 
-void water_temp_update_settings(cJSON *item) {
+void water_temp_update_settings(const struct control_settings *settings) {
     nvs_handle_t *handle = nvs_get_handle(WATER_TEMP_NVS_NAMESPACE);
-	control_update_settings(&water_temp_control, item, handle);
+	control_update_settings(&water_temp_control, settings, handle);
 
 	nvs_commit_data(handle);
 	ESP_LOGI(WATER_TEMP_TAG, "Updated settings and committed data to NVS");
@@ -30,7 +30,7 @@ void cool_water();
 void stop_water_adjustment();
 
 // Update settings
-void water_temp_update_settings(cJSON *item);
+void water_temp_update_settings(const struct control_settings *settings);
 
 // Get and store settings from NVS
 void water_temp_get_nvs_settings();
\ No newline at end of file
@@ -74,7 +74,7 @@ esp_err_t calibrate_ec_dry(ec_sensor_t *dev);
 esp_err_t clear_calibration_ec(ec_sensor_t *dev);
 
 /**
- * @brief Read EC with temperature compensation
+ * @brief Read EC with temperature compensation, returns after the next conversion (~640 ms)
  * @param dev I2C device descriptor
  * @param temperature This value is required for temperature compensation
  * @param EC pointer to EC variable
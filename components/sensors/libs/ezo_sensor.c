@@ -0,0 +1,181 @@
+/*
+ * ezo_sensor.c
+ *
+ * Reading state machine shared by the Atlas EZO OEM circuits (EC and pH)
+ */
+
+#include "ezo_sensor.h"
+#include <esp_log.h>
+#include <math.h>
+#include <stdlib.h>
+
+static const char *TAG = "EZO Sensor";
+
+// Shared by every circuit, set once at boot
+static void (*interrupt_release)();
+
+// Register pointer write and read in one transaction with a repeated start
+static esp_err_t ezo_read_u8(i2c_dev_t *dev, uint8_t reg, uint8_t *value) {
+	I2C_DEV_TAKE_MUTEX(dev);
+	I2C_DEV_CHECK(dev, i2c_dev_read_reg(dev, reg, value, sizeof(*value)));
+	I2C_DEV_GIVE_MUTEX(dev);
+	return ESP_OK;
+}
+
+static esp_err_t ezo_write_u8(i2c_dev_t *dev, uint8_t reg, uint8_t value) {
+	I2C_DEV_TAKE_MUTEX(dev);
+	I2C_DEV_CHECK(dev, i2c_dev_write_reg(dev, reg, &value, sizeof(value)));
+	I2C_DEV_GIVE_MUTEX(dev);
+	return ESP_OK;
+}
+
+// Big endian value in four consecutive registers, the register pointer auto-increments so one burst covers all four
+static esp_err_t ezo_read_u32(i2c_dev_t *dev, uint8_t reg, uint32_t *value) {
+	uint8_t bytes[4];
+	I2C_DEV_TAKE_MUTEX(dev);
+	I2C_DEV_CHECK(dev, i2c_dev_read_reg(dev, reg, bytes, sizeof(bytes)));
+	I2C_DEV_GIVE_MUTEX(dev);
+	*value = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+	return ESP_OK;
+}
+
+static esp_err_t ezo_write_u32(i2c_dev_t *dev, uint8_t reg, uint32_t value) {
+	uint8_t bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+	I2C_DEV_TAKE_MUTEX(dev);
+	I2C_DEV_CHECK(dev, i2c_dev_write_reg(dev, reg, bytes, sizeof(bytes)));
+	I2C_DEV_GIVE_MUTEX(dev);
+	return ESP_OK;
+}
+
+static uint32_t ezo_read_fail(ezo_read_t *read, esp_err_t err) {
+	// Circuit may have been reset or missed a write
+	ezo_invalidate_compensation(read->compensation);
+	read->state = EZO_READ_FAILED;
+	read->err = err;
+	return 0;
+}
+
+// ms left until the deadline, at least one tick
+static uint32_t ezo_read_time_left(const ezo_read_t *read) {
+	int32_t ticks = (int32_t)(read->deadline - xTaskGetTickCount());
+	return ticks > 0 ? ticks * portTICK_PERIOD_MS : portTICK_PERIOD_MS;
+}
+
+// Start waiting for the first reading taken after the flag was cleared, the INT pin ends the wait early
+static uint32_t ezo_read_wait(ezo_read_t *read) {
+	read->state = EZO_READ_WAIT;
+	read->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(3 * read->regs->conversion_time);
+	return ezo_read_time_left(read);
+}
+
+// Sleep until notified or ticks pass, releasing the interrupt line if notified
+static void ezo_wait_notification(TickType_t ticks) {
+	if(ulTaskNotifyTake(pdTRUE, ticks) > 0 && interrupt_release != NULL) interrupt_release();
+}
+
+void ezo_set_interrupt_release(void (*release)()) {
+	interrupt_release = release;
+}
+
+esp_err_t ezo_enable_interrupt(i2c_dev_t *dev) {
+	return ezo_write_u8(dev, EZO_INTERRUPT_REG, EZO_INTERRUPT_INVERT);
+}
+
+void ezo_invalidate_compensation(ezo_compensation_t *compensation) {
+	compensation->is_valid = false;
+}
+
+uint32_t ezo_read_start(ezo_read_t *read, i2c_dev_t *dev, const ezo_registers_t *regs, ezo_compensation_t *compensation, float temperature) {
+	read->dev = dev;
+	read->regs = regs;
+	read->compensation = compensation;
+	read->attempts = 0;
+	read->task = xTaskGetCurrentTaskHandle();
+	read->err = ESP_OK;
+
+	// Readings taken before the request may predate the compensation
+	esp_err_t err = ezo_write_u8(dev, EZO_NEW_READING_REG, 0);
+	if(err != ESP_OK) return ezo_read_fail(read, err);
+
+	if(isnan(temperature)) return ezo_read_wait(read);
+
+	if(temperature <= EZO_TEMP_MIN || temperature >= EZO_TEMP_MAX) temperature = EZO_TEMP_DEFAULT;
+	read->temp_comp = (uint32_t)roundf(temperature * 100);
+
+	// Water temperature drifts slowly, most readings reuse the compensation already in place
+	if(compensation->is_valid && abs((int32_t)(read->temp_comp - compensation->temp_comp)) <= EZO_TEMP_COMP_TOLERANCE) return ezo_read_wait(read);
+
+	ezo_invalidate_compensation(compensation);
+	err = ezo_write_u32(dev, regs->temp_comp_reg, read->temp_comp);
+	if(err != ESP_OK) return ezo_read_fail(read, err);
+
+	read->state = EZO_READ_CONFIRM_TEMP;
+	return EZO_CONFIRM_PERIOD;
+}
+
+uint32_t ezo_read_step(ezo_read_t *read) {
+	esp_err_t err;
+
+	switch(read->state) {
+		case EZO_READ_CONFIRM_TEMP: {
+			uint32_t confirmed;
+			err = ezo_read_u32(read->dev, read->regs->temp_confirm_reg, &confirmed);
+			if(err != ESP_OK) return ezo_read_fail(read, err);
+			if(confirmed == read->temp_comp) {
+				read->compensation->is_valid = true;
+				read->compensation->temp_comp = confirmed;
+			} else {
+				if(++read->attempts < EZO_TEMP_CONFIRM_ATTEMPTS) return EZO_CONFIRM_PERIOD;
+				// Reading is still usable, just uncompensated
+				ESP_LOGE(TAG, "%s: unable to set temperature compensation point", read->regs->name);
+			}
+			// Notification may have been taken while confirming, check for a reading right away
+			ezo_read_wait(read);
+			return ezo_read_step(read);
+		}
+		case EZO_READ_WAIT: {
+			uint8_t new_reading;
+			err = ezo_read_u8(read->dev, EZO_NEW_READING_REG, &new_reading);
+			if(err != ESP_OK) return ezo_read_fail(read, err);
+			if(new_reading == 0) {
+				if((int32_t)(xTaskGetTickCount() - read->deadline) >= 0) {
+					ESP_LOGE(TAG, "%s: unable to get new reading", read->regs->name);
+					return ezo_read_fail(read, ESP_ERR_TIMEOUT);
+				}
+				// Woken by the other circuit sharing the interrupt line
+				return ezo_read_time_left(read);
+			}
+
+			uint32_t raw;
+			err = ezo_read_u32(read->dev, read->regs->reading_reg, &raw);
+			if(err == ESP_OK) err = ezo_write_u8(read->dev, EZO_NEW_READING_REG, 0);
+			if(err != ESP_OK) return ezo_read_fail(read, err);
+
+			read->value = (float)(int32_t)raw / read->regs->scale;
+			read->state = EZO_READ_DONE;
+			return 0;
+		}
+		default:
+			return 0;
+	}
+}
+
+esp_err_t ezo_read_result(const ezo_read_t *read, float *value) {
+	if(read->state == EZO_READ_FAILED) return read->err;
+	if(read->state != EZO_READ_DONE) return ESP_ERR_INVALID_STATE;
+	*value = read->value;
+	return ESP_OK;
+}
+
+esp_err_t ezo_read(i2c_dev_t *dev, const ezo_registers_t *regs, ezo_compensation_t *compensation, float temperature, float *value) {
+	ezo_read_t read;
+
+	// Drop notifications for readings taken before this request
+	ezo_wait_notification(0);
+
+	// Bus and mutex stay free while waiting, a notification ends the wait early
+	for(uint32_t delay = ezo_read_start(&read, dev, regs, compensation, temperature); delay > 0; delay = ezo_read_step(&read)) {
+		ezo_wait_notification(pdMS_TO_TICKS(delay));
+	}
+	return ezo_read_result(&read, value);
+}
@@ -0,0 +1,153 @@
+/*
+ * ezo_sensor.h
+ *
+ * Reading state machine shared by the Atlas EZO OEM circuits (EC and pH)
+ */
+
+#ifndef EZO_SENSOR_H
+#define EZO_SENSOR_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "i2cdev.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Registers shared by EZO OEM circuits */
+#define EZO_INTERRUPT_REG 0x04
+#define EZO_ACTIVE_REG 0x06
+#define EZO_NEW_READING_REG 0x07
+
+/* INT pin changes state on each new reading and needs no reset */
+#define EZO_INTERRUPT_INVERT 0x08
+
+/* Interval between checks of the temperature confirmation register in ms */
+#define EZO_CONFIRM_PERIOD 50
+
+/* Temperature confirmation register is read this many times before giving up on compensation */
+#define EZO_TEMP_CONFIRM_ATTEMPTS 3
+
+/* Temperatures outside this range are replaced by the default */
+#define EZO_TEMP_MIN 10.0f
+#define EZO_TEMP_MAX 35.0f
+#define EZO_TEMP_DEFAULT 25.0f
+
+/* Compensation within this many hundredths of a degree of the cached value is not rewritten, see Kconfig */
+#define EZO_TEMP_COMP_TOLERANCE CONFIG_EZO_TEMP_COMP_TOLERANCE
+
+/* Pass as temperature to read without writing compensation */
+#define EZO_NO_COMPENSATION NAN
+
+/**
+ * Register layout and timing of one EZO OEM circuit
+ */
+typedef struct {
+	const char *name;
+	uint8_t temp_comp_reg; // 4 byte temperature * 100
+	uint8_t temp_confirm_reg; // 4 byte temperature * 100 in use
+	uint8_t reading_reg; // 4 byte reading * scale
+	float scale;
+	uint16_t conversion_time; // ms between readings in active mode
+} ezo_registers_t;
+
+/**
+ * Last temperature compensation confirmed by a circuit
+ * Invalidate whenever the circuit may have lost it: hibernate, activate and calibration
+ */
+typedef struct {
+	bool is_valid;
+	uint32_t temp_comp; // temperature * 100
+} ezo_compensation_t;
+
+typedef enum {
+	EZO_READ_CONFIRM_TEMP = 0,
+	EZO_READ_WAIT,
+	EZO_READ_DONE,
+	EZO_READ_FAILED
+} ezo_read_state_t;
+
+/**
+ * One reading in progress, the device mutex is only held during each transaction
+ */
+typedef struct {
+	i2c_dev_t *dev;
+	const ezo_registers_t *regs;
+	ezo_compensation_t *compensation;
+	ezo_read_state_t state;
+	uint32_t temp_comp; // Compensation written, temperature * 100
+	uint8_t attempts;
+	TickType_t deadline; // Reading has failed if the new reading flag is still clear by then
+	TaskHandle_t task; // Task waiting for the reading, notified from the INT pin interrupt
+	float value;
+	esp_err_t err;
+} ezo_read_t;
+
+/**
+ * @brief Write temperature compensation unless cached and clear the new reading flag, returns without waiting
+ * @param read Reading state
+ * @param dev I2C device descriptor
+ * @param regs Register layout of the circuit
+ * @param compensation Compensation cache of the circuit
+ * @param temperature Water temperature, or EZO_NO_COMPENSATION
+ * @return ms until ezo_read_step should be called, 0 if the request failed
+ */
+uint32_t ezo_read_start(ezo_read_t *read, i2c_dev_t *dev, const ezo_registers_t *regs, ezo_compensation_t *compensation, float temperature);
+
+/**
+ * @brief Advance reading with a few short transactions, never sleeps
+ * While waiting for a new reading, call again when read->task is notified or the returned time has passed
+ * @param read Reading state
+ * @return ms until the next step, 0 once the reading is done or failed
+ */
+uint32_t ezo_read_step(ezo_read_t *read);
+
+/**
+ * @brief Get result of a finished reading
+ * @param read Reading state
+ * @param value Set to the reading on success
+ * @return ESP_OK, ESP_ERR_TIMEOUT if no new reading arrived, or the I2C error
+ */
+esp_err_t ezo_read_result(const ezo_read_t *read, float *value);
+
+/**
+ * @brief Take one reading, the calling task sleeps on its notification between steps
+ * The INT pin interrupt must notify the calling task, otherwise the reading is only picked up at the deadline
+ * @param dev I2C device descriptor
+ * @param regs Register layout of the circuit
+ * @param compensation Compensation cache of the circuit
+ * @param temperature Water temperature, or EZO_NO_COMPENSATION
+ * @param value Set to the reading on success
+ * @return any error message
+ */
+esp_err_t ezo_read(i2c_dev_t *dev, const ezo_registers_t *regs, ezo_compensation_t *compensation, float temperature, float *value);
+
+/**
+ * @brief Set INT pin to change state on each new reading
+ * @param dev I2C device descriptor
+ * @return any error message
+ */
+esp_err_t ezo_enable_interrupt(i2c_dev_t *dev);
+
+/**
+ * @brief Set function called by ezo_read whenever the INT pin interrupt woke it, e.g. to release a shared interrupt line
+ * @param release Called from the reading task, NULL for none
+ */
+void ezo_set_interrupt_release(void (*release)());
+
+/**
+ * @brief Forget cached compensation so the next reading writes and confirms it again
+ * @param compensation Compensation cache of the circuit
+ */
+void ezo_invalidate_compensation(ezo_compensation_t *compensation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EZO_SENSOR_H */
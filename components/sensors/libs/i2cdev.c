@@ -11,6 +11,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_idf_lib_helpers.h>
 #include "i2cdev.h"
 
@@ -24,9 +25,13 @@ typedef struct {
 
 static i2c_port_state_t states[I2C_NUM_MAX];
 
+// Counters only, a lost update under contention is acceptable
+static i2cdev_stats_t stats;
+
 #define SEMAPHORE_TAKE(port) do { \
         if (!xSemaphoreTake(states[port].lock, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS)) \
         { \
+            stats.timeouts++; \
             ESP_LOGE(TAG, "Could not take port mutex %d", port); \
             return ESP_ERR_TIMEOUT; \
         } \
@@ -40,6 +45,19 @@ static i2c_port_state_t states[I2C_NUM_MAX];
         } \
         } while (0)
 
+static void count_transaction(esp_err_t res, int64_t start)
+{
+    stats.transactions++;
+    stats.bus_time_us += esp_timer_get_time() - start;
+    if (res == ESP_ERR_TIMEOUT) stats.timeouts++;
+    else if (res != ESP_OK) stats.errors++;
+}
+
+void i2cdev_get_stats(i2cdev_stats_t *out)
+{
+    *out = stats;
+}
+
 esp_err_t i2cdev_init()
 {
     memset(states, 0, sizeof(states));
@@ -197,7 +215,9 @@ esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_si
         i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
         i2c_master_stop(cmd);
 
+        int64_t start = esp_timer_get_time();
         res = i2c_master_cmd_begin(dev->port, cmd, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS);
+        count_transaction(res, start);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not read from device [0x%02x at %d]: %d", dev->addr, dev->port, res);
 
@@ -230,7 +250,9 @@ esp_err_t i2c_dev_read_oem(const i2c_dev_t *dev, const void *out_data, size_t ou
         i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
         i2c_master_stop(cmd);
 
+        int64_t start = esp_timer_get_time();
         res = i2c_master_cmd_begin(dev->port, cmd, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS);
+        count_transaction(res, start);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not read from device [0x%02x at %d]: %d", dev->addr, dev->port, res);
 
@@ -259,7 +281,9 @@ esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_re
         i2c_master_write(cmd, (void *)out_data, out_size, true);
         i2c_master_stop(cmd);
 
+        int64_t start = esp_timer_get_time();
         res = i2c_master_cmd_begin(dev->port, cmd, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS);
+        count_transaction(res, start);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not (1) write to device [0x%02x at %d]: %d", dev->addr, dev->port, res);
         i2c_cmd_link_delete(cmd);
@@ -282,7 +306,9 @@ esp_err_t i2c_read_ezo_sensor(const i2c_dev_t *dev, uint8_t *response_code, void
     	i2c_master_read_byte(handle, response_code, I2C_MASTER_ACK);
     	i2c_master_read(handle, (uint8_t *)in_data, in_size, I2C_MASTER_LAST_NACK);
     	i2c_master_stop(handle);
+    	int64_t start = esp_timer_get_time();
     	res = i2c_master_cmd_begin(dev->port, handle, pdMS_TO_TICKS(500));
+    	count_transaction(res, start);
     	if (res != ESP_OK) {
     		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d \n", dev->addr, dev->port, res);
     	}
@@ -32,6 +32,14 @@ typedef struct
     SemaphoreHandle_t mutex; //!< Device mutex
 } i2c_dev_t;
 
+typedef struct
+{
+    uint32_t transactions; //!< Bus transactions started
+    uint32_t errors;       //!< Transactions that failed, e.g. no ACK
+    uint32_t timeouts;     //!< Bus or port mutex timeouts
+    uint64_t bus_time_us;  //!< Time spent executing transactions
+} i2cdev_stats_t;
+
 /**
  * @brief Init I2Cdev lib
  *
@@ -49,6 +57,8 @@ esp_err_t i2cdev_init();
  */
 esp_err_t i2cdev_done();
 
+void i2cdev_get_stats(i2cdev_stats_t *stats);
+
 /**
  * @brief Create mutex for device descriptor
  * @param[out] dev Device descriptor
@@ -180,6 +180,11 @@ esp_err_t mcp23x17_set_int_out_mode(mcp23x17_t *dev, mcp23x17_int_out_mode_t mod
     return write_reg_bit_8(dev, REG_IOCON, mode == MCP23X17_ACTIVE_HIGH, BIT_IOCON_INTPOL);
 }
 
+esp_err_t mcp23x17_set_int_mirror(mcp23x17_t *dev, bool enable)
+{
+    return write_reg_bit_8(dev, REG_IOCON, enable, BIT_IOCON_MIRROR);
+}
+
 esp_err_t mcp23x17_port_get_mode(mcp23x17_t *dev, uint16_t *val)
 {
     return read_reg_16(dev, REG_IODIRA, val);
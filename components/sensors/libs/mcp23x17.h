@@ -89,6 +89,14 @@ esp_err_t mcp23x17_get_int_out_mode(mcp23x17_t *dev, mcp23x17_int_out_mode_t *mo
  */
 esp_err_t mcp23x17_set_int_out_mode(mcp23x17_t *dev, mcp23x17_int_out_mode_t mode);
 
+/**
+ * Set INTA/INTB pins mirroring
+ * @param dev Pointer to device descriptor
+ * @param enable `true` to signal interrupts of both ports on each of INTA and INTB
+ * @return `ESP_OK` on success
+ */
+esp_err_t mcp23x17_set_int_mirror(mcp23x17_t *dev, bool enable);
+
 /**
  * @brief Get GPIO pins mode
  *
@@ -6,6 +6,7 @@
  */
 
 #include "ph_sensor.h"
+#include "ezo_sensor.h"
 #include <esp_log.h>
 #include <esp_err.h>
 #include <math.h>
@@ -26,6 +27,18 @@
 #define STABILIZATION_COUNT_MAX 10
 /* Debugging Tag for PH sensor */
 static const char *TAG = "Atlas PH Sensor";
+/* Register layout for the EZO reading state machine, readings are PH * 1000 */
+static const ezo_registers_t ph_registers = {
+	.name = "PH",
+	.temp_comp_reg = 0x0E,
+	.temp_confirm_reg = 0x12,
+	.reading_reg = 0x16,
+	.scale = 1000,
+	.conversion_time = 420
+};
+
+// Circuit resets compensation on hibernate and calibration, so those invalidate it
+static ezo_compensation_t ph_compensation;
 
 esp_err_t ph_init(ph_sensor_t *dev, i2c_port_t port, uint8_t addr, int8_t sda_gpio, int8_t scl_gpio) {
 	// Check Arguments
@@ -49,14 +62,14 @@ esp_err_t get_firmware_ph(ph_sensor_t *dev) {
     char data = 0x00; 
     char reg = 0x01; 
     I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &reg, sizeof(reg)));
-    I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &data, sizeof(data)));
+    I2C_DEV_CHECK(dev, i2c_dev_read_reg(dev, reg, &data, sizeof(data)));
     I2C_DEV_GIVE_MUTEX(dev);
     printf("PH Firmware Version: %d\n", data);
     return ESP_OK; 
 }
 
 esp_err_t activate_ph(ph_sensor_t *dev) {
+	ezo_invalidate_compensation(&ph_compensation);
 	// Write 0x01 to register 0x06 for activating ph sensor // 
 	char data = 0x01; 
 	char reg = 0x06; 
@@ -64,10 +77,11 @@ esp_err_t activate_ph(ph_sensor_t *dev) {
     I2C_DEV_CHECK(dev, i2c_dev_write(dev, &reg, sizeof(reg), &data, sizeof(data)));
     I2C_DEV_GIVE_MUTEX(dev);
 	vTaskDelay(pdMS_TO_TICKS(1000));
-	return ESP_OK; 
+	return ezo_enable_interrupt(dev);
 }
 
 esp_err_t hibernate_ph(ph_sensor_t *dev) {
+	ezo_invalidate_compensation(&ph_compensation);
 	//Write 0x00 to register 0x06 for placing ph sensor in hibernation mode // 
 	char data = 0x00; 
 	char reg = 0x06; 
@@ -170,6 +184,7 @@ esp_err_t calibrate_ph(ph_sensor_t *dev, float temperature){
 
 	//Calibration request Register//
 	char calib_req_reg = 0x0C; 
+	ezo_invalidate_compensation(&ph_compensation);
 	I2C_DEV_TAKE_MUTEX(dev);
     I2C_DEV_CHECK(dev, i2c_dev_write(dev, &calib_req_reg, sizeof(calib_req_reg), &calib_point, sizeof(calib_point)));
     I2C_DEV_GIVE_MUTEX(dev);
@@ -179,8 +194,7 @@ esp_err_t calibrate_ph(ph_sensor_t *dev, float temperature){
 	char calib_confirm_reg = 0x0D; 
 	char output = -1; 
 	I2C_DEV_TAKE_MUTEX(dev);
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &calib_confirm_reg, sizeof(calib_confirm_reg)));
-    I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &output, sizeof(output)));
+	I2C_DEV_CHECK(dev, i2c_dev_read_reg(dev, calib_confirm_reg, &output, sizeof(output)));
     I2C_DEV_GIVE_MUTEX(dev);
 
 	switch (calib_point) {
@@ -225,6 +239,7 @@ esp_err_t clear_calibration_ph(ph_sensor_t *dev) {
 	//Calibration request Register: Transmit 1 to clear old calibration settings//
 	char calib_req_reg = 0x0C; 
 	char calib_point = 1; 
+	ezo_invalidate_compensation(&ph_compensation);
 	I2C_DEV_TAKE_MUTEX(dev);
     I2C_DEV_CHECK(dev, i2c_dev_write(dev, &calib_req_reg, sizeof(calib_req_reg), &calib_point, sizeof(calib_point)));
     I2C_DEV_GIVE_MUTEX(dev);
@@ -234,8 +249,7 @@ esp_err_t clear_calibration_ph(ph_sensor_t *dev) {
 	char calib_confirm_reg = 0x0D; 
 	char output = -1; 
 	I2C_DEV_TAKE_MUTEX(dev);
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &calib_confirm_reg, sizeof(calib_confirm_reg)));
-    I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &output, sizeof(output)));
+	I2C_DEV_CHECK(dev, i2c_dev_read_reg(dev, calib_confirm_reg, &output, sizeof(output)));
     I2C_DEV_GIVE_MUTEX(dev);
 
 	// Make sure calibration confirmation register confirmed calibration clear setting// 
@@ -249,184 +263,10 @@ esp_err_t clear_calibration_ph(ph_sensor_t *dev) {
 }
 
 esp_err_t read_ph_with_temperature(ph_sensor_t *dev, float temperature, float *ph) {
-	//Check if temperature is in valid range
-	float temp = temperature;
-	if (temp <= 10.0 || temp >= 35.0) {
-		//Set to Default value//
-		temp = 25.0;
-	}
-	//Round float temp to 2 decimal places first//
-	float nearest = roundf(temp * 100) / 100;
-	unsigned int temp_compensation = (unsigned int) (nearest * 100); 
-	// Get each byte using bitwise operations for temperature value //
-	unsigned char msb = (temp_compensation>>24) & 0xFF;  
-	unsigned char high_byte = (temp_compensation>>16) & 0xFF; 
-	unsigned char low_byte = (temp_compensation>>8) & 0xFF; 
-	unsigned char lsb = temp_compensation & 0xFF; 
-	// Write each temperature byte to ph registers //
-	char msb_reg = 0x0E;
-	char high_reg = 0x0F; 
-	char low_reg = 0x10; 
-	char lsb_reg = 0x11; 
-	I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, i2c_dev_write(dev, &msb_reg, sizeof(msb_reg), &msb, sizeof(msb)));
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, &high_reg, sizeof(high_reg), &high_byte, sizeof(high_byte)));
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, &low_reg, sizeof(low_reg), &low_byte, sizeof(low_byte)));
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, &lsb_reg, sizeof(lsb_reg), &lsb, sizeof(lsb)));
-    I2C_DEV_GIVE_MUTEX(dev);
-    vTaskDelay(pdMS_TO_TICKS(1000));	// Processing Delay
-
-	//Temperature Compensation Confirmation// 
-	int count = 0; 
-	unsigned char bytes [4]; 
-	float check_temp = 0.0f; 
-	// Make sure temperature compensation is set //
-	while (check_temp != nearest) {
-		// if temp is not updated after 3 readings then return //
-		if (count == 3) {
-			ESP_LOGE(TAG, "Unable to set temperature compensation point.");
-			break; 
-		} 
-		// Get each byte from temperature confirmation register and place in bytes array// 
-		msb_reg = 0x12; 
-		high_reg = 0x13;
-		low_reg = 0x14;
-		lsb_reg = 0x15; 
-		I2C_DEV_TAKE_MUTEX(dev);
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &msb_reg, sizeof(msb_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &msb, sizeof(msb)));
-		bytes[0] = msb; 
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &high_reg, sizeof(high_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &high_byte, sizeof(high_byte)));
-		bytes[1] = high_byte; 
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &low_reg, sizeof(low_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &low_byte, sizeof(low_byte)));
-		bytes[2] = low_byte; 
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &lsb_reg, sizeof(lsb_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &lsb, sizeof(lsb)));
-		bytes[3] = lsb; 
-    	I2C_DEV_GIVE_MUTEX(dev);
-		// Use bitwise shifting to combine bytes into an int value and then cast to float to get true temp value// 
-		unsigned int check = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | (bytes[3]);
-		check_temp = ((float) check) / 100; 
-		count++;
-		vTaskDelay(pdMS_TO_TICKS(1000));
-	}
-
-	//ESP_LOGI(TAG, "Temp Point Set: %.2f", check_temp);
-
-	//Commands to check for new ph data//
-	char new_reading_reg = 0x07; 
-	char new_reading = 0; 
-	count = 0; 
-	// Keep checking unitl new ph data availible //
-	while (new_reading == 0) {
-		// If no data available after 3 checks then return // 
-		if (count == 5) {
-			ESP_LOGE(TAG, "Unable to get new ph reading.");
-			return ESP_FAIL; 
-		} 
-		// Read if new data available (will return 1 for new reading) //
-		I2C_DEV_TAKE_MUTEX(dev);
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &new_reading_reg, sizeof(new_reading_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &new_reading, sizeof(new_reading)));
-		I2C_DEV_GIVE_MUTEX(dev);
-		vTaskDelay(pdMS_TO_TICKS(1000));
-		if (new_reading == 1) {
-			//reset back to 0 for next use//
-			char reset = 0; 
-			I2C_DEV_TAKE_MUTEX(dev);
-    		I2C_DEV_CHECK(dev, i2c_dev_write(dev, &new_reading_reg, sizeof(new_reading_reg), &reset, sizeof(reset)));
-			I2C_DEV_GIVE_MUTEX(dev);
-			vTaskDelay(pdMS_TO_TICKS(1000));
-		}
-		count++; 
-	}
-
-	//get each byte of ph value from register// 
-	msb_reg = 0x16; 
-	high_reg = 0x17;
-	low_reg = 0x18;
-	lsb_reg = 0x19; 
-	I2C_DEV_TAKE_MUTEX(dev);
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &msb_reg, sizeof(msb_reg)));
-    I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &msb, sizeof(msb)));
-	bytes[0] = msb; 
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &high_reg, sizeof(high_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &high_byte, sizeof(high_byte)));
-	bytes[1] = high_byte; 
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &low_reg, sizeof(low_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &low_byte, sizeof(low_byte)));
-	bytes[2] = low_byte;  
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &lsb_reg, sizeof(lsb_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &lsb, sizeof(lsb)));
-	bytes[3] = lsb; 
-    I2C_DEV_GIVE_MUTEX(dev);
-	// Use bitwise shifting and casting to get ph value and place into ph paramter // 
-	int val = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | (bytes[3]);
-	*ph = ((float) val) / 1000; 
-	vTaskDelay(pdMS_TO_TICKS(1000));
-    return ESP_OK;
+	return ezo_read(dev, &ph_registers, &ph_compensation, temperature, ph);
 }
 
 esp_err_t read_ph(ph_sensor_t *dev, float *ph) {
-	//Commands to check for new ph data//
-	char new_reading_reg = 0x07; 
-	char new_reading = 0; 
-	int count = 0; 
-	// Keep checking unitl new ph data availible //
-	while (new_reading == 0) {
-		// If no data available after 3 checks then return // 
-		if (count == 5) {
-			ESP_LOGE(TAG, "Unable to get new ph reading.");
-			return ESP_FAIL; 
-		} 
-		// Read if new data available (will return 1 for new reading) //
-		I2C_DEV_TAKE_MUTEX(dev);
-		I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &new_reading_reg, sizeof(new_reading_reg)));
-    	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &new_reading, sizeof(new_reading)));
-		I2C_DEV_GIVE_MUTEX(dev);
-		vTaskDelay(pdMS_TO_TICKS(1000));
-		if (new_reading == 1) {
-			//reset back to 0 for next use//
-			char reset = 0; 
-			I2C_DEV_TAKE_MUTEX(dev);
-    		I2C_DEV_CHECK(dev, i2c_dev_write(dev, &new_reading_reg, sizeof(new_reading_reg), &reset, sizeof(reset)));
-			I2C_DEV_GIVE_MUTEX(dev);
-			vTaskDelay(pdMS_TO_TICKS(1000));
-		}
-		count++; 
-	}
-
-	//get each byte of ph value from register// 
-	unsigned char bytes[4];
-	unsigned char msb = 0x00;  
-	unsigned char high_byte = 0x00; 
-	unsigned char low_byte = 0x00; 
-	unsigned char lsb = 0x00; 
-	char msb_reg = 0x16; 
-	char high_reg = 0x17;
-	char low_reg = 0x18;
-	char lsb_reg = 0x19; 
-	I2C_DEV_TAKE_MUTEX(dev);
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &msb_reg, sizeof(msb_reg)));
-    I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &msb, sizeof(msb)));
-	bytes[0] = msb; 
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &high_reg, sizeof(high_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &high_byte, sizeof(high_byte)));
-	bytes[1] = high_byte; 
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &low_reg, sizeof(low_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &low_byte, sizeof(low_byte)));
-	bytes[2] = low_byte;  
-	I2C_DEV_CHECK(dev, i2c_dev_write(dev, NULL, 0, &lsb_reg, sizeof(lsb_reg)));
-	I2C_DEV_CHECK(dev, i2c_dev_read(dev, NULL, 0, &lsb, sizeof(lsb)));
-	bytes[3] = lsb; 
-    I2C_DEV_GIVE_MUTEX(dev);
-	// Use bitwise shifting and casting to get ph value and place into ph paramter // 
-	int val = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | (bytes[3]);
-	*ph = ((float) val) / 1000; 
-	vTaskDelay(pdMS_TO_TICKS(1000));
-
-    return ESP_OK;
+	return ezo_read(dev, &ph_registers, &ph_compensation, EZO_NO_COMPENSATION, ph);
 }
 
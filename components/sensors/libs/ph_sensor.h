@@ -59,7 +59,7 @@ esp_err_t calibrate_ph(ph_sensor_t *dev, float temperature);
 esp_err_t clear_calibration_ph(ph_sensor_t *dev);
 
 /**
- * @brief Read pH with temperature compensation
+ * @brief Read pH with temperature compensation, returns after the next conversion (~420 ms)
  * @param dev I2C device descriptor
  * @param temperature This value is required for temperature compensation
  * @param ph pointer to ph variable
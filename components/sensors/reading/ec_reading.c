@@ -3,6 +3,7 @@
 #include <esp_log.h>
 #include "string.h"
 #include "sync_sensors.h"
+#include "burst_stream.h"
 #include "task_priorities.h"
 #include "ports.h"
 #include "water_temp_reading.h"
@@ -28,6 +29,7 @@ void measure_ec(void *parameter) {				// EC Sensor Measurement Task
 	is_ec_activated = false;
 
 	ESP_ERROR_CHECK(activate_ec(&ec_dev));
+	set_gpio_interrupt_task(EC_INT_GPIO, xTaskGetCurrentTaskHandle()); // EZO INT pin signals new readings
 
 	is_ec_activated = true; 
 
@@ -57,12 +59,13 @@ void measure_ec(void *parameter) {				// EC Sensor Measurement Task
 				ESP_ERROR_CHECK(activate_ec(&ec_dev));
 				is_ec_activated = true;
 			}
-			read_ec_with_temperature(&ec_dev, sensor_get_value(get_water_temp_sensor()), sensor_get_address_value(&ec_sensor));
+			if(read_ec_with_temperature(&ec_dev, sensor_get_value(get_water_temp_sensor()), sensor_get_address_value(&ec_sensor)) == ESP_OK) sensor_record_value(&ec_sensor);
 			ESP_LOGI(TAG, "EC: %f", sensor_get_value(&ec_sensor));
+			burst_stream_add_reading(&ec_sensor);
 
 			// Sync with other sensor tasks
 			// Wait up to 10 seconds to let other tasks end
-			xEventGroupSync(sensor_event_group, EC_BIT, sensor_sync_bits, pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
+			xEventGroupSync(sensor_event_group, EC_BIT, sensor_sync_bits, burst_stream_get_sync_timeout(&ec_sensor));
 		}
 	}
 }
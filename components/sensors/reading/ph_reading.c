@@ -3,6 +3,7 @@
 #include <esp_log.h>
 #include <string.h>
 #include "sync_sensors.h"
+#include "burst_stream.h"
 #include "task_priorities.h"
 #include "ports.h"
 #include "water_temp_reading.h"
@@ -28,6 +29,7 @@ void measure_ph(void *parameter) {		// pH Sensor Measurement Task
 	is_ph_activated = false;
 
 	ESP_ERROR_CHECK(activate_ph(&ph_dev));
+	set_gpio_interrupt_task(PH_INT_GPIO, xTaskGetCurrentTaskHandle()); // EZO INT pin signals new readings
 
 	is_ph_activated = true;
 
@@ -48,10 +50,11 @@ void measure_ph(void *parameter) {		// pH Sensor Measurement Task
 				ESP_ERROR_CHECK(activate_ph(&ph_dev));
 				is_ph_activated = true;
 			}
-			read_ph_with_temperature(&ph_dev, sensor_get_value(get_water_temp_sensor()), sensor_get_address_value(&ph_sensor));
+			if(read_ph_with_temperature(&ph_dev, sensor_get_value(get_water_temp_sensor()), sensor_get_address_value(&ph_sensor)) == ESP_OK) sensor_record_value(&ph_sensor);
 			ESP_LOGI(TAG, "PH: %f", sensor_get_value(&ph_sensor));
+			burst_stream_add_reading(&ph_sensor);
 			// Sync with other sensor tasks and wait up to 10 seconds to let other tasks end
-			xEventGroupSync(sensor_event_group, PH_BIT, sensor_sync_bits, pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
+			xEventGroupSync(sensor_event_group, PH_BIT, sensor_sync_bits, burst_stream_get_sync_timeout(&ph_sensor));
 		}
 	}
 }
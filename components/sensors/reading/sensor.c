@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <esp_log.h>
 #include <esp_err.h>
 #include "sensor.h"
@@ -10,6 +11,7 @@ void init_sensor(struct sensor *sensor_in, char *name_in, bool active_in, bool c
 	sensor_in->current_value = 0;
 	sensor_in->is_active = active_in;
 	sensor_in->is_calib = calib_in;
+	sensor_history_init(&sensor_in->history);
 }
 
 TaskHandle_t* sensor_get_task_handle(struct sensor *sensor_in) { return &sensor_in->task_handle; }
@@ -18,6 +20,9 @@ float sensor_get_value(const struct sensor *sensor_in) { return sensor_in->curre
 float* sensor_get_address_value(struct sensor *sensor_in) {	return &sensor_in->current_value; }
 void sensor_set_value(struct sensor *sensor_in, float value) { sensor_in->current_value = value; }
 
+void sensor_record_value(struct sensor *sensor_in) { sensor_history_add(&sensor_in->history, sensor_in->current_value, time(NULL)); }
+void sensor_get_stats(const struct sensor *sensor_in, struct sensor_stats *stats) { sensor_history_get_stats(&sensor_in->history, stats); }
+
 bool sensor_get_active_status(struct sensor *sensor_in) { return sensor_in->is_active; }
 void sensor_set_active_status(struct sensor *sensor_in, bool status) { sensor_in->is_active = status; }
 
@@ -49,16 +54,9 @@ void calibrate_sensor(struct sensor *sensor_in, esp_err_t (*calib_func)(i2c_dev_
 	vTaskPrioritySet(&sensor_in->task_handle, task_priority);
 }
 
-void sensor_get_json(struct sensor *sensor_in, cJSON **obj) {
-	*obj = cJSON_CreateObject();
-	cJSON *name, *value;
-
-	name = cJSON_CreateString(sensor_in->name);
-
-	char value_str[8];
-	snprintf(value_str, sizeof(value_str), "%.2f", sensor_in->current_value);
-	value = cJSON_CreateString(value_str);
-
-	cJSON_AddItemToObject(*obj, "name", name);
-	cJSON_AddItemToObject(*obj, "value", value);
+void sensor_write_json(const struct sensor *sensor_in, struct json_writer *writer) {
+	json_writer_begin_object(writer, NULL);
+	json_writer_add_string(writer, "name", sensor_in->name);
+	json_writer_add_float_string(writer, "value", sensor_in->current_value, 2);
+	json_writer_end_object(writer);
 }
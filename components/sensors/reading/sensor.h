@@ -1,8 +1,9 @@
 #include <stdbool.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <cJSON.h>
 #include "i2cdev.h"
+#include "json_writer.h"
+#include "sensor_history.h"
 
 #ifndef COMPONENTS_SENSORS_READING_SENSOR_H_
 #define COMPONENTS_SENSORS_READING_SENSOR_H_
@@ -13,6 +14,7 @@ struct sensor {
 	float current_value;
 	bool is_active;
 	bool is_calib;
+	struct sensor_history history;
 };
 
 #endif
@@ -29,6 +31,12 @@ float sensor_get_value(const struct sensor *sensor_in);
 float* sensor_get_address_value(struct sensor *sensor_in);
 void sensor_set_value(struct sensor *sensor_in, float value);
 
+// Add current value to the history, only called from the sensor task
+void sensor_record_value(struct sensor *sensor_in);
+
+// Get statistics of recent values, safe from any task
+void sensor_get_stats(const struct sensor *sensor_in, struct sensor_stats *stats);
+
 // Get and set current active status
 bool sensor_get_active_status(struct sensor *sensor_in);
 void sensor_set_active_status(struct sensor *sensor_in, bool status);
@@ -40,5 +48,5 @@ void sensor_set_calib_status(struct sensor *sensor_in, bool status);
 // Calibrate sensor
 void calibrate_sensor(struct sensor *sensor_in, esp_err_t (*calib_func)(i2c_dev_t*), i2c_dev_t *dev);
 
-// Get JSON object of sensor dat
-void sensor_get_json(struct sensor *sensor_in, cJSON **obj);
+// Write sensor data as a JSON object into writer
+void sensor_write_json(const struct sensor *sensor_in, struct json_writer *writer);
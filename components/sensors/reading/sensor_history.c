@@ -0,0 +1,118 @@
+#include "sensor_history.h"
+
+#include <math.h>
+#include <string.h>
+
+// Candidate queues are rings of SENSOR_HISTORY_LENGTH slots starting at first
+static uint16_t queue_slot(const uint16_t *slots, uint16_t first, uint16_t i) {
+	return slots[(first + i) % SENSOR_HISTORY_LENGTH];
+}
+
+// Drop candidates the new sample supersedes, they leave the window before it
+static void queue_push(const struct sensor_history *history, uint16_t *slots, uint16_t first, uint16_t *count, uint16_t slot, bool is_min) {
+	float value = history->samples[slot].value;
+	while(*count > 0) {
+		float last = history->samples[queue_slot(slots, first, *count - 1)].value;
+		if(is_min ? last < value : last > value) break;
+		(*count)--;
+	}
+	slots[(first + *count) % SENSOR_HISTORY_LENGTH] = slot;
+	(*count)++;
+}
+
+// Drop oldest candidate if its slot is about to be overwritten
+static void queue_expire(const uint16_t *slots, uint16_t *first, uint16_t *count, uint16_t slot) {
+	if(*count == 0 || slots[*first] != slot) return;
+	*first = (*first + 1) % SENSOR_HISTORY_LENGTH;
+	(*count)--;
+}
+
+// Recompute mean and m2 from the samples so rounding errors of the sliding updates don't pile up
+static void resync_moments(struct sensor_history *history) {
+	double sum = 0;
+	for(uint16_t i = 0; i < history->count; ++i) sum += history->samples[i].value;
+	double mean = sum / history->count;
+
+	double m2 = 0;
+	for(uint16_t i = 0; i < history->count; ++i) {
+		double delta = history->samples[i].value - mean;
+		m2 += delta * delta;
+	}
+	history->mean = mean;
+	history->m2 = m2;
+}
+
+void sensor_history_init(struct sensor_history *history) {
+	memset(history, 0, sizeof(*history));
+}
+
+void sensor_history_add(struct sensor_history *history, float value, time_t time) {
+	// Failed readings would poison every statistic
+	if(!isfinite(value)) return;
+
+	uint16_t slot = history->head;
+	bool is_full = history->count == SENSOR_HISTORY_LENGTH;
+	double evicted = history->samples[slot].value;
+
+	// Readers retry while the sequence is odd or has changed
+	__atomic_store_n(&history->sequence, history->sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if(is_full) {
+		queue_expire(history->min_slots, &history->min_first, &history->min_count, slot);
+		queue_expire(history->max_slots, &history->max_first, &history->max_count, slot);
+	}
+	history->samples[slot].time = time;
+	history->samples[slot].value = value;
+	history->head = (slot + 1) % SENSOR_HISTORY_LENGTH;
+	queue_push(history, history->min_slots, history->min_first, &history->min_count, slot, true);
+	queue_push(history, history->max_slots, history->max_first, &history->max_count, slot, false);
+
+	if(!is_full) {
+		history->count++;
+		double delta = value - history->mean;
+		history->mean += delta / history->count;
+		history->m2 += delta * (value - history->mean);
+	} else if(history->head == 0) {
+		// Once per lap, keeps adds O(1) amortized
+		resync_moments(history);
+	} else {
+		// Sliding Welford update, the new sample replaces the evicted one
+		double prev_mean = history->mean;
+		history->mean += (value - evicted) / SENSOR_HISTORY_LENGTH;
+		history->m2 += (value - evicted) * (value - history->mean + evicted - prev_mean);
+		if(history->m2 < 0) history->m2 = 0;
+	}
+
+	struct sensor_stats *stats = &history->stats;
+	stats->count = history->count;
+	stats->min = history->samples[history->min_slots[history->min_first]].value;
+	stats->max = history->samples[history->max_slots[history->max_first]].value;
+	stats->mean = history->mean;
+	stats->variance = history->count > 1 ? history->m2 / (history->count - 1) : 0;
+	stats->latest = history->samples[slot];
+
+	__atomic_store_n(&history->sequence, history->sequence + 1, __ATOMIC_RELEASE);
+}
+
+void sensor_history_get_stats(const struct sensor_history *history, struct sensor_stats *stats) {
+	uint32_t sequence;
+	do {
+		sequence = __atomic_load_n(&history->sequence, __ATOMIC_ACQUIRE);
+		*stats = history->stats;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while((sequence & 1) || sequence != __atomic_load_n(&history->sequence, __ATOMIC_RELAXED));
+}
+
+uint16_t sensor_history_get_samples(const struct sensor_history *history, struct sensor_sample *samples, uint16_t max_samples) {
+	uint32_t sequence;
+	uint16_t count;
+	do {
+		sequence = __atomic_load_n(&history->sequence, __ATOMIC_ACQUIRE);
+		count = history->count < max_samples ? history->count : max_samples;
+		uint16_t first = (history->head + SENSOR_HISTORY_LENGTH - count) % SENSOR_HISTORY_LENGTH;
+		for(uint16_t i = 0; i < count; ++i) samples[i] = history->samples[(first + i) % SENSOR_HISTORY_LENGTH];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while((sequence & 1) || sequence != __atomic_load_n(&history->sequence, __ATOMIC_RELAXED));
+	return count;
+}
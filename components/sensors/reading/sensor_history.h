@@ -0,0 +1,63 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sdkconfig.h>
+
+// Samples kept per sensor, see Kconfig
+#define SENSOR_HISTORY_LENGTH CONFIG_SENSOR_HISTORY_LENGTH
+
+// One reading and when it was taken
+struct sensor_sample {
+	time_t time;
+	float value;
+};
+
+// Statistics over the samples currently in the history
+struct sensor_stats {
+	uint16_t count;
+	float min;
+	float max;
+	float mean;
+	float variance; // Sample variance, 0 with fewer than 2 samples
+	struct sensor_sample latest;
+};
+
+// Ring of the last SENSOR_HISTORY_LENGTH samples with running statistics
+// Written only by the task that owns the sensor, read from any task through the snapshot functions
+struct sensor_history {
+	struct sensor_sample samples[SENSOR_HISTORY_LENGTH];
+	uint16_t head; // Next slot written
+	uint16_t count;
+
+	// Welford mean and sum of squared deviations over the window
+	double mean;
+	double m2;
+
+	// Ring slots of the min and max candidates, oldest first, values increasing and decreasing respectively
+	uint16_t min_slots[SENSOR_HISTORY_LENGTH];
+	uint16_t max_slots[SENSOR_HISTORY_LENGTH];
+	uint16_t min_first, min_count;
+	uint16_t max_first, max_count;
+
+	struct sensor_stats stats;
+	uint32_t sequence; // Odd while the writer updates samples and stats
+};
+
+// Clear samples and statistics, not safe while other tasks read
+void sensor_history_init(struct sensor_history *history);
+
+// Add sample, dropping the oldest once full, O(1) amortized
+// Only called from the task that owns the sensor
+void sensor_history_add(struct sensor_history *history, float value, time_t time);
+
+// Copy statistics without blocking the writer
+void sensor_history_get_stats(const struct sensor_history *history, struct sensor_stats *stats);
+
+// Copy up to max_samples most recent samples, oldest first, without blocking the writer
+// Returns number of samples copied
+uint16_t sensor_history_get_samples(const struct sensor_history *history, struct sensor_sample *samples, uint16_t max_samples);
+
+#endif
@@ -10,6 +10,7 @@
 #include "ph_reading.h"
 #include "water_temp_reading.h"
 #include "sensor.h"
+#include "telemetry_batch.h"
 
 void set_sensor_sync_bits() {
 	sensor_sync_bits = DELAY_BIT | EC_BIT | PH_BIT | (sensor_get_active_status(get_water_temp_sensor()) ? WATER_TEMPERATURE_BIT : 0);
@@ -25,6 +26,9 @@ void sync_task(void *parameter) {				// Sensor Synchronization Task
 		// Check Whether all tasks were completed on time
 		if ((returnBits & sensor_sync_bits) == sensor_sync_bits) {
 			ESP_LOGI(TAG, "Completed");
+
+			// Buffer this round of readings for batched publishing
+			telemetry_batch_add_sample();
 		} else {
 			ESP_LOGE(TAG, "Failed to Complete On Time");
 		}
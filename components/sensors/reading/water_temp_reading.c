@@ -5,6 +5,7 @@
 
 #include "ds18x20.h"
 #include "sync_sensors.h"
+#include "burst_stream.h"
 #include "ports.h"
 #include "ph_reading.h"
 
@@ -37,6 +38,8 @@ void measure_water_temperature(void *parameter) {		// Water Temperature Measurem
 		// Error Management
 		if (error == ESP_OK) {
 			ESP_LOGI(TAG, "temperature: %f\n", sensor_get_value(&water_temp_sensor));
+			sensor_record_value(&water_temp_sensor);
+			burst_stream_add_reading(&water_temp_sensor);
 		} else if (error == ESP_ERR_INVALID_RESPONSE) {
 			ESP_LOGE(TAG, "Temperature Sensor Not Connected\n");
 		} else if (error == ESP_ERR_INVALID_CRC) {
@@ -48,7 +51,7 @@ void measure_water_temperature(void *parameter) {		// Water Temperature Measurem
 		// Sync with other sensor tasks
 		// Wait up to 10 seconds to let other tasks end
 		if (!sensor_calib_status(get_ph_sensor())) {
-                xEventGroupSync(sensor_event_group, WATER_TEMPERATURE_BIT, sensor_sync_bits, pdMS_TO_TICKS(SENSOR_MEASUREMENT_PERIOD));
+                xEventGroupSync(sensor_event_group, WATER_TEMPERATURE_BIT, sensor_sync_bits, burst_stream_get_sync_timeout(&water_temp_sensor));
         } else {
 			//If ph calibration on, get frequent water temp readings// 
             vTaskDelay(pdMS_TO_TICKS(2000));
@@ -0,0 +1,28 @@
+// Count heap calls by wrapping the glibc allocator, not usable together with sanitizers
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+size_t host_alloc_count;
+
+void *malloc(size_t size) {
+	host_alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	host_alloc_count++;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	host_alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+	__libc_free(ptr);
+}
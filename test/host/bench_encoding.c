@@ -0,0 +1,174 @@
+// Payload size and encode time of the JSON and CBOR encodings of live_data and equipment_status
+#include <string.h>
+#include <time.h>
+
+#include "host_test.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+
+#define ITERATIONS 200000
+#define NUM_SENSORS 3
+#define NUM_OUTLETS 15
+#define NUM_CONTROLS 3
+
+static const char *names[NUM_SENSORS] = { "water_temp", "ec", "ph" };
+static const float values[NUM_SENSORS] = { 21.37f, 1.84f, 6.02f };
+static const struct tm sample_time = { .tm_year = 126, .tm_mon = 9, .tm_mday = 16, .tm_hour = 8, .tm_min = 5, .tm_sec = 9 };
+static const uint32_t sample_unix_time = 1792137909;
+
+static const char *control_keys[NUM_CONTROLS] = { "water_temp_control", "ec_control", "ph_control" };
+static uint8_t rf[NUM_OUTLETS];
+static const uint8_t control[NUM_CONTROLS] = { 1, 0, 2 };
+
+static const uint8_t expected_live_cbor[] = "\xa2\x61\x74\x1a\x6a\xd1\xda\xb5\x61\x73\xa3\x00\xfa\x41\xaa\xf5\xc3"
+		"\x01\xfa\x3f\xeb\x85\x1f\x02\xfa\x40\xc0\xa3\xd7";
+
+// Snapshot and delta both key rf statuses by outlet
+static const uint8_t expected_snapshot_cbor[] = "\xa2\x62\x72\x66\xaf\x00\x00\x01\x01\x02\x00\x03\x01\x04\x00\x05\x01"
+		"\x06\x00\x07\x01\x08\x00\x09\x01\x0a\x00\x0b\x01\x0c\x00\x0d\x01\x0e\x00"
+		"\x67\x63\x6f\x6e\x74\x72\x6f\x6c\xa3\x00\x01\x01\x00\x02\x02";
+static const uint8_t expected_delta_cbor[] = "\xa1\x62\x72\x66\xa1\x03\x01";
+
+// Same sequences as create_sensor_data_payload in mqtt_manager.c
+static size_t live_json(char *buffer, size_t size) {
+	struct json_writer writer;
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_time(&writer, "time", &sample_time);
+	json_writer_begin_array(&writer, "sensors");
+	for(int i = 0; i < NUM_SENSORS; ++i) {
+		json_writer_begin_object(&writer, NULL);
+		json_writer_add_string(&writer, "name", names[i]);
+		json_writer_add_float_string(&writer, "value", values[i], 2);
+		json_writer_end_object(&writer);
+	}
+	json_writer_end_array(&writer);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+static size_t live_cbor(char *buffer, size_t size) {
+	struct cbor_writer writer;
+
+	cbor_writer_init(&writer, (uint8_t*)buffer, size);
+	cbor_writer_begin_map(&writer, 2);
+	cbor_writer_add_string(&writer, "t");
+	cbor_writer_add_uint(&writer, sample_unix_time);
+	cbor_writer_add_string(&writer, "s");
+	cbor_writer_begin_map(&writer, NUM_SENSORS);
+	for(int i = 0; i < NUM_SENSORS; ++i) {
+		cbor_writer_add_uint(&writer, i);
+		cbor_writer_add_float(&writer, values[i]);
+	}
+
+	if(cbor_writer_finish(&writer) == NULL) return 0;
+	return cbor_writer_length(&writer);
+}
+
+// Same sequences as create_equipment_status_payload in equipment_status.c
+static size_t status_json(char *buffer, size_t size, uint32_t rf_mask, uint8_t control_mask) {
+	struct json_writer writer;
+	char key[4];
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	if(rf_mask != 0) {
+		json_writer_begin_object(&writer, "rf");
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+			if(!(rf_mask & (1 << i))) continue;
+			key[json_format_uint(key, i, 1)] = '\0';
+			json_writer_add_int(&writer, key, rf[i]);
+		}
+		json_writer_end_object(&writer);
+	}
+	if(control_mask != 0) {
+		json_writer_begin_object(&writer, "control");
+		for(uint8_t i = 0; i < NUM_CONTROLS; ++i) {
+			if(control_mask & (1 << i)) json_writer_add_int(&writer, control_keys[i], control[i]);
+		}
+		json_writer_end_object(&writer);
+	}
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+static size_t status_cbor(char *buffer, size_t size, uint32_t rf_mask, uint8_t control_mask) {
+	struct cbor_writer writer;
+
+	cbor_writer_init(&writer, (uint8_t*)buffer, size);
+	cbor_writer_begin_map(&writer, (rf_mask != 0) + (control_mask != 0));
+	if(rf_mask != 0) {
+		cbor_writer_add_string(&writer, "rf");
+		cbor_writer_begin_map(&writer, __builtin_popcount(rf_mask));
+		for(uint8_t i = 0; i < NUM_OUTLETS; ++i) {
+			if(!(rf_mask & (1 << i))) continue;
+			cbor_writer_add_uint(&writer, i);
+			cbor_writer_add_int(&writer, rf[i]);
+		}
+	}
+	if(control_mask != 0) {
+		cbor_writer_add_string(&writer, "control");
+		cbor_writer_begin_map(&writer, __builtin_popcount(control_mask));
+		for(uint8_t i = 0; i < NUM_CONTROLS; ++i) {
+			if(!(control_mask & (1 << i))) continue;
+			cbor_writer_add_uint(&writer, i);
+			cbor_writer_add_int(&writer, control[i]);
+		}
+	}
+
+	if(cbor_writer_finish(&writer) == NULL) return 0;
+	return cbor_writer_length(&writer);
+}
+
+static char buffer[512];
+
+static size_t snapshot_json() { return status_json(buffer, sizeof(buffer), (1 << NUM_OUTLETS) - 1, (1 << NUM_CONTROLS) - 1); }
+static size_t snapshot_cbor() { return status_cbor(buffer, sizeof(buffer), (1 << NUM_OUTLETS) - 1, (1 << NUM_CONTROLS) - 1); }
+static size_t delta_json() { return status_json(buffer, sizeof(buffer), 1 << 3, 0); }
+static size_t delta_cbor() { return status_cbor(buffer, sizeof(buffer), 1 << 3, 0); }
+static size_t live_json_payload() { return live_json(buffer, sizeof(buffer)); }
+static size_t live_cbor_payload() { return live_cbor(buffer, sizeof(buffer)); }
+
+static void measure(const char *name, size_t (*encode)()) {
+	size_t length = 0;
+	uint64_t ns = host_time_ns();
+	for(int i = 0; i < ITERATIONS; ++i) {
+		length = encode();
+		__asm__ volatile("" : : "r"(buffer) : "memory");
+	}
+	ns = host_time_ns() - ns;
+	HOST_CHECK(length > 0);
+	printf("%-24s %4zu bytes  %6.1f ns per payload\n", name, length, (double)ns / ITERATIONS);
+}
+
+int main() {
+	for(int i = 0; i < NUM_OUTLETS; ++i) rf[i] = i % 2;
+
+	HOST_CHECK(live_cbor_payload() == sizeof(expected_live_cbor) - 1);
+	HOST_CHECK(memcmp(buffer, expected_live_cbor, sizeof(expected_live_cbor) - 1) == 0);
+	HOST_CHECK(snapshot_cbor() == sizeof(expected_snapshot_cbor) - 1);
+	HOST_CHECK(memcmp(buffer, expected_snapshot_cbor, sizeof(expected_snapshot_cbor) - 1) == 0);
+	HOST_CHECK(delta_cbor() == sizeof(expected_delta_cbor) - 1);
+	HOST_CHECK(memcmp(buffer, expected_delta_cbor, sizeof(expected_delta_cbor) - 1) == 0);
+
+	// A buffer one byte short must fail instead of truncating
+	HOST_CHECK(live_cbor(buffer, sizeof(expected_live_cbor) - 2) == 0);
+	HOST_CHECK(status_cbor(buffer, sizeof(expected_snapshot_cbor) - 2, (1 << NUM_OUTLETS) - 1, (1 << NUM_CONTROLS) - 1) == 0);
+
+	HOST_CHECK(delta_json() == strlen("{\"rf\":{\"3\":1}}"));
+	HOST_CHECK(strcmp(buffer, "{\"rf\":{\"3\":1}}") == 0);
+
+	measure("live_data json", live_json_payload);
+	measure("live_data cbor", live_cbor_payload);
+	measure("status snapshot json", snapshot_json);
+	measure("status snapshot cbor", snapshot_cbor);
+	measure("status delta json", delta_json);
+	measure("status delta cbor", delta_cbor);
+
+	return host_test_finish("bench_encoding");
+}
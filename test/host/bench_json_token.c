@@ -0,0 +1,53 @@
+// Settings document tokenizing: time per document and heap use, which must be none
+#include <string.h>
+
+#include "host_test.h"
+#include "json_token.h"
+
+#define MAX_TOKENS 64
+#define ITERATIONS 200000
+
+static const char *settings = "{\"req_id\":42,\"ph\":{\"monitoring_only\":false,\"control\":{\"dosing_time\":10,"
+		"\"dosing_interval\":60,\"target_value\":6.2,\"pumps\":{\"pump_1\":1,\"pump_2\":0.5}}},"
+		"\"ec\":{\"control\":{\"dosing_time\":10,\"dosing_interval\":60,\"target_value\":1.8}},"
+		"\"grow_lights\":{\"lights_on\":\"2026-10-16T08:05:09Z\",\"lights_off\":\"2026-10-16T20:05:09Z\"},"
+		"\"telemetry\":{\"batch_size\":10,\"batch_interval\":300}}";
+
+// Visit every section value the way parse_device_settings does
+static int walk(const char *json, const struct json_token *tokens, int num_tokens) {
+	int visited = 0;
+	int key = 1;
+	for(uint16_t i = 0; i < tokens[0].size; ++i, key = json_object_next(tokens, num_tokens, key)) {
+		if(tokens[key + 1].type == JSON_OBJECT) visited++;
+	}
+	return visited + (json_object_get(json, tokens, num_tokens, 0, "telemetry") > 0);
+}
+
+int main() {
+	struct json_token tokens[MAX_TOKENS];
+	size_t len = strlen(settings);
+
+	int num_tokens = json_tokenize(settings, len, tokens, MAX_TOKENS);
+	HOST_CHECK(num_tokens > 0);
+	HOST_CHECK(walk(settings, tokens, num_tokens) == 5);
+
+	size_t allocs = host_alloc_count;
+	uint64_t ns = host_time_ns();
+	uint64_t cycles = host_cycles();
+	int visited = 0;
+	for(int i = 0; i < ITERATIONS; ++i) {
+		num_tokens = json_tokenize(settings, len, tokens, MAX_TOKENS);
+		visited += walk(settings, tokens, num_tokens);
+		__asm__ volatile("" : : "r"(tokens) : "memory");
+	}
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	allocs = host_alloc_count - allocs;
+
+	HOST_CHECK(visited == 5 * ITERATIONS);
+	HOST_CHECK(allocs == 0);
+	printf("%zu bytes, %d tokens: %zu allocs  %.1f ns  %.0f cycles per document\n", len, num_tokens,
+			allocs, (double)ns / ITERATIONS, (double)cycles / ITERATIONS);
+
+	return host_test_finish("bench_json_token");
+}
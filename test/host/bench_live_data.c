@@ -0,0 +1,129 @@
+// live_data serialization: json_writer into a reused buffer against the cJSON tree it replaced
+#include <string.h>
+#include <time.h>
+
+#include "host_test.h"
+#include "json_writer.h"
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define ITERATIONS 200000
+
+static const char *names[] = { "water_temp", "ec", "ph" };
+static const float values[] = { 21.37f, 1.84f, 6.02f };
+static const struct tm sample_time = { .tm_year = 126, .tm_mon = 9, .tm_mday = 16, .tm_hour = 8, .tm_min = 5, .tm_sec = 9 };
+
+static const char *expected = "{\"time\":\"2026-10-16T08:05:09Z\",\"sensors\":["
+		"{\"name\":\"water_temp\",\"value\":\"21.37\"},"
+		"{\"name\":\"ec\",\"value\":\"1.84\"},"
+		"{\"name\":\"ph\",\"value\":\"6.02\"}]}";
+
+// Same sequence as create_sensor_data_payload in mqtt_manager.c
+static size_t writer_payload(char *buffer, size_t size) {
+	struct json_writer writer;
+
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	json_writer_add_time(&writer, "time", &sample_time);
+	json_writer_begin_array(&writer, "sensors");
+	for(int i = 0; i < 3; ++i) {
+		json_writer_begin_object(&writer, NULL);
+		json_writer_add_string(&writer, "name", names[i]);
+		json_writer_add_float_string(&writer, "value", values[i], 2);
+		json_writer_end_object(&writer);
+	}
+	json_writer_end_array(&writer);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+#ifdef HAVE_CJSON
+// publish_sensor_data before the writer: create_time_json, sensor_get_json and cJSON_PrintUnformatted
+static char* cjson_payload() {
+	char time_str[21];
+	char value_str[8];
+	cJSON *root = cJSON_CreateObject();
+	cJSON *sensor_arr = cJSON_CreateArray();
+
+	sprintf(time_str, "%.4d", sample_time.tm_year + 1900);
+	strcat(time_str, "-");
+	sprintf(time_str + 5, "%.2d", sample_time.tm_mon + 1);
+	strcat(time_str, "-");
+	sprintf(time_str + 8, "%.2d", sample_time.tm_mday);
+	strcat(time_str, "T");
+	sprintf(time_str + 11, "%.2d", sample_time.tm_hour);
+	strcat(time_str, ":");
+	sprintf(time_str + 14, "%.2d", sample_time.tm_min);
+	strcat(time_str, ":");
+	sprintf(time_str + 17, "%.2d", sample_time.tm_sec);
+	strcat(time_str, "Z");
+	cJSON_AddItemToObject(root, "time", cJSON_CreateString(time_str));
+
+	for(int i = 0; i < 3; ++i) {
+		cJSON *sensor = cJSON_CreateObject();
+		snprintf(value_str, sizeof(value_str), "%.2f", values[i]);
+		cJSON_AddItemToObject(sensor, "name", cJSON_CreateString(names[i]));
+		cJSON_AddItemToObject(sensor, "value", cJSON_CreateString(value_str));
+		cJSON_AddItemToArray(sensor_arr, sensor);
+	}
+	cJSON_AddItemToObject(root, "sensors", sensor_arr);
+
+	char *data = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	return data;
+}
+#endif
+
+static void report(const char *path, size_t bytes, size_t allocs, uint64_t ns, uint64_t cycles) {
+	printf("%-12s %4zu bytes  %5.1f allocs  %7.1f ns  %8.0f cycles per payload\n", path, bytes,
+			(double)allocs / ITERATIONS, (double)ns / ITERATIONS, (double)cycles / ITERATIONS);
+}
+
+int main() {
+	static char buffer[512];
+	size_t length = writer_payload(buffer, sizeof(buffer));
+	HOST_CHECK(length == strlen(expected));
+	HOST_CHECK(strcmp(buffer, expected) == 0);
+
+	// A buffer one byte short must fail instead of truncating
+	HOST_CHECK(writer_payload(buffer, strlen(expected)) == 0);
+
+	size_t allocs = host_alloc_count;
+	uint64_t ns = host_time_ns();
+	uint64_t cycles = host_cycles();
+	for(int i = 0; i < ITERATIONS; ++i) {
+		length = writer_payload(buffer, sizeof(buffer));
+		__asm__ volatile("" : : "r"(buffer) : "memory");
+	}
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	allocs = host_alloc_count - allocs;
+	HOST_CHECK(allocs == 0);
+	report("json_writer", length, allocs, ns, cycles);
+
+#ifdef HAVE_CJSON
+	char *data = cjson_payload();
+	HOST_CHECK(strcmp(data, expected) == 0);
+	free(data);
+
+	allocs = host_alloc_count;
+	ns = host_time_ns();
+	cycles = host_cycles();
+	for(int i = 0; i < ITERATIONS; ++i) {
+		data = cjson_payload();
+		length = strlen(data);
+		free(data);
+	}
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	allocs = host_alloc_count - allocs;
+	report("cJSON", length, allocs, ns, cycles);
+#else
+	printf("cJSON           not measured, set IDF_PATH to an ESP-IDF checkout to compare\n");
+#endif
+
+	return host_test_finish("bench_live_data");
+}
@@ -0,0 +1,152 @@
+// LZSS on telemetry batch and spool payloads: round trip, ratio and throughput, plus every output size that overflows
+#include <string.h>
+#include <sdkconfig.h>
+
+#include "host_test.h"
+#include "json_writer.h"
+#include "lzss_encoder.h"
+
+#ifndef RUNS
+#define RUNS 2000
+#endif
+
+#define BATCH_SAMPLES 30 // TELEMETRY_BATCH_MAX_SAMPLES
+#define SPOOL_SAMPLES 10 // TELEMETRY_SPOOL_DRAIN_CHUNK
+#define PAYLOAD_SIZE 1280 // TELEMETRY_BATCH_PAYLOAD_SIZE
+#define SAMPLE_PERIOD 10
+
+static const char *names[] = { "water_temp", "ec", "ph" };
+static const struct tm base_time = { .tm_year = 126, .tm_mon = 9, .tm_mday = 16, .tm_hour = 12 };
+
+static uint32_t rng_state;
+
+static uint32_t rng() {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// Slowly drifting readings, same layout as telemetry_batch_serialize and telemetry_spool_serialize
+static size_t make_trace(char *buffer, size_t size, int num_samples, bool is_spool, uint32_t seed) {
+	struct json_writer writer;
+	float values[] = { 21.4f, 1.82f, 6.02f };
+	const float steps[] = { 0.01f, 0.01f, 0.01f };
+
+	rng_state = seed;
+	json_writer_init(&writer, buffer, size);
+	json_writer_begin_object(&writer, NULL);
+	if(is_spool) json_writer_add_uint(&writer, "seq", seed * SPOOL_SAMPLES);
+	json_writer_add_time(&writer, "time", &base_time);
+	json_writer_begin_array(&writer, "sensors");
+	for(int i = 0; i < 3; ++i) json_writer_add_string(&writer, NULL, names[i]);
+	json_writer_end_array(&writer);
+
+	json_writer_begin_array(&writer, "samples");
+	for(int i = 0; i < num_samples; ++i) {
+		json_writer_begin_array(&writer, NULL);
+		json_writer_add_uint(&writer, NULL, i * SAMPLE_PERIOD);
+		for(int j = 0; j < 3; ++j) {
+			values[j] += ((int)(rng() % 5) - 2) * steps[j];
+			json_writer_add_float(&writer, NULL, values[j], 2);
+		}
+		json_writer_end_array(&writer);
+	}
+	json_writer_end_array(&writer);
+	json_writer_add_uint(&writer, is_spool ? "lost" : "dropped", 0);
+	json_writer_end_object(&writer);
+
+	if(json_writer_finish(&writer) == NULL) return 0;
+	return json_writer_length(&writer);
+}
+
+static uint32_t get_bits(const uint8_t *in, size_t *bit, uint8_t count) {
+	uint32_t value = 0;
+	for(uint8_t i = 0; i < count; ++i, ++*bit) value = (value << 1) | ((in[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+	return value;
+}
+
+// Reference decoder with heatshrink semantics, returns decoded length or 0 on a malformed stream
+static size_t decode(const uint8_t *in, size_t len, uint8_t *out, size_t size) {
+	if(len < LZSS_HEADER_SIZE || in[0] != LZSS_MAGIC_0 || in[1] != LZSS_MAGIC_1) return 0;
+	uint8_t window_bits = in[2] >> 4;
+	uint8_t lookahead_bits = in[2] & 0x0F;
+	size_t out_len = (in[3] << 8) | in[4];
+	size_t bit = LZSS_HEADER_SIZE * 8;
+	size_t pos = 0;
+
+	if(out_len > size) return 0;
+	while(pos < out_len) {
+		if(bit + 9 > len * 8) return 0;
+		if(get_bits(in, &bit, 1)) {
+			out[pos++] = get_bits(in, &bit, 8);
+			continue;
+		}
+		if(bit + window_bits + lookahead_bits > len * 8) return 0;
+		size_t distance = get_bits(in, &bit, window_bits) + 1;
+		size_t length = get_bits(in, &bit, lookahead_bits) + 1;
+		if(distance > pos || pos + length > out_len) return 0;
+		for(size_t i = 0; i < length; ++i, ++pos) out[pos] = out[pos - distance];
+	}
+	return pos;
+}
+
+static void measure(const char *name, int num_samples, bool is_spool, uint8_t window_bits, uint8_t lookahead_bits) {
+	static char in[PAYLOAD_SIZE];
+	static uint8_t out[PAYLOAD_SIZE];
+	static uint8_t decoded[PAYLOAD_SIZE];
+	size_t total_in = 0, total_out = 0;
+	uint64_t ns = 0;
+
+	for(int run = 0; run < RUNS; ++run) {
+		size_t len = make_trace(in, sizeof(in), num_samples, is_spool, run + 1);
+		HOST_CHECK(len > 0);
+
+		uint64_t start = host_time_ns();
+		size_t compressed_len = lzss_compress((const uint8_t*)in, len, out, sizeof(out), window_bits, lookahead_bits);
+		ns += host_time_ns() - start;
+
+		// Sensor traces always compress
+		HOST_CHECK(compressed_len > 0 && compressed_len < len);
+		HOST_CHECK(decode(out, compressed_len, decoded, sizeof(decoded)) == len && memcmp(decoded, in, len) == 0);
+		total_in += len;
+		total_out += compressed_len;
+	}
+	printf("%-6s W=%-2d L=%d  %4zu -> %4zu bytes  ratio %.2f  %6.1f us  %5.1f MB/s\n", name, window_bits, lookahead_bits,
+			total_in / RUNS, total_out / RUNS, (double)total_in / total_out, (double)ns / RUNS / 1000, total_in * 1000.0 / ns);
+}
+
+// Every output size short of the compressed length must fail cleanly without writing past out_size
+static void check_overflow() {
+	static char in[PAYLOAD_SIZE];
+	static uint8_t out[PAYLOAD_SIZE + 1];
+	size_t len = make_trace(in, sizeof(in), BATCH_SAMPLES, false, 7);
+	size_t compressed_len = lzss_compress((const uint8_t*)in, len, out, sizeof(out) - 1, 8, 4);
+	HOST_CHECK(compressed_len > 0);
+
+	for(size_t size = 0; size < compressed_len; ++size) {
+		memset(out, 0xA5, sizeof(out));
+		HOST_CHECK(lzss_compress((const uint8_t*)in, len, out, size, 8, 4) == 0);
+		HOST_CHECK(out[size] == 0xA5);
+	}
+	HOST_CHECK(lzss_compress((const uint8_t*)in, len, out, compressed_len, 8, 4) == compressed_len);
+
+	// Incompressible input is refused
+	for(size_t i = 0; i < 256; ++i) in[i] = rng();
+	HOST_CHECK(lzss_compress((const uint8_t*)in, 256, out, sizeof(out) - 1, 8, 4) == 0);
+}
+
+int main() {
+	check_overflow();
+
+	measure("batch", BATCH_SAMPLES, false, CONFIG_TELEMETRY_COMPRESSION_WINDOW_BITS, CONFIG_TELEMETRY_COMPRESSION_LOOKAHEAD_BITS);
+	measure("spool", SPOOL_SAMPLES, true, CONFIG_TELEMETRY_COMPRESSION_WINDOW_BITS, CONFIG_TELEMETRY_COMPRESSION_LOOKAHEAD_BITS);
+
+	// Other settings in the Kconfig range for comparison
+	measure("batch", BATCH_SAMPLES, false, 6, 4);
+	measure("batch", BATCH_SAMPLES, false, 10, 4);
+	measure("batch", BATCH_SAMPLES, false, 8, 3);
+	measure("batch", BATCH_SAMPLES, false, 8, 5);
+
+	return host_test_finish("bench_lzss");
+}
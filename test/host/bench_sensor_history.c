@@ -0,0 +1,91 @@
+// Sensor history: cost of an add and of a snapshot, against recomputing the statistics from the window
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "sensor_history.h"
+
+#define ITERATIONS 2000000
+
+static struct sensor_history history;
+static struct sensor_sample samples[SENSOR_HISTORY_LENGTH];
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng() {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// What a reader would do without running statistics
+static void recompute_stats(struct sensor_stats *stats) {
+	uint16_t count = sensor_history_get_samples(&history, samples, SENSOR_HISTORY_LENGTH);
+	double sum = 0, m2 = 0;
+
+	stats->count = count;
+	stats->min = INFINITY;
+	stats->max = -INFINITY;
+	for(uint16_t i = 0; i < count; ++i) {
+		stats->min = fminf(stats->min, samples[i].value);
+		stats->max = fmaxf(stats->max, samples[i].value);
+		sum += samples[i].value;
+	}
+	double mean = sum / count;
+	for(uint16_t i = 0; i < count; ++i) m2 += (samples[i].value - mean) * (samples[i].value - mean);
+	stats->mean = mean;
+	stats->variance = count > 1 ? m2 / (count - 1) : 0;
+	stats->latest = samples[count - 1];
+}
+
+static void report(const char *name, size_t allocs, uint64_t ns, uint64_t cycles) {
+	printf("%-16s %5.1f ns  %6.0f cycles  %zu allocs\n", name, (double)ns / ITERATIONS, (double)cycles / ITERATIONS, allocs);
+}
+
+int main() {
+	struct sensor_stats stats, recomputed;
+	static float values[4096];
+
+	for(int i = 0; i < 4096; ++i) values[i] = (rng() % 10000) / 100.0f;
+	sensor_history_init(&history);
+
+	size_t allocs = host_alloc_count;
+	uint64_t ns = host_time_ns();
+	uint64_t cycles = host_cycles();
+	for(int i = 0; i < ITERATIONS; ++i) sensor_history_add(&history, values[i & 4095], i);
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	allocs = host_alloc_count - allocs;
+	HOST_CHECK(allocs == 0);
+	printf("SENSOR_HISTORY_LENGTH %d, %zu bytes per sensor\n", SENSOR_HISTORY_LENGTH, sizeof(history));
+	report("add", allocs, ns, cycles);
+
+	allocs = host_alloc_count;
+	ns = host_time_ns();
+	cycles = host_cycles();
+	for(int i = 0; i < ITERATIONS; ++i) {
+		sensor_history_get_stats(&history, &stats);
+		__asm__ volatile("" : : "r"(&stats) : "memory");
+	}
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	allocs = host_alloc_count - allocs;
+	HOST_CHECK(allocs == 0);
+	report("get_stats", allocs, ns, cycles);
+
+	ns = host_time_ns();
+	cycles = host_cycles();
+	for(int i = 0; i < ITERATIONS; ++i) {
+		recompute_stats(&recomputed);
+		__asm__ volatile("" : : "r"(&recomputed) : "memory");
+	}
+	cycles = host_cycles() - cycles;
+	ns = host_time_ns() - ns;
+	report("recompute", 0, ns, cycles);
+
+	HOST_CHECK(stats.count == recomputed.count && stats.min == recomputed.min && stats.max == recomputed.max);
+	HOST_CHECK(fabsf(stats.mean - recomputed.mean) < 1e-3f);
+
+	return host_test_finish("bench_sensor_history");
+}
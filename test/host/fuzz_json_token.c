@@ -0,0 +1,149 @@
+// json_tokenize against fixed cases and random mutations of a settings document
+// Built with ASan and UBSan, every input is copied into an exact size heap block so reads past len are caught
+#include <string.h>
+
+#include "host_test.h"
+#include "json_token.h"
+
+#define MAX_TOKENS 64
+#define ITERATIONS 300000
+
+struct json_case {
+	const char *json;
+	int result; // Token count or JSON_ERROR_* code
+};
+
+static const struct json_case cases[] = {
+	{ "{}", 1 },
+	{ "[]", 1 },
+	{ "{\"a\":1,\"b\":{\"c\":[1,2,{\"d\":true}]}}", 12 },
+	{ "[\"a\",\"b\"]", 3 },
+	{ "{\"a\":\"b\\u0041\\n\"}", 3 },
+	{ "{\"a\":}", JSON_ERROR_INVALID },
+	{ "{\"a\" \"b\"}", JSON_ERROR_INVALID },
+	{ "{\"a\":1 \"b\":2}", JSON_ERROR_INVALID },
+	{ "{\"a\":\"b\":\"c\"}", JSON_ERROR_INVALID },
+	{ "[\"a\":1]", JSON_ERROR_INVALID },
+	{ "{\"a\"::1}", JSON_ERROR_INVALID },
+	{ "{:1}", JSON_ERROR_INVALID },
+	{ "\"a\":1", JSON_ERROR_INVALID },
+	{ "{1:2}", JSON_ERROR_INVALID },
+	{ "{\"a\":[}", JSON_ERROR_INVALID },
+	{ "{\"a\":1", JSON_ERROR_PARTIAL },
+	{ "{\"a\":\"b", JSON_ERROR_PARTIAL },
+	{ "[1,2,3,4]", 5 },
+};
+
+static const char *seed = "{\"req_id\":42,\"ph\":{\"monitoring_only\":false,\"control\":{\"dosing_time\":10,"
+		"\"dosing_interval\":60,\"target_value\":6.2,\"pumps\":{\"pump_1\":1,\"pump_2\":0.5}}},"
+		"\"grow_lights\":{\"lights_on\":\"2026-10-16T08:05:09Z\",\"lights_off\":\"2026-10-16T20:05:09Z\"},"
+		"\"telemetry\":{\"batch_size\":10,\"batch_interval\":[1,-2,3e4],\"x\":\"\\u00e9\\\"\"}}";
+
+static const char alphabet[] = "{}[]\":,\\ 0123456789-.eEtrufalsn\x01\x7f";
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng() {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// Mutate json in place, returns new length
+static size_t mutate(char *json, size_t len, size_t size) {
+	int num_edits = 1 + rng() % 4;
+	for(int i = 0; i < num_edits; ++i) {
+		size_t pos = len > 0 ? rng() % len : 0;
+		switch(rng() % 4) {
+			case 0:
+				if(len > 0) json[pos] = alphabet[rng() % (sizeof(alphabet) - 1)];
+				break;
+			case 1:
+				if(len < size) {
+					memmove(json + pos + 1, json + pos, len - pos);
+					json[pos] = alphabet[rng() % (sizeof(alphabet) - 1)];
+					len++;
+				}
+				break;
+			case 2:
+				if(len > 0) {
+					memmove(json + pos, json + pos + 1, len - pos - 1);
+					len--;
+				}
+				break;
+			default:
+				len = pos;
+				break;
+		}
+	}
+	return len;
+}
+
+// Walk every object and array like the settings parser does, members must stay inside the token list
+static void check_tokens(const char *json, size_t len, const struct json_token *tokens, int num_tokens) {
+	char out[64];
+
+	for(int i = 0; i < num_tokens; ++i) {
+		const struct json_token *token = &tokens[i];
+		HOST_CHECK(token->start <= token->end && token->end <= len);
+		HOST_CHECK(token->parent < i);
+		if(token->type == JSON_STRING) json_token_copy_string(json, token, out, sizeof(out));
+
+		if(token->type == JSON_OBJECT) {
+			int key = i + 1;
+			for(uint16_t j = 0; j < token->size; ++j, key = json_object_next(tokens, num_tokens, key)) {
+				HOST_CHECK(key + 1 < num_tokens);
+				if(key + 1 >= num_tokens) break;
+				HOST_CHECK(tokens[key].type == JSON_STRING && tokens[key].size == 1 && tokens[key].parent == i);
+				HOST_CHECK(tokens[key + 1].parent == key);
+			}
+			HOST_CHECK(key <= num_tokens);
+		} else if(token->type == JSON_ARRAY) {
+			int item = i + 1;
+			for(uint16_t j = 0; j < token->size; ++j, item = json_skip(tokens, num_tokens, item)) {
+				HOST_CHECK(item < num_tokens && tokens[item].parent == i);
+				if(item >= num_tokens) break;
+			}
+		}
+	}
+}
+
+static int tokenize_exact(const char *json, size_t len, struct json_token *tokens, uint16_t max_tokens) {
+	// No terminator after the document
+	char *copy = malloc(len > 0 ? len : 1);
+	memcpy(copy, json, len);
+	int result = json_tokenize(copy, len, tokens, max_tokens);
+	if(result > 0) check_tokens(copy, len, tokens, result);
+	free(copy);
+	return result;
+}
+
+int main() {
+	struct json_token tokens[MAX_TOKENS];
+	static char json[1024];
+
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		int result = tokenize_exact(cases[i].json, strlen(cases[i].json), tokens, MAX_TOKENS);
+		if(result != cases[i].result) fprintf(stderr, "%s: got %d, expected %d\n", cases[i].json, result, cases[i].result);
+		HOST_CHECK(result == cases[i].result);
+	}
+
+	// Seed is valid and needs every token, one less must be reported
+	int seed_tokens = tokenize_exact(seed, strlen(seed), tokens, MAX_TOKENS);
+	HOST_CHECK(seed_tokens > 0);
+	HOST_CHECK(tokenize_exact(seed, strlen(seed), tokens, seed_tokens - 1) == JSON_ERROR_NO_TOKENS);
+
+	int num_valid = 0;
+	for(int i = 0; i < ITERATIONS; ++i) {
+		size_t len = strlen(seed);
+		memcpy(json, seed, len);
+		len = mutate(json, len, sizeof(json));
+		int result = tokenize_exact(json, len, tokens, 1 + rng() % MAX_TOKENS);
+		HOST_CHECK(result >= JSON_ERROR_PARTIAL);
+		if(result > 0) num_valid++;
+	}
+	printf("%d mutated documents, %d tokenized\n", ITERATIONS, num_valid);
+
+	return host_test_finish("fuzz_json_token");
+}
@@ -0,0 +1,45 @@
+#include "host_test.h"
+
+#include <stdarg.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "esp_log.h"
+
+int host_test_failures;
+
+int host_test_finish(const char *name) {
+	if(host_test_failures == 0) {
+		printf("%s: ok\n", name);
+		return 0;
+	}
+	printf("%s: %d failed checks\n", name, host_test_failures);
+	return 1;
+}
+
+uint64_t host_time_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+uint64_t host_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// Firmware logs are dropped unless HOST_TEST_LOG is set
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+	if(getenv("HOST_TEST_LOG") == NULL) return;
+	va_list args;
+	va_start(args, format);
+	printf("%s: ", tag);
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+}
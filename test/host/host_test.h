@@ -0,0 +1,30 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Failed checks are counted and reported, the test exits non-zero at the end
+extern int host_test_failures;
+
+#define HOST_CHECK(cond) do { \
+	if(!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		host_test_failures++; \
+	} \
+} while(0)
+
+// Print summary, returns process exit code
+int host_test_finish(const char *name);
+
+// Monotonic time in ns
+uint64_t host_time_ns(void);
+
+// CPU cycles where the host has a cycle counter, 0 otherwise
+uint64_t host_cycles(void);
+
+// Heap calls made since start, see alloc_count.c, only in targets linking it
+extern size_t host_alloc_count;
+
+#endif
@@ -0,0 +1,12 @@
+// Stands in for mqtt_manager.h, which pulls in most of the firmware, for sources that only need the client globals
+// Injected with -include, so the real header is skipped through its include guard
+#ifndef __MQTT_MANAGER_H
+#define __MQTT_MANAGER_H
+
+#include <stdbool.h>
+#include <mqtt_client.h>
+
+extern esp_mqtt_client_handle_t mqtt_client;
+extern bool is_mqtt_connected;
+
+#endif
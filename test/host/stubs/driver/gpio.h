@@ -0,0 +1,22 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+typedef int gpio_num_t;
+typedef enum { GPIO_MODE_INPUT=1, GPIO_MODE_OUTPUT=2 } gpio_mode_t;
+typedef enum { GPIO_INTR_DISABLE, GPIO_INTR_POSEDGE, GPIO_INTR_NEGEDGE, GPIO_INTR_ANYEDGE, GPIO_INTR_LOW_LEVEL, GPIO_INTR_HIGH_LEVEL } gpio_int_type_t;
+typedef enum { GPIO_PULLUP_DISABLE, GPIO_PULLUP_ENABLE } gpio_pullup_t;
+typedef enum { GPIO_PULLDOWN_DISABLE, GPIO_PULLDOWN_ENABLE } gpio_pulldown_t;
+typedef struct { uint64_t pin_bit_mask; gpio_mode_t mode; gpio_pullup_t pull_up_en; gpio_pulldown_t pull_down_en; gpio_int_type_t intr_type; } gpio_config_t;
+typedef void (*gpio_isr_t)(void*);
+esp_err_t gpio_config(const gpio_config_t*); esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t); int gpio_get_level(gpio_num_t); esp_err_t gpio_set_level(gpio_num_t, uint32_t);
+esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t); esp_err_t gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void*); esp_err_t gpio_isr_handler_remove(gpio_num_t); esp_err_t gpio_install_isr_service(int);
+void gpio_pad_select_gpio(uint8_t); esp_err_t gpio_intr_enable(gpio_num_t); esp_err_t gpio_intr_disable(gpio_num_t);
+#define GPIO_SEL_14 (1ULL<<14)
+#define ESP_INTR_FLAG_IRAM (1<<10)
+#define ESP_INTR_FLAG_LEVEL1 (1<<1)
+#define GPIO_NUM_19 19
+#define GPIO_MODE_INPUT_OUTPUT_OD 7
+#define GPIO_MODE_INPUT_OUTPUT 3
+#define GPIO_PULLUP_ONLY 0
+#define GPIO_FLOATING 3
+esp_err_t gpio_set_pull_mode(gpio_num_t, int); esp_err_t gpio_reset_pin(gpio_num_t);
@@ -0,0 +1,20 @@
+#pragma once
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include <stdint.h>
+#include <stddef.h>
+typedef int i2c_port_t;
+#define I2C_NUM_MAX 2
+typedef enum { I2C_MODE_SLAVE, I2C_MODE_MASTER } i2c_mode_t;
+typedef struct { i2c_mode_t mode; int sda_io_num; int scl_io_num; bool sda_pullup_en; bool scl_pullup_en; struct { uint32_t clk_speed; } master; } i2c_config_t;
+typedef void* i2c_cmd_handle_t;
+typedef enum { I2C_MASTER_ACK, I2C_MASTER_NACK, I2C_MASTER_LAST_NACK } i2c_ack_type_t;
+#define I2C_MASTER_WRITE 0
+#define I2C_MASTER_READ 1
+i2c_cmd_handle_t i2c_cmd_link_create(void); void i2c_cmd_link_delete(i2c_cmd_handle_t);
+esp_err_t i2c_master_start(i2c_cmd_handle_t); esp_err_t i2c_master_stop(i2c_cmd_handle_t);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t, uint8_t, bool); esp_err_t i2c_master_write(i2c_cmd_handle_t, uint8_t*, size_t, bool);
+esp_err_t i2c_master_read(i2c_cmd_handle_t, uint8_t*, size_t, i2c_ack_type_t); esp_err_t i2c_master_read_byte(i2c_cmd_handle_t, uint8_t*, i2c_ack_type_t);
+esp_err_t i2c_master_cmd_begin(i2c_port_t, i2c_cmd_handle_t, TickType_t);
+esp_err_t i2c_param_config(i2c_port_t, const i2c_config_t*); esp_err_t i2c_driver_install(i2c_port_t, i2c_mode_t, size_t, size_t, int); esp_err_t i2c_driver_delete(i2c_port_t);
@@ -0,0 +1,12 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+typedef enum { ESP_PARTITION_TYPE_APP=0, ESP_PARTITION_TYPE_DATA=1 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+typedef struct { esp_partition_type_t type; esp_partition_subtype_t subtype; uint32_t address; uint32_t size; char label[17]; bool encrypted; } esp_partition_t;
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char*);
+esp_err_t esp_partition_read(const esp_partition_t*, size_t, void*, size_t); esp_err_t esp_partition_write(const esp_partition_t*, size_t, const void*, size_t);
+esp_err_t esp_partition_erase_range(const esp_partition_t*, size_t, size_t);
+#define SPI_FLASH_SEC_SIZE 4096
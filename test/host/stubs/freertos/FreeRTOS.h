@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+typedef uint32_t TickType_t; typedef int BaseType_t; typedef unsigned UBaseType_t;
+typedef void* TaskHandle_t; typedef void* QueueHandle_t; typedef void* SemaphoreHandle_t; typedef void* EventGroupHandle_t; typedef void* TimerHandle_t;
+typedef uint32_t EventBits_t; typedef uint32_t StackType_t;
+typedef struct { int owner; int count; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0,0}
+#define pdMS_TO_TICKS(x) ((TickType_t)((uint64_t)(x) * CONFIG_FREERTOS_HZ / 1000))
+#define pdTICKS_TO_MS(x) ((x) * portTICK_PERIOD_MS)
+#define portTICK_PERIOD_MS (1000 / CONFIG_FREERTOS_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define portMAX_DELAY 0xffffffffu
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define configMAX_PRIORITIES 25
+#define configMINIMAL_STACK_SIZE 768
+#define portENTER_CRITICAL(m) (void)(m)
+#define portEXIT_CRITICAL(m) (void)(m)
+#define portENTER_CRITICAL_ISR(m) (void)(m)
+#define portEXIT_CRITICAL_ISR(m) (void)(m)
+#define portYIELD_FROM_ISR() do{}while(0)
+#define IRAM_ATTR
+#define BIT(n) (1u<<(n))
@@ -0,0 +1,5 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+EventGroupHandle_t xEventGroupCreate(void); EventBits_t xEventGroupSync(EventGroupHandle_t, EventBits_t, EventBits_t, TickType_t);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t, EventBits_t); EventBits_t xEventGroupWaitBits(EventGroupHandle_t, EventBits_t, BaseType_t, BaseType_t, TickType_t);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t, EventBits_t);
@@ -0,0 +1,5 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t); BaseType_t xQueueSend(QueueHandle_t, const void*, TickType_t); BaseType_t xQueueReceive(QueueHandle_t, void*, TickType_t);
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void*, BaseType_t*); UBaseType_t uxQueueMessagesWaiting(QueueHandle_t); UBaseType_t uxQueueSpacesAvailable(QueueHandle_t);
+BaseType_t xQueueSendToBack(QueueHandle_t, const void*, TickType_t); BaseType_t xQueueReset(QueueHandle_t);
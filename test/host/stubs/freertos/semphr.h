@@ -0,0 +1,6 @@
+#pragma once
+#include "freertos/queue.h"
+SemaphoreHandle_t xSemaphoreCreateBinary(void); SemaphoreHandle_t xSemaphoreCreateMutex(void); SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t); BaseType_t xSemaphoreGive(SemaphoreHandle_t); BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t, BaseType_t*);
+void vSemaphoreDelete(SemaphoreHandle_t);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t); BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t);
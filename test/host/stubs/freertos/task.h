@@ -0,0 +1,18 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+typedef struct { TaskHandle_t xHandle; const char *pcTaskName; UBaseType_t xTaskNumber; eTaskState eCurrentState; UBaseType_t uxCurrentPriority; UBaseType_t uxBasePriority; uint32_t ulRunTimeCounter; StackType_t *pxStackBase; uint32_t usStackHighWaterMark; BaseType_t xCoreID; } TaskStatus_t;
+typedef void (*TaskFunction_t)(void*);
+void vTaskDelay(TickType_t); void vTaskSuspend(TaskHandle_t); void vTaskResume(TaskHandle_t); UBaseType_t uxTaskPriorityGet(TaskHandle_t); void vTaskPrioritySet(TaskHandle_t, UBaseType_t);
+BaseType_t xTaskCreate(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*, BaseType_t);
+TickType_t xTaskGetTickCount(void); UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t);
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t); BaseType_t xTaskNotifyGive(TaskHandle_t); void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t*);
+BaseType_t xTaskNotify(TaskHandle_t, uint32_t, int); BaseType_t xTaskNotifyWait(uint32_t, uint32_t, uint32_t*, TickType_t);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t*, UBaseType_t, uint32_t*); UBaseType_t uxTaskGetNumberOfTasks(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void); void vTaskDelete(TaskHandle_t); void vTaskDelayUntil(TickType_t*, TickType_t);
+const char *pcTaskGetTaskName(TaskHandle_t);
+#define eSetBits 1
+#define eIncrement 2
+#define eNoAction 0
+#define eSetValueWithOverwrite 3
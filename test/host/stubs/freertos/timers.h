@@ -0,0 +1,7 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+TimerHandle_t xTimerCreate(const char*, TickType_t, UBaseType_t, void*, TimerCallbackFunction_t);
+BaseType_t xTimerStart(TimerHandle_t, TickType_t); BaseType_t xTimerStop(TimerHandle_t, TickType_t); BaseType_t xTimerReset(TimerHandle_t, TickType_t);
+BaseType_t xTimerChangePeriod(TimerHandle_t, TickType_t, TickType_t); BaseType_t xTimerIsTimerActive(TimerHandle_t); void *pvTimerGetTimerID(TimerHandle_t);
+typedef void (*PendedFunction_t)(void*, uint32_t); BaseType_t xTimerPendFunctionCallFromISR(PendedFunction_t, void*, uint32_t, BaseType_t*);
@@ -0,0 +1,13 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+typedef enum { MQTT_EVENT_ANY=-1, MQTT_EVENT_ERROR=0, MQTT_EVENT_CONNECTED, MQTT_EVENT_DISCONNECTED, MQTT_EVENT_SUBSCRIBED, MQTT_EVENT_UNSUBSCRIBED, MQTT_EVENT_PUBLISHED, MQTT_EVENT_DATA, MQTT_EVENT_BEFORE_CONNECT } esp_mqtt_event_id_t;
+typedef struct { esp_mqtt_event_id_t event_id; esp_mqtt_client_handle_t client; void *user_context; char *data; int data_len; int total_data_len; int current_data_offset; char *topic; int topic_len; int msg_id; int session_present; } esp_mqtt_event_t;
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+typedef esp_err_t (*mqtt_event_callback_t)(esp_mqtt_event_handle_t);
+typedef struct { mqtt_event_callback_t event_handle; const char *host; const char *uri; uint32_t port; const char *client_id; const char *username; const char *password; const char *lwt_topic; const char *lwt_msg; int lwt_qos; int lwt_retain; int lwt_msg_len; int disable_clean_session; int keepalive; bool disable_auto_reconnect; void *user_context; int task_prio; int task_stack; int buffer_size; int reconnect_timeout_ms; int network_timeout_ms; int out_buffer_size; } esp_mqtt_client_config_t;
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t*); esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t); esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t); esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t, const esp_mqtt_client_config_t*);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t, const char*, int); int esp_mqtt_client_publish(esp_mqtt_client_handle_t, const char*, const char*, int, int, int);
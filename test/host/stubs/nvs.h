@@ -0,0 +1,16 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE 0x1105
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+esp_err_t nvs_open(const char*, nvs_open_mode_t, nvs_handle_t*); void nvs_close(nvs_handle_t); esp_err_t nvs_commit(nvs_handle_t);
+#define D(T,N) esp_err_t nvs_set_##N(nvs_handle_t, const char*, T); esp_err_t nvs_get_##N(nvs_handle_t, const char*, T*);
+D(uint8_t,u8) D(int8_t,i8) D(uint16_t,u16) D(int16_t,i16) D(uint32_t,u32) D(int32_t,i32) D(uint64_t,u64) D(int64_t,i64)
+#undef D
+esp_err_t nvs_set_str(nvs_handle_t, const char*, const char*); esp_err_t nvs_get_str(nvs_handle_t, const char*, char*, size_t*);
+esp_err_t nvs_set_blob(nvs_handle_t, const char*, const void*, size_t); esp_err_t nvs_get_blob(nvs_handle_t, const char*, void*, size_t*);
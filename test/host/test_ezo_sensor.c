@@ -0,0 +1,181 @@
+// EC readings through the EZO state machine against a simulated OEM register map on a virtual clock
+// Set INT=1 to enable the INT pin, otherwise each reading is only picked up at its deadline
+#include <string.h>
+
+#include "host_test.h"
+#include "ezo_sensor.h"
+#include "ec_sensor.h"
+
+#define NUM_READS 20
+#define CONVERSION_TIME 640 // ms, same as ec_registers
+#define BUS_BIT_TIME 100 // us at the 10 kHz the circuits run at
+#define EC_RAW 1288 // 12.88 mS * 100
+
+// EZO EC OEM circuit, registers 0x10-0x13 take the compensation and 0x14-0x17 confirm it
+static struct {
+	uint8_t regs[64];
+	uint8_t pointer;
+	uint32_t phase; // ms offset of the conversion schedule
+	bool is_stalled; // Stops converting while active
+	uint32_t last_conversion;
+	uint32_t compensation_writes;
+} circuit;
+
+// Virtual clock in ms and the calling task's notification
+static uint32_t now;
+static bool is_notified;
+static uint32_t wakeups;
+
+// MCP23017 INTA, latched low on a change of the INT pin until the port is read
+static bool is_inta_low;
+static uint32_t inta_releases;
+
+// Bus use at 10 kHz, 9 bit times per byte plus start and stop
+static uint32_t transactions;
+static uint64_t bus_time_us;
+
+static uint32_t compensation_reg() {
+	return ((uint32_t)circuit.regs[0x10] << 24) | ((uint32_t)circuit.regs[0x11] << 16) | ((uint32_t)circuit.regs[0x12] << 8) | circuit.regs[0x13];
+}
+
+static void advance(uint32_t ms) {
+	for(uint32_t i = 0; i < ms; ++i) {
+		now++;
+		if(circuit.regs[EZO_ACTIVE_REG] == 0 || circuit.is_stalled || (now + circuit.phase) % CONVERSION_TIME != 0) continue;
+		circuit.regs[EZO_NEW_READING_REG] = 1;
+		circuit.regs[0x18] = EC_RAW >> 24;
+		circuit.regs[0x19] = EC_RAW >> 16;
+		circuit.regs[0x1A] = EC_RAW >> 8;
+		circuit.regs[0x1B] = EC_RAW & 0xFF;
+		circuit.last_conversion = now;
+		if(circuit.regs[EZO_INTERRUPT_REG] != EZO_INTERRUPT_INVERT || is_inta_low) continue;
+		is_inta_low = true;
+		is_notified = true;
+	}
+}
+
+// Same as clear_gpio_interrupt in ports.c
+static void release_inta() {
+	is_inta_low = false;
+	inta_releases++;
+}
+
+TickType_t xTaskGetTickCount(void) { return now / portTICK_PERIOD_MS; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return &circuit; }
+void vTaskDelay(TickType_t ticks) { advance(ticks * portTICK_PERIOD_MS); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+	if(ticks > 0) wakeups++;
+	for(uint32_t i = 0; i < ticks * portTICK_PERIOD_MS && !is_notified; ++i) advance(1);
+	uint32_t value = is_notified;
+	is_notified = false;
+	return value;
+}
+
+// External definitions of the inline register helpers for builds that don't inline them
+extern esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg, void *in_data, size_t in_size);
+extern esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg, const void *out_data, size_t out_size);
+
+esp_err_t i2c_dev_create_mutex(i2c_dev_t *dev) { return ESP_OK; }
+esp_err_t i2c_dev_take_mutex(i2c_dev_t *dev) { return ESP_OK; }
+esp_err_t i2c_dev_give_mutex(i2c_dev_t *dev) { return ESP_OK; }
+
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size) {
+	const uint8_t *data = out_data;
+	uint8_t reg = out_reg_size > 0 ? *(const uint8_t*)out_reg : circuit.pointer;
+
+	transactions++;
+	bus_time_us += ((1 + out_reg_size + out_size) * 9 + 2) * BUS_BIT_TIME;
+	if(reg == 0x10) circuit.compensation_writes++;
+	for(size_t i = 0; i < out_size; ++i) {
+		circuit.regs[reg + i] = data[i];
+		// Confirmation follows the compensation in use
+		if(reg + i >= 0x10 && reg + i <= 0x13) circuit.regs[reg + i + 4] = data[i];
+	}
+	// Hibernating drops the compensation
+	if(reg == EZO_ACTIVE_REG && data[0] == 0) memset(&circuit.regs[0x10], 0, 8);
+	return ESP_OK;
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size) {
+	// Pointer write, repeated start, then the data read
+	if(out_size > 0) circuit.pointer = *(const uint8_t*)out_data;
+	transactions++;
+	bus_time_us += ((out_size > 0 ? 1 + out_size : 0) + 1 + in_size) * 9 * BUS_BIT_TIME + (out_size > 0 ? 3 : 2) * BUS_BIT_TIME;
+	memcpy(in_data, &circuit.regs[circuit.pointer], in_size);
+	return ESP_OK;
+}
+
+// Writes the driver should make for a temperature trace, given the cache it keeps
+static uint32_t expected_writes(float start, float step, int num_reads) {
+	uint32_t writes = 0;
+	int32_t cached = -1;
+	for(int i = 0; i < num_reads; ++i) {
+		int32_t temp_comp = (int32_t)roundf((start + step * i) * 100);
+		if(cached >= 0 && abs(temp_comp - cached) <= EZO_TEMP_COMP_TOLERANCE) continue;
+		cached = temp_comp;
+		writes++;
+	}
+	return writes;
+}
+
+int main() {
+	ec_sensor_t dev;
+	float ec;
+	bool is_interrupt = getenv("INT") != NULL && strcmp(getenv("INT"), "1") == 0;
+	// Longest a reading may take, the INT pin ends the wait at the next conversion
+	uint32_t max_read_time = is_interrupt ? CONVERSION_TIME + EZO_TEMP_CONFIRM_ATTEMPTS * EZO_CONFIRM_PERIOD + portTICK_PERIOD_MS
+			: 3 * CONVERSION_TIME + EZO_TEMP_CONFIRM_ATTEMPTS * EZO_CONFIRM_PERIOD + portTICK_PERIOD_MS;
+	uint32_t total_time = 0, worst_time = 0, worst_pickup = 0;
+
+	memset(&dev, 0, sizeof(dev));
+	HOST_CHECK(ec_init(&dev, 0, EC_ADDR_BASE, 21, 22) == ESP_OK);
+	ezo_set_interrupt_release(release_inta);
+	HOST_CHECK(activate_ec(&dev) == ESP_OK);
+	if(!is_interrupt) circuit.regs[EZO_INTERRUPT_REG] = 0;
+
+	// Water drifts 0.03 C per reading, compensation is only rewritten past the tolerance
+	for(int i = 0; i < NUM_READS; ++i) {
+		circuit.phase = (i * 97) % CONVERSION_TIME;
+		advance(1000);
+
+		float temperature = 21.37f + 0.03f * i;
+		uint32_t start = now, start_transactions = transactions;
+		uint64_t start_bus_time = bus_time_us;
+		HOST_CHECK(read_ec_with_temperature(&dev, temperature, &ec) == ESP_OK);
+		HOST_CHECK(ec == EC_RAW / 100.0f);
+		HOST_CHECK(abs((int32_t)compensation_reg() - (int32_t)roundf(temperature * 100)) <= EZO_TEMP_COMP_TOLERANCE);
+
+		uint32_t read_time = now - start;
+		HOST_CHECK(read_time <= max_read_time);
+		if(read_time > worst_time) worst_time = read_time;
+		if(now - circuit.last_conversion > worst_pickup) worst_pickup = now - circuit.last_conversion;
+		total_time += read_time;
+		if(i < 3) printf("read %d: %u ms, %u transactions, %.1f ms bus\n", i, read_time, transactions - start_transactions,
+				(bus_time_us - start_bus_time) / 1000.0);
+	}
+	HOST_CHECK(circuit.compensation_writes == expected_writes(21.37f, 0.03f, NUM_READS));
+	if(is_interrupt) HOST_CHECK(worst_pickup < portTICK_PERIOD_MS && inta_releases >= NUM_READS);
+	printf("%s: %d reads, mean %u ms, worst %u ms, worst pickup %u ms after conversion, %u wakeups\n",
+			is_interrupt ? "INT pin" : "polling", NUM_READS, total_time / NUM_READS, worst_time, worst_pickup, wakeups);
+	printf("compensation written %u times, INTA released %u times, bus %u transactions, %.1f ms\n", circuit.compensation_writes,
+			inta_releases, transactions, bus_time_us / 1000.0);
+
+	// Hibernate drops the compensation, the next reading writes it again
+	uint32_t writes = circuit.compensation_writes;
+	HOST_CHECK(hibernate_ec(&dev) == ESP_OK);
+	HOST_CHECK(activate_ec(&dev) == ESP_OK);
+	if(!is_interrupt) circuit.regs[EZO_INTERRUPT_REG] = 0;
+	HOST_CHECK(read_ec_with_temperature(&dev, 21.37f + 0.03f * (NUM_READS - 1), &ec) == ESP_OK);
+	HOST_CHECK(circuit.compensation_writes == writes + 1);
+	HOST_CHECK(compensation_reg() == (uint32_t)roundf((21.37f + 0.03f * (NUM_READS - 1)) * 100));
+
+	// A circuit that stops converting times out instead of hanging
+	circuit.is_stalled = true;
+	uint32_t start = now;
+	HOST_CHECK(read_ec(&dev, &ec) == ESP_ERR_TIMEOUT);
+	HOST_CHECK(now - start >= 3 * CONVERSION_TIME && now - start <= 3 * CONVERSION_TIME + portTICK_PERIOD_MS);
+	printf("stalled circuit: timeout after %u ms\n", now - start);
+
+	return host_test_finish(is_interrupt ? "test_ezo_sensor (INT pin)" : "test_ezo_sensor");
+}
@@ -0,0 +1,218 @@
+// Reconnect backoff against an esp-mqtt stand-in on a virtual clock and a broker that goes away and comes back
+#include <string.h>
+
+#include "host_test.h"
+#include "mqtt_connection.h"
+
+#define DEFAULT_RECONNECT_TIMEOUT 10000 // esp-mqtt MQTT_RECONNECT_TIMEOUT_MS
+#define CONNECT_TIME 50 // ms from BEFORE_CONNECT to CONNACK or failure
+#define MAX_ATTEMPTS 64
+
+esp_mqtt_client_handle_t mqtt_client;
+bool is_mqtt_connected;
+
+static uint32_t now;
+static int connects, reconnects;
+
+// Broker stand-in, connects fail and open connections drop while it is down
+static bool is_broker_up;
+
+// Same states and steps as the esp-mqtt 4.x client task
+static struct {
+	esp_mqtt_client_config_t config;
+	bool is_running; // Task alive
+	enum { CLIENT_INIT, CLIENT_CONNECTING, CLIENT_CONNECTED, CLIENT_WAIT_TIMEOUT } state;
+	uint32_t state_time;
+	uint32_t wait_timeout_ms;
+	uint32_t waits[MAX_ATTEMPTS]; // Delay used after each drop
+	int num_waits;
+	int starts, set_configs;
+} client;
+
+static uint32_t rng_state = 0x2545F491;
+
+uint32_t esp_random(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// Handler calls for the events mqtt_event_handler passes on to mqtt_connection
+static void dispatch(esp_mqtt_event_id_t event) {
+	if(event == MQTT_EVENT_BEFORE_CONNECT) mqtt_connection_connecting();
+	else if(event == MQTT_EVENT_CONNECTED) {
+		connects++;
+		if(mqtt_connection_connected()) reconnects++;
+	}
+	else if(event == MQTT_EVENT_DISCONNECTED) mqtt_connection_disconnected();
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+	memset(&client, 0, sizeof(client));
+	client.config = *config;
+	if(client.config.reconnect_timeout_ms == 0) client.config.reconnect_timeout_ms = DEFAULT_RECONNECT_TIMEOUT;
+	return (esp_mqtt_client_handle_t)&client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t handle) {
+	if(client.is_running) return ESP_FAIL;
+	client.is_running = true;
+	client.state = CLIENT_INIT;
+	client.starts++;
+	return ESP_OK;
+}
+
+// Zero fields fall back to the defaults, so callers must pass the whole config
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t handle, const esp_mqtt_client_config_t *config) {
+	HOST_CHECK(handle == (esp_mqtt_client_handle_t)&client);
+	client.config = *config;
+	if(client.config.reconnect_timeout_ms == 0) client.config.reconnect_timeout_ms = DEFAULT_RECONNECT_TIMEOUT;
+	client.set_configs++;
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t handle) {
+	if(!client.is_running || client.state != CLIENT_WAIT_TIMEOUT) return ESP_FAIL;
+	client.wait_timeout_ms = 0;
+	return ESP_OK;
+}
+
+// Timeout is taken from the config before the event goes out
+static void abort_connection() {
+	client.wait_timeout_ms = client.config.reconnect_timeout_ms;
+	client.state = CLIENT_WAIT_TIMEOUT;
+	client.state_time = now;
+	if(client.num_waits < MAX_ATTEMPTS) client.waits[client.num_waits++] = client.wait_timeout_ms;
+	dispatch(MQTT_EVENT_DISCONNECTED);
+}
+
+static void run(uint32_t ms) {
+	for(uint32_t end = now + ms; now < end; ++now) {
+		if(!client.is_running) continue;
+		switch(client.state) {
+			case CLIENT_INIT:
+				dispatch(MQTT_EVENT_BEFORE_CONNECT);
+				client.state = CLIENT_CONNECTING;
+				client.state_time = now;
+				break;
+			case CLIENT_CONNECTING:
+				if(now - client.state_time < CONNECT_TIME) break;
+				if(!is_broker_up) {
+					abort_connection();
+					break;
+				}
+				client.state = CLIENT_CONNECTED;
+				dispatch(MQTT_EVENT_CONNECTED);
+				break;
+			case CLIENT_CONNECTED:
+				if(!is_broker_up) abort_connection();
+				break;
+			case CLIENT_WAIT_TIMEOUT:
+				// Task exits here without auto reconnect, reconnect calls fail from then on
+				if(client.config.disable_auto_reconnect) client.is_running = false;
+				else if(now - client.state_time > client.wait_timeout_ms) client.state = CLIENT_INIT;
+				break;
+		}
+	}
+}
+
+// Runs until connected, returns the time it took
+static uint32_t run_until_connected(uint32_t limit) {
+	uint32_t start = now;
+	while(!is_mqtt_connected && now - start < limit) run(1);
+	return now - start;
+}
+
+static void check_backoff() {
+	uint32_t previous = 0;
+	for(int attempts = 0; attempts <= UINT8_MAX; ++attempts) {
+		uint32_t low = mqtt_connection_backoff(attempts, 0);
+		uint32_t high = mqtt_connection_backoff(attempts, UINT32_MAX - 1);
+		uint32_t delay = attempts < 6 ? MQTT_RECONNECT_MIN_DELAY << attempts : MQTT_RECONNECT_MAX_DELAY;
+
+		// Equal jitter: at least half the delay, never more than the delay
+		HOST_CHECK(low == delay / 2);
+		HOST_CHECK(high >= low && high <= delay);
+		for(uint32_t random = 0; random < 5000; random += 997) {
+			uint32_t jittered = mqtt_connection_backoff(attempts, random);
+			HOST_CHECK(jittered >= delay / 2 && jittered <= delay);
+		}
+
+		// Doubles until capped, large attempt counts must not overflow the shift
+		HOST_CHECK(low >= previous);
+		HOST_CHECK(high <= MQTT_RECONNECT_MAX_DELAY);
+		previous = low;
+	}
+	HOST_CHECK(mqtt_connection_backoff(0, 0) == MQTT_RECONNECT_MIN_DELAY / 2);
+	HOST_CHECK(mqtt_connection_backoff(UINT8_MAX, UINT32_MAX) <= MQTT_RECONNECT_MAX_DELAY);
+}
+
+// Delay after the nth failure in a row must fall inside its backoff step, between half and all of it
+static bool is_in_step(uint32_t wait, int failures) {
+	uint32_t half = mqtt_connection_backoff(failures, 0);
+	return wait >= half && wait <= 2 * half;
+}
+
+// Waits from index first on must follow the backoff from its first step
+static void check_waits(int first, const char *step) {
+	for(int i = first; i < client.num_waits; ++i) {
+		if(is_in_step(client.waits[i], i - first)) continue;
+		fprintf(stderr, "%s: wait %d of %u ms outside step %d\n", step, i, client.waits[i], i - first);
+		HOST_CHECK(false);
+	}
+}
+
+static void check_outage() {
+	esp_mqtt_client_config_t mqtt_cfg = { .host = "192.168.1.2", .port = 1883 };
+
+	init_mqtt_connection(&mqtt_cfg);
+	HOST_CHECK(!mqtt_cfg.disable_auto_reconnect);
+	HOST_CHECK(is_in_step(mqtt_cfg.reconnect_timeout_ms, 0));
+	mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+	HOST_CHECK(mqtt_connection_get_state() == MQTT_CONNECTION_IDLE);
+
+	// Broker down at boot, first attempts back off from the start
+	mqtt_connection_start();
+	mqtt_connection_start();
+	HOST_CHECK(client.starts == 1);
+	run(10000);
+	HOST_CHECK(!is_mqtt_connected && client.num_waits >= 3);
+	check_waits(0, "boot");
+
+	is_broker_up = true;
+	HOST_CHECK(run_until_connected(MQTT_RECONNECT_MAX_DELAY + CONNECT_TIME + 1) <= MQTT_RECONNECT_MAX_DELAY + CONNECT_TIME);
+	HOST_CHECK(mqtt_connection_get_state() == MQTT_CONNECTION_CONNECTED);
+	run(60000);
+	HOST_CHECK(is_mqtt_connected);
+
+	// Broker restarts a few times, each outage starts the backoff over and the client comes back each time
+	uint32_t outages[] = { 500, 30000, 5 * 60000 };
+	for(int i = 0; i < 3; ++i) {
+		int first = client.num_waits;
+		is_broker_up = false;
+		run(outages[i]);
+		HOST_CHECK(!is_mqtt_connected);
+		HOST_CHECK(mqtt_connection_get_state() != MQTT_CONNECTION_CONNECTED);
+
+		is_broker_up = true;
+		uint32_t time = run_until_connected(MQTT_RECONNECT_MAX_DELAY + CONNECT_TIME + 1);
+		HOST_CHECK(is_mqtt_connected && time <= MQTT_RECONNECT_MAX_DELAY + CONNECT_TIME);
+		HOST_CHECK(client.is_running);
+		check_waits(first, "outage");
+		printf("broker down %u ms: %d attempts, back %u ms after the broker\n", outages[i], client.num_waits - first, time);
+		run(60000);
+	}
+	HOST_CHECK(client.num_waits > 10 && client.num_waits < MAX_ATTEMPTS);
+
+	// Long outage reaches the cap and stays there
+	HOST_CHECK(client.waits[client.num_waits - 1] >= MQTT_RECONNECT_MAX_DELAY / 2);
+	HOST_CHECK(connects == 4 && reconnects == 3);
+	HOST_CHECK(client.starts == 1);
+}
+
+int main() {
+	check_backoff();
+	check_outage();
+	return host_test_finish("test_mqtt_connection");
+}
@@ -0,0 +1,141 @@
+// Outbox accounting against a broker stand-in that acks, stops acking, then acks again
+#include <string.h>
+
+#include "host_test.h"
+#include "mqtt_outbox.h"
+
+#define TELEMETRY_SIZE 600 // Batch payload and topic
+#define CONTROL_SIZE 60 // Status or ack
+
+static TickType_t now;
+
+TickType_t xTaskGetTickCount(void) { return now; }
+
+// Broker stand-in, QoS 1 messages wait here for their PUBACK
+static struct {
+	bool is_acking;
+	int next_msg_id;
+	int pending[256];
+	int num_pending;
+} broker = { .is_acking = true, .next_msg_id = 1 };
+
+// Delivers every pending PUBACK as MQTT_EVENT_PUBLISHED would, returns how many freed space
+static int broker_ack() {
+	int released = 0;
+	if(!broker.is_acking) return 0;
+	for(int i = 0; i < broker.num_pending; ++i) {
+		if(mqtt_outbox_acked(broker.pending[i])) released++;
+	}
+	broker.num_pending = 0;
+	return released;
+}
+
+// Same steps as publish_topic_retain for a QoS 1 topic
+static int publish(uint8_t priority, uint32_t size) {
+	if(!mqtt_outbox_admit(priority, size)) return MQTT_OUTBOX_REFUSED;
+
+	int msg_id = broker.next_msg_id++;
+	broker.pending[broker.num_pending++] = msg_id;
+	mqtt_outbox_add(msg_id, size);
+	return msg_id;
+}
+
+static struct mqtt_outbox_stats get_stats() {
+	struct mqtt_outbox_stats stats;
+	mqtt_outbox_get_stats(&stats);
+	return stats;
+}
+
+// Acks arrive before the next publish, nothing builds up
+static void check_acking() {
+	for(int i = 0; i < 100; ++i) {
+		HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) > 0);
+		now += pdMS_TO_TICKS(1000);
+		broker_ack();
+	}
+	struct mqtt_outbox_stats stats = get_stats();
+	HOST_CHECK(stats.size == 0);
+	HOST_CHECK(stats.refused == 0);
+	HOST_CHECK(stats.peak_size == TELEMETRY_SIZE + MQTT_OUTBOX_MESSAGE_OVERHEAD);
+}
+
+// Telemetry stops at the limit, control keeps going past it
+static void check_stalled() {
+	const uint32_t message_size = TELEMETRY_SIZE + MQTT_OUTBOX_MESSAGE_OVERHEAD;
+	const int num_admitted = MQTT_OUTBOX_LIMIT / message_size;
+	int admitted = 0, refused = 0;
+
+	broker.is_acking = false;
+	for(int i = 0; i < 2 * num_admitted; ++i) {
+		if(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) > 0) admitted++;
+		else refused++;
+		HOST_CHECK(get_stats().size <= MQTT_OUTBOX_LIMIT);
+		now += pdMS_TO_TICKS(100);
+		broker_ack();
+	}
+	HOST_CHECK(admitted == num_admitted);
+	HOST_CHECK(refused == num_admitted);
+	HOST_CHECK(get_stats().refused == num_admitted);
+
+	for(int i = 0; i < 3; ++i) HOST_CHECK(publish(MQTT_OUTBOX_CONTROL, CONTROL_SIZE) > 0);
+	struct mqtt_outbox_stats stats = get_stats();
+	HOST_CHECK(stats.size == num_admitted * message_size + 3 * (CONTROL_SIZE + MQTT_OUTBOX_MESSAGE_OVERHEAD));
+	HOST_CHECK(stats.peak_size == stats.size);
+
+	// Telemetry is admitted again as soon as the backlog is acked, each tracked ack reports the space it freed
+	broker.is_acking = true;
+	HOST_CHECK(broker_ack() == num_admitted + 3);
+	HOST_CHECK(!mqtt_outbox_acked(broker.next_msg_id - 1));
+	HOST_CHECK(get_stats().size == 0);
+	HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) > 0);
+	broker_ack();
+}
+
+// Messages esp-mqtt deleted unacked stop counting after the expire period
+static void check_expired() {
+	broker.is_acking = false;
+	while(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) > 0);
+	uint32_t refused = get_stats().refused;
+
+	now += pdMS_TO_TICKS(MQTT_OUTBOX_EXPIRE_PERIOD) - 1;
+	HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) == MQTT_OUTBOX_REFUSED);
+	HOST_CHECK(get_stats().refused == refused + 1);
+
+	now += 1;
+	HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, TELEMETRY_SIZE) > 0);
+	struct mqtt_outbox_stats stats = get_stats();
+	HOST_CHECK(stats.expired == MQTT_OUTBOX_LIMIT / (TELEMETRY_SIZE + MQTT_OUTBOX_MESSAGE_OVERHEAD));
+	HOST_CHECK(stats.size == TELEMETRY_SIZE + MQTT_OUTBOX_MESSAGE_OVERHEAD);
+
+	// Late acks of expired messages change nothing
+	broker.is_acking = true;
+	HOST_CHECK(broker_ack() == 1);
+	HOST_CHECK(get_stats().size == 0);
+}
+
+// Small messages run out of entries before bytes, control beyond that is left untracked
+static void check_table_full() {
+	broker.is_acking = false;
+	for(int i = 0; i < MQTT_OUTBOX_MAX_ENTRIES; ++i) HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, 10) > 0);
+	HOST_CHECK(get_stats().size < MQTT_OUTBOX_LIMIT);
+	HOST_CHECK(publish(MQTT_OUTBOX_TELEMETRY, 10) == MQTT_OUTBOX_REFUSED);
+
+	uint32_t size = get_stats().size;
+	HOST_CHECK(publish(MQTT_OUTBOX_CONTROL, CONTROL_SIZE) > 0);
+	HOST_CHECK(get_stats().size == size);
+
+	broker.is_acking = true;
+	broker_ack();
+	HOST_CHECK(get_stats().size == 0);
+}
+
+int main() {
+	check_acking();
+	check_stalled();
+	check_expired();
+	check_table_full();
+
+	struct mqtt_outbox_stats stats = get_stats();
+	printf("limit %d bytes: peak %u, refused %u, expired %u\n", MQTT_OUTBOX_LIMIT, stats.peak_size, stats.refused, stats.expired);
+	return host_test_finish("test_mqtt_outbox");
+}
@@ -0,0 +1,148 @@
+// Sensor history statistics against a brute-force recomputation, and snapshots taken while the writer runs
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "sensor_history.h"
+
+#define CONCURRENT_ADDS 3000000
+
+static struct sensor_history history;
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng() {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// Recompute every statistic from the samples the history hands out
+static void check_stats(const char *step) {
+	struct sensor_stats stats;
+	struct sensor_sample samples[SENSOR_HISTORY_LENGTH];
+
+	sensor_history_get_stats(&history, &stats);
+	uint16_t count = sensor_history_get_samples(&history, samples, SENSOR_HISTORY_LENGTH);
+	HOST_CHECK(count == stats.count);
+	if(count == 0 || count != stats.count) return;
+
+	double min = INFINITY, max = -INFINITY, sum = 0;
+	for(uint16_t i = 0; i < count; ++i) {
+		min = fmin(min, samples[i].value);
+		max = fmax(max, samples[i].value);
+		sum += samples[i].value;
+		if(i > 0) HOST_CHECK(samples[i].time > samples[i - 1].time);
+	}
+	double mean = sum / count, m2 = 0;
+	for(uint16_t i = 0; i < count; ++i) m2 += (samples[i].value - mean) * (samples[i].value - mean);
+	double variance = count > 1 ? m2 / (count - 1) : 0;
+
+	bool is_ok = stats.min == (float)min && stats.max == (float)max
+			&& fabs(stats.mean - mean) <= 1e-4 * fmax(1, fabs(mean))
+			&& fabs(stats.variance - variance) <= 1e-3 * fmax(1, variance)
+			&& stats.latest.time == samples[count - 1].time && stats.latest.value == samples[count - 1].value;
+	if(!is_ok) fprintf(stderr, "%s: count %u min %f/%f max %f/%f mean %f/%f variance %f/%f\n", step, count,
+			stats.min, min, stats.max, max, stats.mean, mean, stats.variance, variance);
+	HOST_CHECK(is_ok);
+}
+
+// Filling, wrapping several laps with a step change, and NaN readings that must be skipped
+static void check_window() {
+	char step[32];
+	uint16_t added = 0;
+
+	sensor_history_init(&history);
+	check_stats("empty");
+	for(int i = 0; i < 5 * SENSOR_HISTORY_LENGTH + 7; ++i) {
+		float value = i % 17 == 0 ? NAN : 6.0f + (rng() % 2000) / 1000.0f + (i > 2 * SENSOR_HISTORY_LENGTH ? 3.0f : 0);
+		sensor_history_add(&history, value, 1000 + i);
+		if(!isnan(value)) added++;
+		snprintf(step, sizeof(step), "add %d", i);
+		check_stats(step);
+	}
+
+	struct sensor_stats stats;
+	sensor_history_get_stats(&history, &stats);
+	HOST_CHECK(added > SENSOR_HISTORY_LENGTH && stats.count == SENSOR_HISTORY_LENGTH);
+
+	// Infinities are failed readings too
+	sensor_history_add(&history, INFINITY, 5000);
+	sensor_history_add(&history, -INFINITY, 5001);
+	struct sensor_stats after;
+	sensor_history_get_stats(&history, &after);
+	HOST_CHECK(memcmp(&stats, &after, sizeof(stats)) == 0);
+
+	// Monotonic min and max queues, the extreme leaves the window exactly SENSOR_HISTORY_LENGTH adds later
+	sensor_history_init(&history);
+	sensor_history_add(&history, 100, 1);
+	for(int i = 0; i < SENSOR_HISTORY_LENGTH - 1; ++i) sensor_history_add(&history, 50, 2 + i);
+	sensor_history_get_stats(&history, &stats);
+	HOST_CHECK(stats.max == 100);
+	sensor_history_add(&history, 50, 1000);
+	sensor_history_get_stats(&history, &stats);
+	HOST_CHECK(stats.max == 50 && stats.min == 50 && stats.variance == 0);
+}
+
+// Sliding updates over many laps must not drift from the recomputed values
+static void check_drift() {
+	sensor_history_init(&history);
+	for(int i = 0; i < 200000; ++i) sensor_history_add(&history, 1000.0f + sinf(i * 0.01f) * 5 + (rng() % 100) / 1000.0f, 10000 + i);
+	check_stats("drift");
+
+	// A constant reading has no variance, rounding must not leave a negative or tiny positive one
+	sensor_history_init(&history);
+	for(int i = 0; i < 3 * SENSOR_HISTORY_LENGTH + 5; ++i) sensor_history_add(&history, 21.5f, i + 1);
+	struct sensor_stats stats;
+	sensor_history_get_stats(&history, &stats);
+	HOST_CHECK(stats.mean == 21.5f && stats.variance >= 0 && stats.variance < 1e-9f);
+	check_stats("constant");
+}
+
+static volatile bool is_writing;
+static uint32_t snapshots, torn;
+
+// Writer stores value == time, so a copy mixing two adds shows up
+static void* reader(void *arg) {
+	struct sensor_stats stats;
+	struct sensor_sample samples[SENSOR_HISTORY_LENGTH];
+
+	while(is_writing) {
+		sensor_history_get_stats(&history, &stats);
+		bool is_torn = stats.count > 0 && (stats.latest.value != (float)stats.latest.time
+				|| stats.max != stats.latest.value || stats.min != (float)(stats.latest.time - stats.count + 1)
+				|| stats.mean < stats.min || stats.mean > stats.max);
+
+		uint16_t count = sensor_history_get_samples(&history, samples, SENSOR_HISTORY_LENGTH);
+		for(uint16_t i = 0; i < count; ++i) {
+			if(samples[i].value != (float)samples[i].time || (i > 0 && samples[i].time != samples[i - 1].time + 1)) is_torn = true;
+		}
+		snapshots++;
+		if(is_torn) torn++;
+	}
+	return NULL;
+}
+
+static void check_concurrent() {
+	pthread_t thread;
+
+	sensor_history_init(&history);
+	is_writing = true;
+	HOST_CHECK(pthread_create(&thread, NULL, reader, NULL) == 0);
+	for(uint32_t i = 1; i <= CONCURRENT_ADDS; ++i) sensor_history_add(&history, (float)i, i);
+	is_writing = false;
+	pthread_join(thread, NULL);
+
+	printf("%u snapshots during %d adds, %u torn\n", snapshots, CONCURRENT_ADDS, torn);
+	HOST_CHECK(snapshots > 0);
+	HOST_CHECK(torn == 0);
+}
+
+int main() {
+	check_window();
+	check_drift();
+	check_concurrent();
+	return host_test_finish("test_sensor_history");
+}